@@ -0,0 +1,4 @@
+#pragma once
+#define GEN_TEMPLATE_NAME "/root/repo/scratch/code_XXXXXX"
+#define COMPILER_PATH "cc"
+#define CXX_COMPILER_PATH "g++"
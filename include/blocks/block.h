@@ -1,10 +1,13 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 #include "blocks/block_visitor.h"
+#include "util/node_pool.h"
 #include "util/tracer.h"
 #include <assert.h>
+#include <atomic>
 #include <iostream>
 #include <memory>
+#include <type_traits>
 #include <unordered_map>
 
 namespace builder {
@@ -15,18 +18,130 @@ class builder_context;
 namespace block {
 class block;
 
+// Kinds are in preorder of the class hierarchy, so the kinds of a
+// class and all the classes derived from it form a contiguous range
+enum class block_kind : unsigned char {
+	block,
+	expr,
+	unary_expr,
+	not_expr,
+	binary_expr,
+	and_expr,
+	bitwise_and_expr,
+	or_expr,
+	bitwise_or_expr,
+	plus_expr,
+	minus_expr,
+	mul_expr,
+	div_expr,
+	lt_expr,
+	gt_expr,
+	lte_expr,
+	gte_expr,
+	lshift_expr,
+	rshift_expr,
+	equals_expr,
+	ne_expr,
+	mod_expr,
+	var_expr,
+	const_expr,
+	int_const,
+	double_const,
+	float_const,
+	string_const,
+	assign_expr,
+	sq_bkt_expr,
+	function_call_expr,
+	initializer_list_expr,
+	foreign_expr_base,
+	member_access_expr,
+	addr_of_expr,
+	stmt,
+	expr_stmt,
+	stmt_block,
+	decl_stmt,
+	if_stmt,
+	label_stmt,
+	goto_stmt,
+	while_stmt,
+	for_stmt,
+	break_stmt,
+	continue_stmt,
+	func_decl,
+	return_stmt,
+	label,
+	type,
+	scalar_type,
+	pointer_type,
+	function_type,
+	array_type,
+	builder_var_type,
+	named_type,
+	var
+};
+
+// Declares the range of kinds of a block class. Classes that don't declare
+// their own kind (like foreign_expr<T> or classes outside the library)
+// are checked with dynamic_cast instead
+#define BLOCK_KIND(name, last)                                                                                         \
+	typedef name kind_class;                                                                                       \
+	static bool classof(const ::block::block *b) {                                                                 \
+		return b->kind >= ::block::block_kind::name && b->kind <= ::block::block_kind::last;                   \
+	}                                                                                                              \
+	name() { kind = ::block::block_kind::name; }
+
+template <typename T, typename = void>
+struct has_own_kind : std::false_type {};
 template <typename T>
-bool isa(std::shared_ptr<block> p) {
-	std::shared_ptr<T> ret = std::dynamic_pointer_cast<T>(p);
-	if (ret != nullptr)
-		return true;
-	return false;
+struct has_own_kind<T, typename std::enable_if<std::is_same<typename T::kind_class, T>::value>::type> : std::true_type {};
+
+template <typename T>
+typename std::enable_if<has_own_kind<T>::value, bool>::type isa_impl(const block *b) {
+	return T::classof(b);
+}
+template <typename T>
+typename std::enable_if<!has_own_kind<T>::value, bool>::type isa_impl(const block *b) {
+	return dynamic_cast<const T *>(b) != nullptr;
+}
+
+template <typename T>
+bool isa(const block *b) {
+	return b != nullptr && isa_impl<T>(b);
+}
+template <typename T, typename U>
+bool isa(const std::shared_ptr<U> &p) {
+	return isa<T>(p.get());
+}
+template <typename T, typename U>
+std::shared_ptr<T> to(const std::shared_ptr<U> &p) {
+	assert(isa<T>(p.get()));
+	// Shares the ownership of p without going through dynamic_pointer_cast
+	return std::shared_ptr<T>(p, static_cast<T *>(static_cast<block *>(p.get())));
+}
+
+// Non-owning versions, the block has to be kept alive by someone else
+template <typename T>
+T *cast(block *b) {
+	assert(isa<T>(b));
+	return static_cast<T *>(b);
+}
+template <typename T, typename U>
+T *cast(const std::shared_ptr<U> &p) {
+	return cast<T>(static_cast<block *>(p.get()));
 }
 template <typename T>
-std::shared_ptr<T> to(std::shared_ptr<block> p) {
-	std::shared_ptr<T> ret = std::dynamic_pointer_cast<T>(p);
-	assert(ret != nullptr);
-	return ret;
+T *dyn_cast(block *b) {
+	return isa<T>(b) ? static_cast<T *>(b) : nullptr;
+}
+template <typename T, typename U>
+T *dyn_cast(const std::shared_ptr<U> &p) {
+	return dyn_cast<T>(static_cast<block *>(p.get()));
+}
+// Creates a block from the node pool, the block and its reference
+// count share a single pooled allocation
+template <typename T, typename... Args>
+std::shared_ptr<T> make_node(Args &&... args) {
+	return std::allocate_shared<T>(util::node_pool_allocator<T>(), std::forward<Args>(args)...);
 }
 
 
@@ -63,13 +178,28 @@ public:
 	}
 };
 
+// Counts the blocks created by this process
+extern std::atomic<unsigned long long> block_creation_counter;
+
+// Structural hashes cached before the current generation are stale. Code that
+// modifies blocks after comparing them has to invalidate the hashes of the
+// modified blocks and everything that contains them, or all of them at once
+extern std::atomic<unsigned long long> structural_hash_generation;
+void invalidate_structural_hashes(void);
+
 class block : public std::enable_shared_from_this<block> {
 public:
 	virtual ~block() = default;
 
 	typedef std::shared_ptr<block> Ptr;
+	typedef block kind_class;
+	static bool classof(const block *) { return true; }
 
+	block_kind kind = block_kind::block;
 	tracer::tag static_offset;
+	// Blocks created after a fork have a creation_id at least as large as the
+	// counter at the time of the fork, the older ones are shared with the parent
+	unsigned long long creation_id = block_creation_counter++;
 
 	std::unordered_map<std::string, std::shared_ptr<block_metadata>> metadata_map;
 	
@@ -110,6 +240,22 @@ public:
 			return false;
 		return true;
 	}
+
+	// Hash of everything is_same compares. Blocks that are the same have the
+	// same hash, so different hashes rule out a match without a deep compare
+	unsigned long long structural_hash(void);
+	void invalidate_structural_hash(void) { cached_hash_generation = 0; }
+
+private:
+	std::atomic<unsigned long long> cached_hash{0};
+	std::atomic<unsigned long long> cached_hash_generation{0};
 };
+
+// Deep compare with the structural hashes as a fast path
+inline bool is_same_fast(block::Ptr a, block::Ptr b) {
+	if (a->structural_hash() != b->structural_hash())
+		return false;
+	return a->is_same(b);
+}
 } // namespace block
 #endif
@@ -0,0 +1,136 @@
+#ifndef BLOCK_SERIALIZER_H
+#define BLOCK_SERIALIZER_H
+#include "blocks/block_visitor.h"
+#include "blocks/stmt.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace block {
+
+// Writes blocks to a flat buffer that block_deserializer can read back.
+// Blocks reachable from multiple parents are written once, so the
+// sharing between nodes (like vars and their uses) survives the round trip
+class block_serializer : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::string buffer;
+	// Set if a block that can't be written (like a foreign_expr or
+	// metadata of an unknown type) was found
+	bool failed = false;
+	// Blocks for which this returns true are written as their address. The reader
+	// has to run in a process where those blocks are still alive
+	std::function<bool(block::Ptr)> write_by_address;
+
+	// Can be called multiple times, the sharing is tracked across the calls
+	void write_block(block::Ptr b);
+
+	void write_u64(unsigned long long v);
+	void write_string(const std::string &s);
+	void write_tag(const tracer::tag &t);
+	unsigned long long num_blocks_written(void) { return written_ids.size(); }
+
+	virtual void visit(block::Ptr) override;
+	virtual void visit(expr::Ptr) override;
+	virtual void visit(unary_expr::Ptr) override;
+	virtual void visit(binary_expr::Ptr) override;
+	virtual void visit(not_expr::Ptr) override;
+	virtual void visit(and_expr::Ptr) override;
+	virtual void visit(bitwise_and_expr::Ptr) override;
+	virtual void visit(or_expr::Ptr) override;
+	virtual void visit(bitwise_or_expr::Ptr) override;
+	virtual void visit(plus_expr::Ptr) override;
+	virtual void visit(minus_expr::Ptr) override;
+	virtual void visit(mul_expr::Ptr) override;
+	virtual void visit(div_expr::Ptr) override;
+	virtual void visit(lt_expr::Ptr) override;
+	virtual void visit(gt_expr::Ptr) override;
+	virtual void visit(lte_expr::Ptr) override;
+	virtual void visit(gte_expr::Ptr) override;
+	virtual void visit(lshift_expr::Ptr) override;
+	virtual void visit(rshift_expr::Ptr) override;
+	virtual void visit(equals_expr::Ptr) override;
+	virtual void visit(ne_expr::Ptr) override;
+	virtual void visit(mod_expr::Ptr) override;
+	virtual void visit(var_expr::Ptr) override;
+	virtual void visit(const_expr::Ptr) override;
+	virtual void visit(int_const::Ptr) override;
+	virtual void visit(double_const::Ptr) override;
+	virtual void visit(float_const::Ptr) override;
+	virtual void visit(string_const::Ptr) override;
+	virtual void visit(assign_expr::Ptr) override;
+	virtual void visit(stmt::Ptr) override;
+	virtual void visit(expr_stmt::Ptr) override;
+	virtual void visit(stmt_block::Ptr) override;
+	virtual void visit(decl_stmt::Ptr) override;
+	virtual void visit(if_stmt::Ptr) override;
+	virtual void visit(label::Ptr) override;
+	virtual void visit(label_stmt::Ptr) override;
+	virtual void visit(goto_stmt::Ptr) override;
+	virtual void visit(while_stmt::Ptr) override;
+	virtual void visit(for_stmt::Ptr) override;
+	virtual void visit(break_stmt::Ptr) override;
+	virtual void visit(continue_stmt::Ptr) override;
+	virtual void visit(sq_bkt_expr::Ptr) override;
+	virtual void visit(function_call_expr::Ptr) override;
+	virtual void visit(initializer_list_expr::Ptr) override;
+	virtual void visit(foreign_expr_base::Ptr) override;
+	virtual void visit(member_access_expr::Ptr) override;
+	virtual void visit(addr_of_expr::Ptr) override;
+	virtual void visit(var::Ptr) override;
+	virtual void visit(type::Ptr) override;
+	virtual void visit(scalar_type::Ptr) override;
+	virtual void visit(pointer_type::Ptr) override;
+	virtual void visit(function_type::Ptr) override;
+	virtual void visit(array_type::Ptr) override;
+	virtual void visit(builder_var_type::Ptr) override;
+	virtual void visit(named_type::Ptr) override;
+	virtual void visit(func_decl::Ptr) override;
+	virtual void visit(return_stmt::Ptr) override;
+
+private:
+	std::unordered_map<block *, unsigned long long> written_ids;
+	void write_header(int kind, block::Ptr b);
+	void write_binary(int kind, binary_expr::Ptr e);
+};
+
+class block_deserializer {
+public:
+	block_deserializer(const std::string &_buffer) : buffer(_buffer) {}
+
+	// Set if the buffer is truncated or malformed, everything read after that is null
+	bool failed = false;
+	// Blocks written by address are only accepted if this is set
+	bool read_addresses = false;
+
+	block::Ptr read_block(void);
+	// Returns nullptr and sets failed if the block is not a T
+	template <typename T>
+	std::shared_ptr<T> read_block_as(void) {
+		block::Ptr b = read_block();
+		if (b == nullptr)
+			return nullptr;
+		std::shared_ptr<T> ret = std::dynamic_pointer_cast<T>(b);
+		if (ret == nullptr)
+			failed = true;
+		return ret;
+	}
+
+	unsigned long long read_u64(void);
+	std::string read_string(void);
+	tracer::tag read_tag(void);
+	bool at_end(void) { return position == buffer.size(); }
+
+private:
+	const std::string &buffer;
+	size_t position = 0;
+	std::vector<block::Ptr> read_blocks;
+
+	void read_header(block::Ptr b);
+	template <typename T>
+	block::Ptr read_binary(void);
+};
+
+} // namespace block
+#endif
@@ -7,14 +7,20 @@
 #include <unordered_set>
 
 namespace block {
+// Writes the C code for a block straight to the stream as it walks the
+// AST, so the time and memory taken are linear in the size of the output
 class c_code_generator : public block_visitor {
 private:
-	void emit_binary_expr(binary_expr::Ptr, std::string);
+	void emit_binary_expr(binary_expr::Ptr, const char *);
+	// Writes a subexpression, bracketed if it binds looser than the operand slot it is in
+	void emit_operand(expr::Ptr);
+	void emit_array_decl(array_type::Ptr, var::Ptr);
+	void emit_array_pointer(array_type::Ptr, var::Ptr, bool);
+	void emit_func_ptr(function_type::Ptr, const std::string &);
 public:
 	using block_visitor::visit;
-//	c_code_generator(std::ostream &_oss) : oss(_oss) {}
-//	std::ostream &oss;
-        std::string last;
+	c_code_generator(std::ostream &_oss) : oss(_oss) {}
+	std::ostream &oss;
 	int curr_indent = 0;
 	virtual void visit(not_expr::Ptr);
 	virtual void visit(and_expr::Ptr);
@@ -70,10 +76,9 @@ public:
 	
 
 	static void generate_code(block::Ptr ast, std::ostream &oss, int indent = 0) {
-		c_code_generator generator;
+		c_code_generator generator(oss);
 		generator.curr_indent = indent;
 		ast->accept(&generator);
-		oss << generator.last;
 		oss << std::endl;
 	}
 };
@@ -0,0 +1,47 @@
+#ifndef BLOCKS_CFG_H
+#define BLOCKS_CFG_H
+#include "blocks/stmt.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace block {
+
+// A straight line sequence of nodes. The nodes are decl_stmts, expr_stmts,
+// return_stmts and the exprs evaluated by control flow (conditions and the
+// updates of for loops), in the order they are executed
+class basic_block {
+public:
+	unsigned int id;
+	std::vector<block::Ptr> nodes;
+	// The if, while or for whose condition ends the block, if any. The
+	// condition is the last node, successors[0] is taken if it is true
+	stmt::Ptr terminator;
+	std::vector<basic_block *> successors;
+	std::vector<basic_block *> predecessors;
+	// Immediate dominator, null for the entry and for unreachable blocks
+	basic_block *idom = nullptr;
+};
+
+// Built from the nested statements of a function body, including gotos
+// and labels. Blocks are owned by the graph and numbered in creation order
+class control_flow_graph {
+public:
+	std::vector<std::unique_ptr<basic_block>> blocks;
+	basic_block *entry = nullptr;
+	basic_block *exit = nullptr;
+
+	static std::unique_ptr<control_flow_graph> build(func_decl::Ptr func);
+	static std::unique_ptr<control_flow_graph> build(stmt::Ptr body);
+
+	// Only the blocks reachable from the entry
+	std::vector<basic_block *> reverse_postorder(void);
+	// Sets the idom of every block
+	void compute_dominators(void);
+	bool dominates(basic_block *a, basic_block *b);
+
+	void dump(std::ostream &oss);
+};
+
+} // namespace block
+#endif
@@ -0,0 +1,37 @@
+#ifndef BLOCKS_CONST_FOLD_H
+#define BLOCKS_CONST_FOLD_H
+#include "blocks/block_replacer.h"
+#include "blocks/expr.h"
+namespace block {
+// Folds operators whose operands are constants and removes the ones that
+// leave their operand unchanged (x + 0, x * 1 ...). Integer operators are
+// only folded if the C code would compute the same value, so expressions
+// that overflow an int are left alone
+class const_folder : public block_replacer {
+public:
+	using block_replacer::visit;
+	virtual void visit(not_expr::Ptr) override;
+	virtual void visit(and_expr::Ptr) override;
+	virtual void visit(bitwise_and_expr::Ptr) override;
+	virtual void visit(or_expr::Ptr) override;
+	virtual void visit(bitwise_or_expr::Ptr) override;
+	virtual void visit(plus_expr::Ptr) override;
+	virtual void visit(minus_expr::Ptr) override;
+	virtual void visit(mul_expr::Ptr) override;
+	virtual void visit(div_expr::Ptr) override;
+	virtual void visit(lt_expr::Ptr) override;
+	virtual void visit(gt_expr::Ptr) override;
+	virtual void visit(lte_expr::Ptr) override;
+	virtual void visit(gte_expr::Ptr) override;
+	virtual void visit(lshift_expr::Ptr) override;
+	virtual void visit(rshift_expr::Ptr) override;
+	virtual void visit(equals_expr::Ptr) override;
+	virtual void visit(ne_expr::Ptr) override;
+	virtual void visit(mod_expr::Ptr) override;
+
+private:
+	void fold_binary(binary_expr::Ptr);
+};
+void fold_constants(block::Ptr ast);
+} // namespace block
+#endif
@@ -0,0 +1,65 @@
+#ifndef BLOCKS_CSE_H
+#define BLOCKS_CSE_H
+#include "blocks/block.h"
+#include "blocks/block_visitor.h"
+#include "blocks/expr.h"
+#include "blocks/stmt.h"
+#include <unordered_map>
+#include <unordered_set>
+namespace block {
+// Computes pure expressions (arithmetic and array loads) that repeat in a
+// straight line sequence of statements once, into a temporary declared
+// before the statement with the first one. Assignments end the reuse of the
+// expressions that read the assigned var or memory, statements with other
+// side effects and control flow end the reuse of all of them. Statements
+// memoization shared with other blocks are left as they are
+void eliminate_common_subexprs(block::Ptr ast);
+
+// Vars whose address is taken can be changed through pointers, their
+// reads are treated like memory reads
+class address_taken_finder : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::unordered_set<var *> vars;
+	bool inside_addr_of = false;
+	virtual void visit(addr_of_expr::Ptr a) override {
+		bool old = inside_addr_of;
+		inside_addr_of = true;
+		a->expr1->accept(this);
+		inside_addr_of = old;
+	}
+	virtual void visit(var_expr::Ptr a) override {
+		if (inside_addr_of)
+			vars.insert(a->var1.get());
+	}
+};
+
+// Memoization can put the same statement into more than one block. Counts
+// the blocks each statement is in, the statements in a shared block are
+// counted once for every block it is in
+class shared_stmt_finder : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::unordered_map<stmt *, int> parents;
+	virtual void visit(stmt_block::Ptr b) override {
+		for (auto s : b->stmts) {
+			// The statements inside a shared one are only counted once
+			if (++parents[s.get()] == 1)
+				s->accept(this);
+		}
+	}
+	bool is_shared(stmt::Ptr s) {
+		auto it = parents.find(s.get());
+		return it != parents.end() && it->second > 1;
+	}
+};
+
+// The type of an arithmetic expr with the usual conversions (LP64),
+// nullptr if it isn't known
+type::Ptr expr_type(expr::Ptr e);
+// Exact comparison for the exprs that can be moved into a temporary. Vars
+// are compared by identity, two vars from different scopes can have the same tag
+bool same_expr(expr::Ptr a, expr::Ptr b);
+size_t hash_expr(expr::Ptr e);
+}
+#endif
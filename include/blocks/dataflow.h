@@ -0,0 +1,111 @@
+#ifndef BLOCKS_DATAFLOW_H
+#define BLOCKS_DATAFLOW_H
+#include "blocks/cfg.h"
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+namespace block {
+
+// A dataflow problem over the values T of a lattice. T has to be comparable with ==
+template <typename T>
+class dataflow_problem {
+public:
+	virtual ~dataflow_problem() {}
+	// Backward problems propagate from the exit to the entry
+	virtual bool is_forward(void) = 0;
+	// The value at the entry (forward) or the exit (backward)
+	virtual T boundary(void) = 0;
+	// The value every other block starts with
+	virtual T top(void) = 0;
+	virtual T meet(const T &a, const T &b) = 0;
+	// Maps the value before the block (after it, for backward problems) to the value after it
+	virtual T transfer(basic_block *bb, const T &value) = 0;
+};
+
+// The values at the start and the end of each block in execution order,
+// indexed by the block ids. Unreachable blocks keep the top value
+template <typename T>
+class dataflow_result {
+public:
+	std::vector<T> in;
+	std::vector<T> out;
+};
+
+// Worklist solver, the blocks are visited in reverse postorder (postorder
+// for backward problems) so most of them are only visited once per iteration
+template <typename T>
+dataflow_result<T> solve_dataflow(control_flow_graph &cfg, dataflow_problem<T> &problem) {
+	bool forward = problem.is_forward();
+	dataflow_result<T> result;
+	result.in.assign(cfg.blocks.size(), problem.top());
+	result.out.assign(cfg.blocks.size(), problem.top());
+	// Values flow from the source side of a block to the sink side
+	std::vector<T> &source = forward ? result.in : result.out;
+	std::vector<T> &sink = forward ? result.out : result.in;
+
+	std::vector<basic_block *> order = cfg.reverse_postorder();
+	if (!forward)
+		order = std::vector<basic_block *>(order.rbegin(), order.rend());
+	std::vector<bool> reachable(cfg.blocks.size(), false);
+	std::vector<bool> queued(cfg.blocks.size(), false);
+	std::deque<basic_block *> worklist;
+	for (auto bb : order) {
+		reachable[bb->id] = true;
+		queued[bb->id] = true;
+		worklist.push_back(bb);
+	}
+
+	basic_block *start = forward ? cfg.entry : cfg.exit;
+	while (!worklist.empty()) {
+		basic_block *bb = worklist.front();
+		worklist.pop_front();
+		queued[bb->id] = false;
+
+		const std::vector<basic_block *> &inputs = forward ? bb->predecessors : bb->successors;
+		const std::vector<basic_block *> &outputs = forward ? bb->successors : bb->predecessors;
+		if (bb == start) {
+			source[bb->id] = problem.boundary();
+		} else {
+			bool first = true;
+			for (auto other : inputs) {
+				if (!reachable[other->id])
+					continue;
+				source[bb->id] = first ? sink[other->id] : problem.meet(source[bb->id], sink[other->id]);
+				first = false;
+			}
+		}
+		T value = problem.transfer(bb, source[bb->id]);
+		if (value == sink[bb->id])
+			continue;
+		sink[bb->id] = std::move(value);
+		for (auto other : outputs) {
+			if (reachable[other->id] && !queued[other->id]) {
+				queued[other->id] = true;
+				worklist.push_back(other);
+			}
+		}
+	}
+	return result;
+}
+
+// The vars read and written by a node of a basic block
+void find_defs_and_uses(block::Ptr node, std::vector<var *> &defs, std::vector<var *> &uses);
+
+typedef std::unordered_set<var *> var_set;
+
+// A var is live if it can be read before it is written again. Reads and
+// writes through pointers are not tracked
+class liveness_problem : public dataflow_problem<var_set> {
+public:
+	virtual bool is_forward(void) override { return false; }
+	virtual var_set boundary(void) override { return var_set(); }
+	virtual var_set top(void) override { return var_set(); }
+	virtual var_set meet(const var_set &a, const var_set &b) override;
+	virtual var_set transfer(basic_block *bb, const var_set &live_out) override;
+};
+
+dataflow_result<var_set> compute_liveness(control_flow_graph &cfg);
+
+} // namespace block
+#endif
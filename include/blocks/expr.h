@@ -10,6 +10,7 @@ namespace block {
 class expr : public block {
 public:
 	typedef std::shared_ptr<expr> Ptr;
+	BLOCK_KIND(expr, addr_of_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<expr>()); }
 	virtual bool is_same(block::Ptr other) override;
@@ -44,6 +45,7 @@ bool binary_is_same(std::shared_ptr<T> first, block::Ptr second) {
 class unary_expr : public expr {
 public:
 	typedef std::shared_ptr<unary_expr> Ptr;
+	BLOCK_KIND(unary_expr, not_expr)
 	expr::Ptr expr1;
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<unary_expr>()); }
@@ -53,6 +55,7 @@ public:
 class binary_expr : public expr {
 public:
 	typedef std::shared_ptr<binary_expr> Ptr;
+	BLOCK_KIND(binary_expr, mod_expr)
 
 	virtual void dump(std::ostream &, int) override;
 	expr::Ptr expr1;
@@ -64,6 +67,7 @@ public:
 class not_expr : public unary_expr {
 public:
 	typedef std::shared_ptr<not_expr> Ptr;
+	BLOCK_KIND(not_expr, not_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<not_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return unary_is_same(self<not_expr>(), other); }
@@ -72,6 +76,7 @@ public:
 class and_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<and_expr> Ptr;
+	BLOCK_KIND(and_expr, and_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<and_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<and_expr>(), other); }
@@ -80,6 +85,7 @@ public:
 class bitwise_and_expr: public binary_expr {
 public:
 	typedef std::shared_ptr<bitwise_and_expr> Ptr;
+	BLOCK_KIND(bitwise_and_expr, bitwise_and_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<bitwise_and_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<bitwise_and_expr>(), other); }
@@ -89,6 +95,7 @@ public:
 class or_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<or_expr> Ptr;
+	BLOCK_KIND(or_expr, or_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<or_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<or_expr>(), other); }
@@ -97,6 +104,7 @@ public:
 class bitwise_or_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<bitwise_or_expr> Ptr;
+	BLOCK_KIND(bitwise_or_expr, bitwise_or_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<bitwise_or_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<bitwise_or_expr>(), other); }
@@ -105,6 +113,7 @@ public:
 class plus_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<plus_expr> Ptr;
+	BLOCK_KIND(plus_expr, plus_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<plus_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<plus_expr>(), other); }
@@ -113,6 +122,7 @@ public:
 class minus_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<minus_expr> Ptr;
+	BLOCK_KIND(minus_expr, minus_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<minus_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<minus_expr>(), other); }
@@ -121,6 +131,7 @@ public:
 class mul_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<mul_expr> Ptr;
+	BLOCK_KIND(mul_expr, mul_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<mul_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<mul_expr>(), other); }
@@ -129,6 +140,7 @@ public:
 class div_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<div_expr> Ptr;
+	BLOCK_KIND(div_expr, div_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<div_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<div_expr>(), other); }
@@ -136,6 +148,7 @@ public:
 class lt_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<lt_expr> Ptr;
+	BLOCK_KIND(lt_expr, lt_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<lt_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<lt_expr>(), other); }
@@ -143,6 +156,7 @@ public:
 class gt_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<gt_expr> Ptr;
+	BLOCK_KIND(gt_expr, gt_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<gt_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<gt_expr>(), other); }
@@ -150,6 +164,7 @@ public:
 class lte_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<lte_expr> Ptr;
+	BLOCK_KIND(lte_expr, lte_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<lte_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<lte_expr>(), other); }
@@ -157,6 +172,7 @@ public:
 class gte_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<gte_expr> Ptr;
+	BLOCK_KIND(gte_expr, gte_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<gte_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<gte_expr>(), other); }
@@ -164,6 +180,7 @@ public:
 class lshift_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<lshift_expr> Ptr;
+	BLOCK_KIND(lshift_expr, lshift_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<lshift_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<lshift_expr>(), other); }
@@ -171,6 +188,7 @@ public:
 class rshift_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<rshift_expr> Ptr;
+	BLOCK_KIND(rshift_expr, rshift_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<rshift_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<rshift_expr>(), other); }
@@ -178,6 +196,7 @@ public:
 class equals_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<equals_expr> Ptr;
+	BLOCK_KIND(equals_expr, equals_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<equals_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<equals_expr>(), other); }
@@ -186,6 +205,7 @@ public:
 class ne_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<ne_expr> Ptr;
+	BLOCK_KIND(ne_expr, ne_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<ne_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<ne_expr>(), other); }
@@ -194,6 +214,7 @@ public:
 class mod_expr : public binary_expr {
 public:
 	typedef std::shared_ptr<mod_expr> Ptr;
+	BLOCK_KIND(mod_expr, mod_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<mod_expr>()); }
 	virtual bool is_same(block::Ptr other) override { return binary_is_same(self<mod_expr>(), other); }
@@ -201,6 +222,7 @@ public:
 class var_expr : public expr {
 public:
 	typedef std::shared_ptr<var_expr> Ptr;
+	BLOCK_KIND(var_expr, var_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<var_expr>()); }
 
@@ -218,6 +240,7 @@ public:
 class const_expr : public expr {
 public:
 	typedef std::shared_ptr<const_expr> Ptr;
+	BLOCK_KIND(const_expr, string_const)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<const_expr>()); }
 
@@ -231,6 +254,7 @@ public:
 class int_const : public const_expr {
 public:
 	typedef std::shared_ptr<int_const> Ptr;
+	BLOCK_KIND(int_const, int_const)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<int_const>()); }
 
@@ -248,6 +272,7 @@ public:
 class double_const : public const_expr {
 public:
 	typedef std::shared_ptr<double_const> Ptr;
+	BLOCK_KIND(double_const, double_const)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<double_const>()); }
 
@@ -265,6 +290,7 @@ public:
 class float_const : public const_expr {
 public:
 	typedef std::shared_ptr<float_const> Ptr;
+	BLOCK_KIND(float_const, float_const)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<float_const>()); }
 
@@ -283,6 +309,7 @@ public:
 class string_const: public const_expr {
 public:
 	typedef std::shared_ptr<string_const> Ptr;
+	BLOCK_KIND(string_const, string_const)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<string_const>()); }
 
@@ -301,6 +328,7 @@ public:
 class assign_expr : public expr {
 public:
 	typedef std::shared_ptr<assign_expr> Ptr;
+	BLOCK_KIND(assign_expr, assign_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<assign_expr>()); }
 
@@ -321,6 +349,7 @@ public:
 class sq_bkt_expr : public expr {
 public:
 	typedef std::shared_ptr<sq_bkt_expr> Ptr;
+	BLOCK_KIND(sq_bkt_expr, sq_bkt_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<sq_bkt_expr>()); }
 	expr::Ptr var_expr;
@@ -340,6 +369,7 @@ public:
 class function_call_expr : public expr {
 public:
 	typedef std::shared_ptr<function_call_expr> Ptr;
+	BLOCK_KIND(function_call_expr, function_call_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<function_call_expr>()); }
 
@@ -365,6 +395,7 @@ public:
 class initializer_list_expr : public expr {
 public:
 	typedef std::shared_ptr<initializer_list_expr> Ptr;
+	BLOCK_KIND(initializer_list_expr, initializer_list_expr)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<initializer_list_expr>()); }
 
@@ -387,12 +418,14 @@ public:
 class foreign_expr_base : public expr {
 public:
 	typedef std::shared_ptr<foreign_expr_base> Ptr;
+	typedef foreign_expr_base kind_class;
+	static bool classof(const block *b) { return b->kind == block_kind::foreign_expr_base; }
 	// We do not need any other functions because this class is guaranteed
 	// to abstract
 protected:
 	// We will add a protected constructor to make sure that this is truly
 	// abstract
-	foreign_expr_base() = default;
+	foreign_expr_base() { kind = block_kind::foreign_expr_base; }
 };
 template <typename T>
 class foreign_expr : public foreign_expr_base {
@@ -428,6 +461,7 @@ public:
 	std::string member_name;
 		
 	typedef std::shared_ptr<member_access_expr> Ptr;
+	BLOCK_KIND(member_access_expr, member_access_expr)
 	virtual void dump(std::ostream &oss, int i) override;
 	virtual void accept(block_visitor * a) override {
 		a->visit(self<member_access_expr>());
@@ -449,6 +483,7 @@ public:
 	expr::Ptr expr1;
 	
 	typedef std::shared_ptr<addr_of_expr> Ptr;
+	BLOCK_KIND(addr_of_expr, addr_of_expr)
 	virtual void dump(std::ostream &oss, int) override;
 	virtual void accept(block_visitor * a) override {
 		a->visit(self<addr_of_expr>());
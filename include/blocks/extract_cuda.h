@@ -16,8 +16,14 @@
 namespace block {
 
 
+// The kernels are named cuda_kernel_<kernel_counter>, the counter is incremented
+// for each of them. Code that extracts several functions into the same file
+// passes the same counter, the calls without one share total_created_kernels
+// and are not safe to make from several threads
+std::vector<block::Ptr> extract_cuda_from(block::Ptr from, int &kernel_counter);
 std::vector<block::Ptr> extract_cuda_from(block::Ptr from);
 
+block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr>&, int &kernel_counter);
 block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr>&);
 extern int total_created_kernels;
 
@@ -16,14 +16,14 @@ class label_creator : public block_visitor {
 public:
 	using block_visitor::visit;
 	std::vector<tracer::tag> collected_labels;
-	std::unordered_map<std::string, label::Ptr> offset_to_label;
+	std::unordered_map<tracer::tag, label::Ptr> offset_to_label;
 	int current_label = 0;
 	virtual void visit(stmt_block::Ptr);
 };
 class label_inserter : public block_visitor {
 public:
 	using block_visitor::visit;
-	std::unordered_map<std::string, label::Ptr> offset_to_label;
+	std::unordered_map<tracer::tag, label::Ptr> offset_to_label;
 	virtual void visit(goto_stmt::Ptr);
 };
 } // namespace block
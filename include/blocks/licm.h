@@ -0,0 +1,13 @@
+#ifndef BLOCKS_LICM_H
+#define BLOCKS_LICM_H
+#include "blocks/block.h"
+namespace block {
+// Computes the arithmetic exprs of a while or for loop that don't change
+// between iterations once, into a temporary declared before the loop. Only
+// exprs that can't fault are moved, because the loop might not run at all.
+// Exprs that read vars the loop writes, loads and vars the loop could
+// change through pointers or calls stay in the loop. Loops with statements
+// memoization shared with other blocks are left as they are
+void hoist_loop_invariants(block::Ptr ast);
+}
+#endif
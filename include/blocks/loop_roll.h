@@ -8,6 +8,8 @@ namespace block {
 class loop_roll_finder : public block_visitor {
 public:
 	using block_visitor::visit;
+	// Numbers the vars the rolled loops declare
+	int unique_counter = 0;
 	virtual void visit(stmt_block::Ptr);
 };
 
@@ -0,0 +1,78 @@
+#ifndef BLOCKS_NODE_COLLECTOR_H
+#define BLOCKS_NODE_COLLECTOR_H
+#include "blocks/block_visitor.h"
+#include "blocks/stmt.h"
+#include <unordered_set>
+
+namespace block {
+
+// Collects the distinct nodes of an AST, vars and types included. Nodes
+// reachable from multiple parents are walked once. The set holds on to the
+// nodes, so the ones a pass frees can't be confused with new nodes
+// allocated at the same address
+class node_collector : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::unordered_set<block::Ptr> nodes;
+
+	virtual void visit(block::Ptr) override;
+	virtual void visit(expr::Ptr) override;
+	virtual void visit(unary_expr::Ptr) override;
+	virtual void visit(binary_expr::Ptr) override;
+	virtual void visit(not_expr::Ptr) override;
+	virtual void visit(and_expr::Ptr) override;
+	virtual void visit(bitwise_and_expr::Ptr) override;
+	virtual void visit(or_expr::Ptr) override;
+	virtual void visit(bitwise_or_expr::Ptr) override;
+	virtual void visit(plus_expr::Ptr) override;
+	virtual void visit(minus_expr::Ptr) override;
+	virtual void visit(mul_expr::Ptr) override;
+	virtual void visit(div_expr::Ptr) override;
+	virtual void visit(lt_expr::Ptr) override;
+	virtual void visit(gt_expr::Ptr) override;
+	virtual void visit(lte_expr::Ptr) override;
+	virtual void visit(gte_expr::Ptr) override;
+	virtual void visit(lshift_expr::Ptr) override;
+	virtual void visit(rshift_expr::Ptr) override;
+	virtual void visit(equals_expr::Ptr) override;
+	virtual void visit(ne_expr::Ptr) override;
+	virtual void visit(mod_expr::Ptr) override;
+	virtual void visit(var_expr::Ptr) override;
+	virtual void visit(const_expr::Ptr) override;
+	virtual void visit(int_const::Ptr) override;
+	virtual void visit(double_const::Ptr) override;
+	virtual void visit(float_const::Ptr) override;
+	virtual void visit(string_const::Ptr) override;
+	virtual void visit(assign_expr::Ptr) override;
+	virtual void visit(stmt::Ptr) override;
+	virtual void visit(expr_stmt::Ptr) override;
+	virtual void visit(stmt_block::Ptr) override;
+	virtual void visit(decl_stmt::Ptr) override;
+	virtual void visit(if_stmt::Ptr) override;
+	virtual void visit(label::Ptr) override;
+	virtual void visit(label_stmt::Ptr) override;
+	virtual void visit(goto_stmt::Ptr) override;
+	virtual void visit(while_stmt::Ptr) override;
+	virtual void visit(for_stmt::Ptr) override;
+	virtual void visit(break_stmt::Ptr) override;
+	virtual void visit(continue_stmt::Ptr) override;
+	virtual void visit(sq_bkt_expr::Ptr) override;
+	virtual void visit(function_call_expr::Ptr) override;
+	virtual void visit(initializer_list_expr::Ptr) override;
+	virtual void visit(foreign_expr_base::Ptr) override;
+	virtual void visit(member_access_expr::Ptr) override;
+	virtual void visit(addr_of_expr::Ptr) override;
+	virtual void visit(var::Ptr) override;
+	virtual void visit(type::Ptr) override;
+	virtual void visit(scalar_type::Ptr) override;
+	virtual void visit(pointer_type::Ptr) override;
+	virtual void visit(function_type::Ptr) override;
+	virtual void visit(array_type::Ptr) override;
+	virtual void visit(builder_var_type::Ptr) override;
+	virtual void visit(named_type::Ptr) override;
+	virtual void visit(func_decl::Ptr) override;
+	virtual void visit(return_stmt::Ptr) override;
+};
+
+} // namespace block
+#endif
@@ -0,0 +1,37 @@
+#ifndef BLOCKS_OMP_ANNOTATIONS_H
+#define BLOCKS_OMP_ANNOTATIONS_H
+
+#include "blocks/stmt.h"
+#include <string>
+
+// Annotating a for loop with this makes the c_code_generator print it as an
+// OpenMP parallel for. Clauses can follow, separated with ':', like
+// OMP_PARALLEL ":reduction(+):schedule(dynamic,4):collapse(2)"
+#define OMP_PARALLEL "kernel:omp:parallel"
+// Same for an OpenMP simd loop, like OMP_SIMD ":simdlen(8)"
+#define OMP_SIMD "kernel:omp:simd"
+
+namespace block {
+
+// Returns the pragma for a loop annotated with OMP_PARALLEL, an empty string
+// for other loops. The vars the loop uses but doesn't declare are shared,
+// the ones it assigns are lastprivate so they keep the value of the last
+// iteration. With reduction(op) the vars that are only updated with
+// v = v op e are reduction vars instead, for max and min the update is
+// if (e > v) v = e; and if (e < v) v = e;. Other clauses are printed as they are.
+// If the loop is not in the canonical form of OpenMP, or an assigned var
+// carries a value from one iteration to the next, a comment with the reason
+// is returned instead of the pragma. Dependences through memory are not checked
+std::string omp_parallel_pragma(for_stmt::Ptr loop);
+// The annotation stays on the stmt before a loop that could not be turned
+// into a counted for loop. Returns the comment printed in place of the
+// pragma for such a stmt, an empty string for other stmts
+std::string omp_unapplied_comment(stmt::Ptr s);
+// Returns the pragma for a loop annotated with OMP_SIMD, an empty string for
+// other loops. The pointers with "aligned" metadata the loop uses get an
+// aligned clause. Loops that are not in the canonical form get a comment
+// with the reason like omp_parallel_pragma
+std::string omp_simd_pragma(for_stmt::Ptr loop);
+
+} // namespace block
+#endif
@@ -1,7 +1,53 @@
 #ifndef BLOCKS_RCE_H
 #define BLOCKS_RCE_H
 #include "blocks/block.h"
+#include "blocks/block_visitor.h"
+#include "blocks/expr.h"
+#include <unordered_set>
 namespace block {
+// Sets has_side_effects if the visited expr assigns, calls a function
+// or takes an address
+class check_side_effects: public block_visitor {
+public:
+	using block_visitor::visit;
+	bool has_side_effects = false;
+	virtual void visit(assign_expr::Ptr) override {
+		has_side_effects = true;
+	}
+	virtual void visit(function_call_expr::Ptr) override {
+		has_side_effects = true;
+	}
+	virtual void visit(addr_of_expr::Ptr) override {
+		has_side_effects = true;
+	}
+};
+
+// Finds the vars a loop assigns and whether it stores to memory or calls
+// a function, which can change any memory
+class loop_write_finder: public block_visitor {
+public:
+	using block_visitor::visit;
+	std::unordered_set<var *> written_vars;
+	bool writes_memory = false;
+	virtual void visit(assign_expr::Ptr e) override {
+		e->var1->accept(this);
+		e->expr1->accept(this);
+		if (isa<var_expr>(e->var1))
+			written_vars.insert(to<var_expr>(e->var1)->var1.get());
+		else
+			writes_memory = true;
+	}
+	virtual void visit(function_call_expr::Ptr e) override {
+		block_visitor::visit(e);
+		writes_memory = true;
+	}
+};
+
+// Substitutes the inits of decls that are copies of a var or that are used
+// once into their uses, wherever the init still has the same value. Where
+// that holds is computed with a dataflow problem on the CFG, an init isn't
+// moved into a loop its decl is outside of. Stores to local vars that aren't
+// live are removed and then the decls that aren't used anymore
 void eliminate_redundant_vars(block::Ptr ast);
 }
 #endif
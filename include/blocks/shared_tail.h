@@ -0,0 +1,19 @@
+#ifndef BLOCKS_SHARED_TAIL_H
+#define BLOCKS_SHARED_TAIL_H
+#include "blocks/stmt.h"
+namespace block {
+class shared_tail_stats {
+public:
+	unsigned long long tails_shared = 0;
+	// Estimated from the code generated for the copies that were replaced
+	unsigned long long bytes_saved = 0;
+};
+// Memoization copies the statements after the point two paths merge at into
+// both paths, so code with early exits can end in many copies of the same
+// tail. Tails that end the function in more than one place and generate at
+// least min_bytes bytes of code are kept once behind a label, the other
+// copies are replaced with gotos. Tails inside loops are left alone, so this
+// runs after the loops are recovered
+shared_tail_stats share_tails(stmt::Ptr ast, unsigned long long min_bytes);
+} // namespace block
+#endif
@@ -6,6 +6,7 @@ namespace block {
 class stmt : public block {
 public:
 	typedef std::shared_ptr<stmt> Ptr;
+	BLOCK_KIND(stmt, return_stmt)
 	std::string annotation;
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<stmt>()); }
@@ -20,6 +21,7 @@ public:
 class expr_stmt : public stmt {
 public:
 	typedef std::shared_ptr<expr_stmt> Ptr;
+	BLOCK_KIND(expr_stmt, expr_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<expr_stmt>()); }
 
@@ -38,6 +40,7 @@ public:
 class stmt_block : public stmt {
 public:
 	typedef std::shared_ptr<stmt_block> Ptr;
+	BLOCK_KIND(stmt_block, stmt_block)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<stmt_block>()); }
 
@@ -60,6 +63,7 @@ public:
 class decl_stmt : public stmt {
 public:
 	typedef std::shared_ptr<decl_stmt> Ptr;
+	BLOCK_KIND(decl_stmt, decl_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<decl_stmt>()); }
 
@@ -87,6 +91,7 @@ public:
 class if_stmt : public stmt {
 public:
 	typedef std::shared_ptr<if_stmt> Ptr;
+	BLOCK_KIND(if_stmt, if_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<if_stmt>()); }
 
@@ -106,15 +111,15 @@ public:
 		return true;
 	}
 	virtual bool needs_splitting(if_stmt::Ptr other) {
-		if (is_same(other))
+		if (is_same_fast(self<if_stmt>(), other))
 			return false;
 		if (static_offset != other->static_offset)
 			return false;
-		if (!then_stmt->is_same(other->then_stmt))
+		if (!is_same_fast(then_stmt, other->then_stmt))
 			return false;
-		if (!else_stmt->is_same(other->else_stmt))
+		if (!is_same_fast(else_stmt, other->else_stmt))
 			return false;
-		if (!cond->is_same(other->cond))
+		if (!is_same_fast(cond, other->cond))
 			return true;
 		assert(false && "Statement unreachable");
 	}
@@ -122,6 +127,7 @@ public:
 class label : public block {
 public:
 	typedef std::shared_ptr<label> Ptr;
+	BLOCK_KIND(label, label)
 	virtual void dump(std::ostream &, int) override;
 	std::string label_name;
 	virtual void accept(block_visitor *a) override { a->visit(self<label>()); }
@@ -137,6 +143,7 @@ public:
 class label_stmt : public stmt {
 public:
 	typedef std::shared_ptr<label_stmt> Ptr;
+	BLOCK_KIND(label_stmt, label_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<label_stmt>()); }
 
@@ -153,6 +160,7 @@ public:
 class goto_stmt : public stmt {
 public:
 	typedef std::shared_ptr<goto_stmt> Ptr;
+	BLOCK_KIND(goto_stmt, goto_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<goto_stmt>()); }
 
@@ -178,6 +186,7 @@ public:
 class while_stmt : public stmt {
 public:
 	typedef std::shared_ptr<while_stmt> Ptr;
+	BLOCK_KIND(while_stmt, while_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<while_stmt>()); }
 	stmt::Ptr body;
@@ -199,6 +208,7 @@ public:
 class for_stmt : public stmt {
 public:
 	typedef std::shared_ptr<for_stmt> Ptr;
+	BLOCK_KIND(for_stmt, for_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<for_stmt>()); }
 	stmt::Ptr decl_stmt;
@@ -225,6 +235,7 @@ class break_stmt : public stmt {
 public:
 	std::string type;
 	typedef std::shared_ptr<break_stmt> Ptr;
+	BLOCK_KIND(break_stmt, break_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<break_stmt>()); }
 	virtual bool is_same(block::Ptr other) override {
@@ -236,6 +247,7 @@ public:
 class continue_stmt : public stmt {
 public:
 	typedef std::shared_ptr<continue_stmt> Ptr;
+	BLOCK_KIND(continue_stmt, continue_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<continue_stmt>()); }
 	virtual bool is_same(block::Ptr other) override {
@@ -248,6 +260,7 @@ public:
 class func_decl : public stmt {
 public:
 	typedef std::shared_ptr<func_decl> Ptr;
+	BLOCK_KIND(func_decl, func_decl)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<func_decl>()); }
 	std::string func_name;
@@ -276,6 +289,7 @@ public:
 class return_stmt : public stmt {
 public:
 	typedef std::shared_ptr<return_stmt> Ptr;
+	BLOCK_KIND(return_stmt, return_stmt)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<return_stmt>()); }
 	expr::Ptr return_val;
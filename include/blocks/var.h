@@ -8,6 +8,7 @@ namespace block {
 class type : public block {
 public:
 	typedef std::shared_ptr<type> Ptr;
+	BLOCK_KIND(type, named_type)
 
 	virtual void accept(block_visitor *a) override { a->visit(self<type>()); }
 	virtual void dump(std::ostream &, int) override;
@@ -15,6 +16,7 @@ public:
 class scalar_type : public type {
 public:
 	typedef std::shared_ptr<scalar_type> Ptr;
+	BLOCK_KIND(scalar_type, scalar_type)
 	enum {SHORT_INT_TYPE, UNSIGNED_SHORT_INT_TYPE, INT_TYPE, UNSIGNED_INT_TYPE, LONG_INT_TYPE, UNSIGNED_LONG_INT_TYPE, LONG_LONG_INT_TYPE, UNSIGNED_LONG_LONG_INT_TYPE, CHAR_TYPE, UNSIGNED_CHAR_TYPE, VOID_TYPE, FLOAT_TYPE, DOUBLE_TYPE, BOOL_TYPE, SIGNED_CHAR_TYPE} scalar_type_id;
 	virtual void accept(block_visitor *a) override { a->visit(self<scalar_type>()); }
 	virtual void dump(std::ostream &, int) override;
@@ -23,6 +25,7 @@ public:
 class pointer_type : public type {
 public:
 	typedef std::shared_ptr<pointer_type> Ptr;
+	BLOCK_KIND(pointer_type, pointer_type)
 	type::Ptr pointee_type;
 	virtual void accept(block_visitor *a) override { a->visit(self<pointer_type>()); }
 	virtual void dump(std::ostream &, int) override;
@@ -30,6 +33,7 @@ public:
 class function_type : public type {
 public:
 	typedef std::shared_ptr<function_type> Ptr;
+	BLOCK_KIND(function_type, function_type)
 	virtual void accept(block_visitor *a) override { a->visit(self<function_type>()); }
 
 	type::Ptr return_type;
@@ -40,6 +44,7 @@ public:
 class array_type : public type {
 public:
 	typedef std::shared_ptr<array_type> Ptr;
+	BLOCK_KIND(array_type, array_type)
 	virtual void accept(block_visitor *a) override { a->visit(self<array_type>()); }
 	type::Ptr element_type;
 	int size;
@@ -51,6 +56,7 @@ public:
 class builder_var_type : public type {
 public:
 	typedef std::shared_ptr<builder_var_type> Ptr;
+	BLOCK_KIND(builder_var_type, builder_var_type)
 	enum { DYN_VAR, STATIC_VAR } builder_var_type_id;
 	virtual void accept(block_visitor *a) override { a->visit(self<builder_var_type>()); }
 	type::Ptr closure_type;
@@ -61,6 +67,7 @@ public:
 class named_type : public type {
 public:
 	typedef std::shared_ptr<named_type> Ptr;
+	BLOCK_KIND(named_type, named_type)
 	std::string type_name;
 	std::vector<type::Ptr> template_args;
 	virtual void accept(block_visitor *a) override { a->visit(self<named_type>()); }
@@ -71,6 +78,7 @@ public:
 class var : public block {
 public:
 	typedef std::shared_ptr<var> Ptr;
+	BLOCK_KIND(var, var)
 	virtual void dump(std::ostream &, int) override;
 	virtual void accept(block_visitor *a) override { a->visit(self<var>()); }
 	// Optional var_name
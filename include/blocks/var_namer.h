@@ -4,7 +4,7 @@
 #include "blocks/block_visitor.h"
 #include "blocks/block_replacer.h"
 #include "blocks/stmt.h"
-#include <map>
+#include <unordered_map>
 
 namespace block {
 
@@ -12,9 +12,9 @@ class var_namer: public block_visitor {
 public:
 	using block_visitor::visit;
 	int var_counter = 0;
-	std::map<std::string, var::Ptr> collected_decls;
-	std::map<std::string, decl_stmt::Ptr> decls_to_hoist;
-	std::vector<std::string> decl_tags_to_hoist;
+	std::unordered_map<tracer::tag, var::Ptr> collected_decls;
+	std::unordered_map<tracer::tag, decl_stmt::Ptr> decls_to_hoist;
+	std::vector<tracer::tag> decl_tags_to_hoist;
 	virtual void visit(decl_stmt::Ptr) override;
 
 	static void name_vars(block::Ptr ast);
@@ -23,8 +23,8 @@ public:
 class var_replacer: public block_visitor {
 public:
 	using block_visitor::visit;
-	std::map<std::string, var::Ptr> &collected_decls;
-	var_replacer(std::map<std::string, var::Ptr> &d): collected_decls(d) {}
+	std::unordered_map<tracer::tag, var::Ptr> &collected_decls;
+	var_replacer(std::unordered_map<tracer::tag, var::Ptr> &d): collected_decls(d) {}
 	
 	virtual void visit (var_expr::Ptr) override;
 
@@ -33,8 +33,8 @@ public:
 class var_hoister: public block_replacer {
 public:
 	using block_replacer::visit;
-	std::map<std::string, decl_stmt::Ptr> &decls_to_hoist;
-	var_hoister(std::map<std::string, decl_stmt::Ptr> &d): decls_to_hoist(d) {}
+	std::unordered_map<tracer::tag, decl_stmt::Ptr> &decls_to_hoist;
+	var_hoister(std::unordered_map<tracer::tag, decl_stmt::Ptr> &d): decls_to_hoist(d) {}
 	virtual void visit (decl_stmt::Ptr) override;
 };
 
@@ -18,7 +18,7 @@ template <>
 class type_extractor<bool> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::BOOL_TYPE;
 		return type;
 	}
@@ -28,7 +28,7 @@ template <>
 class type_extractor<signed char> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::SIGNED_CHAR_TYPE;
 		return type;
 	}
@@ -38,7 +38,7 @@ template <>
 class type_extractor<short int> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::SHORT_INT_TYPE;
 		return type;
 	}
@@ -48,7 +48,7 @@ template <>
 class type_extractor<unsigned short int> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::UNSIGNED_SHORT_INT_TYPE;
 		return type;
 	}
@@ -59,7 +59,7 @@ template <>
 class type_extractor<int> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::INT_TYPE;
 		return type;
 	}
@@ -69,7 +69,7 @@ template <>
 class type_extractor<unsigned int> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::UNSIGNED_INT_TYPE;
 		return type;
 	}
@@ -78,7 +78,7 @@ template <>
 class type_extractor<long int> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::LONG_INT_TYPE;
 		return type;
 	}
@@ -88,7 +88,7 @@ template <>
 class type_extractor<unsigned long int> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::UNSIGNED_LONG_INT_TYPE;
 		return type;
 	}
@@ -97,7 +97,7 @@ template <>
 class type_extractor<long long int> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::LONG_LONG_INT_TYPE;
 		return type;
 	}
@@ -107,7 +107,7 @@ template <>
 class type_extractor<unsigned long long int> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::UNSIGNED_LONG_LONG_INT_TYPE;
 		return type;
 	}
@@ -117,7 +117,7 @@ template <>
 class type_extractor<char> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::CHAR_TYPE;
 		return type;
 	}
@@ -127,7 +127,7 @@ template <>
 class type_extractor<unsigned char> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::UNSIGNED_CHAR_TYPE;
 		return type;
 	}
@@ -137,7 +137,7 @@ template <>
 class type_extractor<float> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::FLOAT_TYPE;
 		return type;
 	}
@@ -147,7 +147,7 @@ template <>
 class type_extractor<double> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::DOUBLE_TYPE;
 		return type;
 	}
@@ -158,7 +158,7 @@ template <typename T>
 class type_extractor<T *> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::pointer_type::Ptr type = std::make_shared<block::pointer_type>();
+		block::pointer_type::Ptr type = block::make_node<block::pointer_type>();
 		type->pointee_type = type_extractor<T>::extract_type();
 		return type;
 	}
@@ -168,7 +168,7 @@ template <>
 class type_extractor<void> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+		block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 		type->scalar_type_id = block::scalar_type::VOID_TYPE;
 		return type;
 	}
@@ -179,7 +179,7 @@ template <typename T, int x>
 class type_extractor<T[x]> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::array_type::Ptr type = std::make_shared<block::array_type>();
+		block::array_type::Ptr type = block::make_node<block::array_type>();
 		type->element_type = type_extractor<T>::extract_type();
 		type->size = x;
 		return type;
@@ -202,7 +202,7 @@ template <typename T>
 class type_extractor<dyn_var<T>> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::builder_var_type::Ptr type = std::make_shared<block::builder_var_type>();
+		block::builder_var_type::Ptr type = block::make_node<block::builder_var_type>();
 		type->builder_var_type_id = block::builder_var_type::DYN_VAR;
 		type->closure_type = type_extractor<T>::extract_type();
 		return type;
@@ -212,7 +212,7 @@ template <typename T>
 class type_extractor<static_var<T>> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::builder_var_type::Ptr type = std::make_shared<block::builder_var_type>();
+		block::builder_var_type::Ptr type = block::make_node<block::builder_var_type>();
 		type->builder_var_type_id = block::builder_var_type::STATIC_VAR;
 		type->closure_type = type_extractor<T>::extract_type();
 		return type;
@@ -242,7 +242,7 @@ template <typename r_type, typename... a_types>
 class type_extractor<r_type(a_types...)> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::function_type::Ptr type = std::make_shared<block::function_type>();
+		block::function_type::Ptr type = block::make_node<block::function_type>();
 		type->return_type = type_extractor<r_type>::extract_type();
 		type->arg_types = extract_type_vector_dyn<a_types...>();
 		std::reverse(type->arg_types.begin(), type->arg_types.end());
@@ -279,7 +279,7 @@ template <const char* N, typename...Args>
 class type_extractor<name<N, Args...>> {
 public:
 	static block::type::Ptr extract_type(void) {
-		block::named_type::Ptr type = std::make_shared<block::named_type>();
+		block::named_type::Ptr type = block::make_node<block::named_type>();
 		type->type_name = N;
 		type->template_args = extract_type_from_args<Args...>::get_types();
 		return type;	
@@ -80,7 +80,7 @@ public:
 			return;
 		}
 
-		block::int_const::Ptr int_const = std::make_shared<block::int_const>();
+		block::int_const::Ptr int_const = block::make_node<block::int_const>();
 		tracer::tag offset = get_offset_in_function();
 		int_const->static_offset = offset;
 		int_const->value = a;
@@ -96,7 +96,7 @@ public:
 			return;
 		}
 
-		block::double_const::Ptr double_const = std::make_shared<block::double_const>();
+		block::double_const::Ptr double_const = block::make_node<block::double_const>();
 		tracer::tag offset = get_offset_in_function();
 		double_const->static_offset = offset;
 		double_const->value = a;
@@ -111,7 +111,7 @@ public:
 			return;
 		}
 
-		block::float_const::Ptr float_const = std::make_shared<block::float_const>();
+		block::float_const::Ptr float_const = block::make_node<block::float_const>();
 		tracer::tag offset = get_offset_in_function();
 		float_const->static_offset = offset;
 		float_const->value = a;
@@ -129,7 +129,7 @@ public:
 			return;
 		}
 
-		block::string_const::Ptr string_const = std::make_shared<block::string_const>();
+		block::string_const::Ptr string_const = block::make_node<block::string_const>();
 		tracer::tag offset = get_offset_in_function();
 		string_const->static_offset = offset;
 		string_const->value = s;
@@ -159,7 +159,7 @@ public:
 		builder_context::current_builder_context->remove_node_from_sequence(block_expr);
 		tracer::tag offset = get_offset_in_function();
 
-		typename T::Ptr expr = std::make_shared<T>();
+		typename T::Ptr expr = block::make_node<T>();
 		expr->static_offset = offset;
 		expr->expr1 = block_expr;
 		builder_context::current_builder_context->add_node_to_sequence(expr);
@@ -181,7 +181,7 @@ public:
 
 		tracer::tag offset = get_offset_in_function();
 
-		typename T::Ptr expr = std::make_shared<T>();
+		typename T::Ptr expr = block::make_node<T>();
 		expr->static_offset = offset;
 
 		expr->expr1 = block_expr;
@@ -206,7 +206,7 @@ public:
 		tracer::tag offset = get_offset_in_function();
 		// assert(offset != -1);
 
-		block::sq_bkt_expr::Ptr expr = std::make_shared<block::sq_bkt_expr>();
+		block::sq_bkt_expr::Ptr expr = block::make_node<block::sq_bkt_expr>();
 		expr->static_offset = offset;
 
 		expr->var_expr = block_expr;
@@ -232,7 +232,7 @@ public:
 		builder_context::current_builder_context->remove_node_from_sequence(a.block_expr);
 		tracer::tag offset = get_offset_in_function();
 
-		block::assign_expr::Ptr expr = std::make_shared<block::assign_expr>();
+		block::assign_expr::Ptr expr = block::make_node<block::assign_expr>();
 		expr->static_offset = offset;
 
 		expr->var1 = block_expr;
@@ -263,7 +263,7 @@ public:
 		builder_context::current_builder_context->remove_node_from_sequence(block_expr);
 		tracer::tag offset = get_offset_in_function();
 
-		block::function_call_expr::Ptr expr = std::make_shared<block::function_call_expr>();
+		block::function_call_expr::Ptr expr = block::make_node<block::function_call_expr>();
 		expr->static_offset = offset;
 
 		expr->expr1 = block_expr;
@@ -340,7 +340,7 @@ template <typename T>
 block::expr::Ptr create_foreign_expr(const T t) {
 	assert(builder_context::current_builder_context != nullptr);
 	tracer::tag offset = get_offset_in_function();
-	typename block::foreign_expr<T>::Ptr expr = std::make_shared<block::foreign_expr<T>>();
+	typename block::foreign_expr<T>::Ptr expr = block::make_node<block::foreign_expr<T>>();
 	expr->static_offset = offset;
 	expr->inner_expr = t;
 	builder_context::current_builder_context->add_node_to_sequence(expr);
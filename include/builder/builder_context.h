@@ -2,9 +2,17 @@
 #define BUILDER_CONTEXT
 #include "blocks/expr.h"
 #include "blocks/stmt.h"
+#include "builder/extraction_stats.h"
 #include "builder/forward_declarations.h"
+#include "builder/pass_manager.h"
+#include "util/persistent_set.h"
+#include "util/persistent_vector.h"
+#include "util/thread_pool.h"
+#include <atomic>
 #include <functional>
-#include <list>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -24,13 +32,20 @@ class tracking_tuple {
 public:
 	const unsigned char *ptr;
 	uint32_t size;
+	// Contribution of this variable to the static var hash of the context
+	unsigned long long hash_high = 0;
+	unsigned long long hash_low = 0;
+	// A non const reference to the variable was handed out, it can change
+	// without an update so it is hashed again whenever a tag is captured
+	bool escaped = false;
 	tracking_tuple(const unsigned char *_ptr, uint32_t _size) : ptr(_ptr), size(_size) {}
+	// Hex dump of the value, only used to print the stacks of tags
 	std::string snapshot(void) {
-		std::string output_string;
-		char temp[4];
+		static const char digits[] = "0123456789abcdef";
+		std::string output_string(2 * size, '0');
 		for (unsigned int i = 0; i < size; i++) {
-			sprintf(temp, "%02x", ptr[i]);
-			output_string += temp;
+			output_string[2 * i] = digits[ptr[i] >> 4];
+			output_string[2 * i + 1] = digits[ptr[i] & 0xf];
 		}
 		return output_string;
 	}
@@ -38,52 +53,192 @@ public:
 
 class tag_map {
 public:
-	std::unordered_map<std::string, block::stmt_block::Ptr> map;
+	std::unordered_map<tracer::tag, block::stmt_block::Ptr> map;
+	// Guards the map when branches are explored in parallel
+	std::recursive_mutex lock;
+
+	// Tags updated while track_changes is set. A forked child sends
+	// these back so the parent sees the same table as in the serial mode
+	bool track_changes = false;
+	std::unordered_set<tracer::tag> changed_tags;
+
+	tag_map() = default;
+	tag_map(const tag_map &other) : map(other.map) {}
+
+	void set(const tracer::tag &t, block::stmt_block::Ptr b) {
+		map[t] = b;
+		if (track_changes)
+			changed_tags.insert(t);
+	}
+	void erase(const tracer::tag &t) {
+		auto it = map.find(t);
+		if (it == map.end())
+			return;
+		map.erase(it);
+		if (track_changes)
+			changed_tags.insert(t);
+	}
+};
+
+// Branch decisions of the path a context replays, oldest first
+class decision_path {
+public:
+	util::persistent_vector<bool> decisions;
+	size_t next = 0;
+
+	// Decisions left to replay
+	size_t size(void) const { return decisions.size() - next; }
+	bool take_next(void) { return decisions[next++]; }
 };
 
 void lambda_wrapper(void);
 void lambda_wrapper_close(void);
 void lambda_wrapper_impl(void);
 
+class builder_context;
+// State shared by all the processes forked from the same extraction
+struct fork_state;
+// An independent function to extract, created with make_extraction_job
+typedef std::function<block::stmt::Ptr(builder_context &)> extraction_job;
+
 class builder_context {
 public:
-	static builder_context *current_builder_context;
-	static int debug_creation_counter;
+	static thread_local builder_context *current_builder_context;
+	static std::atomic<int> debug_creation_counter;
 
 	std::function<void(void)> internal_stored_lambda;
 	std::function<void(void)> current_function;
 
-	std::list<block::block::Ptr> uncommitted_sequence;
+	// Removed nodes are left as nullptr, uncommitted_index has the position
+	// of the live ones so removing a node doesn't search the sequence
+	std::vector<block::block::Ptr> uncommitted_sequence;
+	std::unordered_map<block::block *, size_t> uncommitted_index;
+	// Statements the committed expressions were wrapped in, for the
+	// expressions removed after they were committed
+	std::unordered_map<block::block *, block::expr_stmt::Ptr> committed_exprs;
 	block::stmt::Ptr ast;
 	block::stmt_block::Ptr current_block_stmt;
 
-	std::vector<bool> bool_vector;
-	std::unordered_set<std::string> visited_offsets;
+	// The containers below are persistent, the contexts exploring the two
+	// sides of a branch share them with the parent instead of copying
+	decision_path bool_vector;
+	util::persistent_set<tracer::tag> visited_offsets;
 	
-	std::vector<block::expr::Ptr> expr_sequence;
+	util::persistent_vector<block::expr::Ptr> expr_sequence;
 	unsigned long long expr_counter = 0;
+	// Variables declared so far, reused when the execution is replayed
+	// so the replay doesn't have to trace them again. This only makes each
+	// replayed step cheaper. Every child context still runs the function
+	// from the start, so the prefix up to the branch is executed again and
+	// extraction stays quadratic in the length of the deepest path.
+	util::persistent_vector<block::var::Ptr> var_sequence;
+	unsigned long long var_counter = 0;
 
 	tag_map _internal_tags;
 	tag_map *memoized_tags;
 
+	extraction_stats _internal_stats;
+	// Shared with the contexts that explore branches
+	extraction_stats *stats;
+
 
 	// Flags for controlling BuildIt extraction
 	// and code generation behavior
 	bool use_memoization = true;
+	// Enables or disables the eliminate_redundant_vars pass
 	bool run_rce = false;
+	// Enables or disables the fold_constants pass
+	bool run_const_fold = false;
+	// Enables or disables the eliminate_common_subexprs pass
+	bool run_cse = false;
+	// Enables or disables the hoist_loop_invariants pass
+	bool run_licm = false;
+	// Enables the share_tails pass. Tails of the function that memoization
+	// copied into several paths and that generate at least this many bytes
+	// of code are emitted once and reached with gotos. 0 disables it, the
+	// pass doesn't run with feature_unstructured which never copies tails
+	unsigned long long shared_tail_threshold = 0;
 	bool feature_unstructured = false;
+	// Passes run on the AST after the extraction. Only the context
+	// the extraction starts in has them, the contexts exploring branches
+	// are created with a memoization table and don't run any passes. The
+	// flags above decide if their passes run and override set_enabled
+	pass_manager passes;
 	bool dynamic_use_cxx = false;
 	std::string dynamic_header_includes = "";
 
+	// Persistent memoization cache. If set, the memoization table is loaded from this
+	// file before the extraction and written back after it, so an unchanged function
+	// is mostly extracted from the cache. A file is only reused by the same binary
+	std::string memoization_cache_file = "";
+	// Has to identify any input other than the binary the generated code depends on
+	std::string memoization_cache_key = "";
+
+	// Budgets for the extraction, 0 disables a budget. When one is exceeded the
+	// extraction throws an ExtractionBudgetException with a report of the stats
+	unsigned long long max_executions = 0;
+	unsigned long long max_branch_depth = 0;
+	double max_extraction_seconds = 0;
+	// Counts one more execution and returns the executions so far. Paths explored
+	// concurrently aren't counted past the first execution over max_executions
+	unsigned long long count_execution(void);
+	void check_extraction_budget(unsigned long long branch_depth, unsigned long long executions);
+
+	// Explore the true and false paths of a branch in parallel.
+	// The staged code is re-executed on multiple threads, so it should
+	// not mutate unsynchronized global state. The generated code is
+	// identical to the serial mode. With memoization only the replays of the
+	// paths overlap, without it the paths are explored independently
+	bool use_parallel_exploration = false;
+	// Number of threads to use, 0 uses all the available cores
+	unsigned int parallel_exploration_threads = 0;
+	// Pool shared by all the contexts forked from the same extraction
+	util::work_stealing_pool *exploration_pool = nullptr;
+	// Path that has to be fully explored before this context adds statements
+	util::work_stealing_pool::task *preceding_path = nullptr;
+	void wait_for_preceding_path(void);
+
+	// Explore the true and false paths of a branch in forked processes. The
+	// children continue the execution from the branch instead of replaying it
+	// and send the statements they generate back over a pipe. The generated code
+	// is identical to the serial mode. With memoization the false path is only
+	// forked after the true path is done. The process should be single threaded,
+	// this mode is ignored if use_parallel_exploration is set
+	bool use_fork_exploration = false;
+	// Bounds the number of forked processes alive at once, branches
+	// beyond that are explored in process by replaying
+	unsigned int max_fork_children = 64;
+	fork_state *shared_fork_state = nullptr;
+	// Set in a forked child, the pipe the statements of this context are sent to
+	int fork_result_fd = -1;
+	// Blocks created before this creation_id are shared with the parent process
+	unsigned long long fork_epoch = 0;
+	// Stats of the parent at the time of the fork, a child sends back what it added
+	std::shared_ptr<extraction_stats> fork_baseline;
+	// Branches this context took by forking, replays of the context have to repeat them
+	std::vector<bool> forked_decisions;
+	// Paths explored by forked children for the OutOfBoolsException handler
+	block::stmt_block::Ptr forked_true_ast;
+	block::stmt_block::Ptr forked_false_ast;
+	// Returns true in the children with the value of the branch
+	bool explore_forked_paths(bool &value);
+	pid_t fork_path(bool value, int &read_fd);
+	block::stmt_block::Ptr collect_forked_path(pid_t pid, int read_fd);
+	// Sends the path and the stats to the parent and exits. Without a path
+	// only the stats are sent and the parent explores the path itself
+	void send_forked_path(block::stmt::Ptr path_ast);
+
 	bool is_visited_tag(tracer::tag &new_tag);
 	void erase_tag(tracer::tag &erase_tag);
 
 	builder_context(tag_map *_map = nullptr) {
 		if (_map == nullptr) {
 			memoized_tags = &_internal_tags;
+			passes = pass_manager::default_pipeline();
 		} else {
 			memoized_tags = _map;
 		}
+		stats = &_internal_stats;
 		current_block_stmt = nullptr;
 		ast = nullptr;
 
@@ -102,21 +257,44 @@ public:
 	}
 	block::stmt::Ptr extract_ast_from_lambda(std::function<void(void)>);
 	block::stmt::Ptr extract_ast_from_function_impl(void);
-	block::stmt::Ptr extract_ast_from_function_internal(std::vector<bool> bl = std::vector<bool>());
+	block::stmt::Ptr extract_ast_from_function_internal(util::persistent_vector<bool> bl = util::persistent_vector<bool>());
+	// Copies the flags, the budgets and the passes to another context
+	void copy_extraction_settings(builder_context &other);
+	// Copies the extraction settings to a context that explores a branch
+	void inherit_child_context(builder_context &child);
 
 	block::func_decl::Ptr current_func_decl;
 	template <typename F, typename... OtherArgs>
 	block::stmt::Ptr extract_function_ast(F func_input, std::string func_name, OtherArgs&&... other_args) {
-		current_func_decl = std::make_shared<block::func_decl>();
+		current_func_decl = block::make_node<block::func_decl>();
 		current_func_decl->func_name = func_name;
 		// The extract_signature_from_lambda will update the return type
 		current_func_decl->body = extract_ast_from_lambda(extract_signature_from_lambda<F, OtherArgs&...>::from(this, func_input, func_name, other_args...));
 		return current_func_decl;
 	}
+	// Extracts independent functions concurrently. Every job runs in a fresh context
+	// with the settings of this context. The results are in the same order as the jobs,
+	// so are the stats of each job if job_stats is set. A job's memoization cache file
+	// is the one of this context with the index of the job appended. With
+	// use_fork_exploration the jobs fork from a multithreaded process, the staged
+	// code must not hold locks another job could be holding
+	std::vector<block::stmt::Ptr> extract_function_asts(const std::vector<extraction_job> &jobs, unsigned int num_threads = 0,
+							    std::vector<extraction_stats> *job_stats = nullptr);
 
 	std::string current_label;
 
 	std::vector<tracking_tuple> static_var_tuples;
+	// Sum of the hashes of all the static_var_tuples. It is updated on every
+	// write to a static_var, so capturing a tag doesn't read the variables
+	unsigned long long static_var_hash_high = 0;
+	unsigned long long static_var_hash_low = 0;
+	unsigned int push_static_var(const unsigned char *ptr, uint32_t size);
+	void pop_static_var(void);
+	void update_static_var(unsigned int index);
+	// For the static vars that can be written without an update
+	bool has_escaped_static_vars = false;
+	void escape_static_var(unsigned int index);
+	void update_escaped_static_vars(void);
 
 	std::vector<var *> assume_variables;
 
@@ -135,6 +313,14 @@ public:
 bool get_next_bool_from_context(builder_context *context, block::expr::Ptr);
 tracer::tag get_offset_in_function(void);
 
+// Packs the arguments of extract_function_ast into a job, the arguments are copied
+template <typename F, typename... OtherArgs>
+extraction_job make_extraction_job(F func_input, std::string func_name, OtherArgs... other_args) {
+	return [=](builder_context &context) mutable -> block::stmt::Ptr {
+		return context.extract_function_ast(func_input, func_name, other_args...);
+	};
+}
+
 } // namespace builder
 
 #endif
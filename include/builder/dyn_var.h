@@ -135,31 +135,39 @@ public:
 
 	void create_dyn_var(bool create_without_context = false) {
 		if (create_without_context) {
-			block::var::Ptr dyn_var = std::make_shared<block::var>();
+			block::var::Ptr dyn_var = block::make_node<block::var>();
 			dyn_var->var_type = create_block_type();
 			block_var = dyn_var;
 			// Don't try to obtain preferred names for objects created without context
 			//dyn_var->preferred_name = util::find_variable_name(this);
 			return;
 		}
-		assert(builder_context::current_builder_context != nullptr);
-		assert(builder_context::current_builder_context->current_block_stmt != nullptr);
-		builder_context::current_builder_context->commit_uncommitted();
-		block::var::Ptr dyn_var = std::make_shared<block::var>();
+		builder_context *ctx = builder_context::current_builder_context;
+		assert(ctx != nullptr);
+		assert(ctx->current_block_stmt != nullptr);
+		ctx->commit_uncommitted();
+		block_decl_stmt = nullptr;
+		if (ctx->bool_vector.size() > 0) {
+			// The same variable was created when this part was executed the first time.
+			// The prefix is still executed again, only the tracing and the
+			// allocation of the block::var are skipped
+			assert(ctx->var_counter < ctx->var_sequence.size());
+			block_var = ctx->var_sequence[ctx->var_counter++];
+			return;
+		}
+		block::var::Ptr dyn_var = block::make_node<block::var>();
 		dyn_var->var_type = create_block_type();
 		tracer::tag offset = get_offset_in_function();
-		dyn_var->preferred_name = util::find_variable_name_cached(this, offset.stringify());
+		dyn_var->preferred_name = util::find_variable_name_cached(this, offset);
 		block_var = dyn_var;
 		dyn_var->static_offset = offset;
-		block_decl_stmt = nullptr;
-		if (builder_context::current_builder_context->bool_vector.size() > 0)
-			return;
-		block::decl_stmt::Ptr decl_stmt = std::make_shared<block::decl_stmt>();
+		ctx->var_sequence.push_back(dyn_var);
+		block::decl_stmt::Ptr decl_stmt = block::make_node<block::decl_stmt>();
 		decl_stmt->static_offset = offset;
 		decl_stmt->decl_var = dyn_var;
 		decl_stmt->init_expr = nullptr;
 		block_decl_stmt = decl_stmt;
-		builder_context::current_builder_context->add_stmt_to_current_block(decl_stmt);
+		ctx->add_stmt_to_current_block(decl_stmt);
 	}
 
 	dyn_var_impl() {
@@ -173,7 +181,9 @@ public:
 			var_name = v.name;
 		} else {
 			create_dyn_var(false); 
-			block_var->var_name = v.name;
+			// Replayed variables are shared and already have the name
+			if (block_var->var_name != v.name)
+				block_var->var_name = v.name;
 			var_name = v.name;
 		}
 		// Now that we have created the block_var, we need to leak a reference
@@ -262,7 +272,7 @@ public:
 			return;
 		}	
 		tracer::tag offset = get_offset_in_function();
-		block::initializer_list_expr::Ptr list_expr = std::make_shared<block::initializer_list_expr>();
+		block::initializer_list_expr::Ptr list_expr = block::make_node<block::initializer_list_expr>();
 		list_expr->static_offset = offset;
 		for (unsigned int i = 0; i < a.size(); i++) {
 			list_expr->elems.push_back(a[i].block_expr);
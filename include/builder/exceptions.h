@@ -3,6 +3,7 @@
 #include "blocks/stmt.h"
 #include "util/tracer.h"
 #include <exception>
+#include <string>
 
 namespace builder {
 struct OutOfBoolsException : public std::exception {
@@ -20,6 +21,12 @@ struct MemoizationException : public std::exception {
 	block::stmt_block::Ptr parent;
 	int32_t child_id;
 };
+// Thrown when an extraction exceeds one of the budgets set on the context
+struct ExtractionBudgetException : public std::exception {
+	ExtractionBudgetException(std::string _report) : report(_report) {}
+	virtual const char *what() const noexcept override { return report.c_str(); }
+	std::string report;
+};
 } // namespace builder
 
 #endif
@@ -0,0 +1,61 @@
+#ifndef BUILDER_EXTRACTION_STATS_H
+#define BUILDER_EXTRACTION_STATS_H
+#include "blocks/block.h"
+#include "builder/pass_manager.h"
+#include "util/tracer.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace builder {
+
+// Counters collected while a function is extracted. The contexts that
+// explore branches update the stats of the context the extraction started in
+class extraction_stats {
+public:
+	// Executions of the staged function, the first one and all the replays
+	std::atomic<unsigned long long> executions;
+	// Longest sequence of branch decisions an execution had to replay
+	std::atomic<unsigned long long> max_branch_depth;
+	std::atomic<unsigned long long> memoization_hits;
+	std::atomic<unsigned long long> memoization_misses;
+	std::atomic<unsigned long long> loop_backs;
+	// Distinct nodes in the final AST
+	unsigned long long ast_nodes = 0;
+	// Tails the share_tails pass emitted once and the bytes of code that saved
+	unsigned long long tails_shared = 0;
+	unsigned long long tail_bytes_saved = 0;
+
+	// Wall time of the extraction in seconds
+	double extraction_time = 0;
+	// The passes that ran after the extraction, in order
+	std::vector<pass_stats> passes;
+	std::chrono::steady_clock::time_point start_time;
+
+	extraction_stats() {
+		reset();
+		start_time = std::chrono::steady_clock::now();
+	}
+	extraction_stats(const extraction_stats &other);
+	// Clears everything but the start time
+	void reset(void);
+
+	void record_branch_depth(unsigned long long depth);
+	// Executions started to explore the paths of the branch at the tag
+	void add_branch_executions(const tracer::tag &t, unsigned long long count);
+	// The branches that started the most executions, most expensive first
+	std::vector<std::pair<tracer::tag, unsigned long long>> top_branches(unsigned int count);
+	std::unordered_map<tracer::tag, unsigned long long> branch_executions;
+	std::mutex branch_lock;
+
+	double elapsed_seconds(void);
+	void dump(std::ostream &oss, unsigned int num_branches = 5);
+
+	static unsigned long long count_ast_nodes(block::block::Ptr ast);
+};
+
+} // namespace builder
+#endif
@@ -26,7 +26,7 @@ struct member_base_impl: public member_base {
 	member_base_impl(member_base *p, std::string s): parent(p), member_name(s) {}
 	virtual block::expr::Ptr get_parent() const {
 		assert(parent && "Parent cannot be null");
-		block::member_access_expr::Ptr member = std::make_shared<block::member_access_expr>();
+		block::member_access_expr::Ptr member = block::make_node<block::member_access_expr>();
 		member->parent_expr = parent->get_parent();
 		builder_context::current_builder_context->remove_node_from_sequence(member->parent_expr);
 		member->member_name = member_name;	
@@ -0,0 +1,19 @@
+#ifndef BUILDER_MEMOIZATION_CACHE_H
+#define BUILDER_MEMOIZATION_CACHE_H
+#include "builder/builder_context.h"
+#include <string>
+
+namespace builder {
+
+// Stores a memoization table in a file, so later runs of the same binary can
+// reuse the statements extracted by earlier runs. A file is only used if it was
+// written by a binary with the same build-id and with the same key
+
+// Build-id of the binary BuildIt is linked into, empty if it has none
+std::string get_build_id(void);
+// Returns false and leaves the table untouched if the file is missing or stale
+bool load_memoization_cache(const std::string &file_name, const std::string &key, tag_map *map);
+bool save_memoization_cache(const std::string &file_name, const std::string &key, tag_map *map);
+
+} // namespace builder
+#endif
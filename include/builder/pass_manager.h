@@ -0,0 +1,62 @@
+#ifndef BUILDER_PASS_MANAGER_H
+#define BUILDER_PASS_MANAGER_H
+#include "blocks/stmt.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace builder {
+
+// What a pass did to the AST. Nodes before is the size of the AST the pass
+// ran on, nodes changed counts the nodes the pass added to or removed from
+// the AST, updates of existing nodes aren't counted. Both are only set with
+// pass_manager::count_nodes
+class pass_stats {
+public:
+	std::string name;
+	double seconds = 0;
+	unsigned long long nodes_before = 0;
+	unsigned long long nodes_changed = 0;
+};
+
+// The passes that run on the AST after it is extracted, in order
+class pass_manager {
+public:
+	typedef std::function<void(block::stmt::Ptr)> pass_function;
+	class pass {
+	public:
+		std::string name;
+		pass_function run;
+		bool enabled = true;
+		// Passes that recover loops and other structure are skipped with feature_unstructured
+		bool structured_only = false;
+	};
+	std::vector<pass> passes;
+	// Counting the nodes walks the whole AST before and after every pass
+	// and holds on to all of its nodes, it is off by default
+	bool count_nodes = false;
+
+	// Name the variables, insert the labels, eliminate the redundant vars and
+	// fold the constants, recover the loops and ifs, hoist the loop invariants,
+	// share the duplicated tails and eliminate the common subexprs. Only the
+	// naming, the labels and the recovery of loops and ifs are enabled by default
+	static pass_manager default_pipeline(void);
+
+	void add_pass(const std::string &name, pass_function run, bool structured_only = false);
+	// These return false if there is no pass with the name
+	bool insert_pass_before(const std::string &before, const std::string &name, pass_function run,
+				bool structured_only = false);
+	bool insert_pass_after(const std::string &after, const std::string &name, pass_function run,
+			       bool structured_only = false);
+	bool remove_pass(const std::string &name);
+	bool set_enabled(const std::string &name, bool enabled);
+	// Returns nullptr if there is no pass with the name
+	pass *find_pass(const std::string &name);
+
+	// Runs the enabled passes in order and appends what each did to stats. The
+	// cached structural hashes are invalidated before every pass and at the end
+	void run(block::stmt::Ptr ast, bool feature_unstructured, std::vector<pass_stats> &stats);
+};
+
+} // namespace builder
+#endif
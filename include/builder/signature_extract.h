@@ -89,7 +89,7 @@ struct extract_signature<ClassType, void, void> {
 			// At this point rest of the OtherArgs will just be
 			// thrown away
 			static std::function<void(void)> call(builder_context *context, int arg_count, ClassType func, RestArgTypes &... rest_args) {
-				block::scalar_type::Ptr type = std::make_shared<block::scalar_type>();
+				block::scalar_type::Ptr type = block::make_node<block::scalar_type>();
 				type->scalar_type_id = block::scalar_type::VOID_TYPE;
 				context->current_func_decl->return_type = type;
 				return [&, func](void) { func(rest_args...); };
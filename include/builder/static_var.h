@@ -29,29 +29,135 @@ public:
 		std::is_pointer<T>::value, "Currently builder::static_var is only supported for basic types\n");
 	static_assert(sizeof(T) < MAX_TRACKING_VAR_SIZE, "Currently builder::static_var supports variables of max size "
 							 "= " TOSTRING(MAX_TRACKING_VARIABLE_SIZE));
-	T val;
-	operator T &() { return val; }
+	// Index of this variable in the static_var_tuples of the context
+	unsigned int tuple_index;
+
+	// val is private and the writes go through the operators below so that
+	// the hash of the static vars in the context is updated incrementally
 	operator const T &() const { return val; }
+	// Replaces the public val and the conversion to T & that were removed.
+	// Deprecated, a var that hands out a non const reference is hashed again
+	// every time a tag is captured. Write it through the operators instead
+	__attribute__((deprecated("write static_var through its operators"))) T &mutable_val(void) {
+		assert(builder_context::current_builder_context != nullptr);
+		builder_context::current_builder_context->escape_static_var(tuple_index);
+		return val;
+	}
 	const T &operator=(const T &t) {
 		val = t;
+		update();
 		return t;
 	}
+	static_var &operator=(const static_var &t) {
+		val = t.val;
+		update();
+		return *this;
+	}
+	static_var &operator++() {
+		++val;
+		update();
+		return *this;
+	}
+	T operator++(int) {
+		T old = val++;
+		update();
+		return old;
+	}
+	static_var &operator--() {
+		--val;
+		update();
+		return *this;
+	}
+	T operator--(int) {
+		T old = val--;
+		update();
+		return old;
+	}
+	template <typename TO>
+	static_var &operator+=(const TO &t) {
+		val += t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator-=(const TO &t) {
+		val -= t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator*=(const TO &t) {
+		val *= t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator/=(const TO &t) {
+		val /= t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator%=(const TO &t) {
+		val %= t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator&=(const TO &t) {
+		val &= t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator|=(const TO &t) {
+		val |= t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator^=(const TO &t) {
+		val ^= t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator<<=(const TO &t) {
+		val <<= t;
+		update();
+		return *this;
+	}
+	template <typename TO>
+	static_var &operator>>=(const TO &t) {
+		val >>= t;
+		update();
+		return *this;
+	}
 	static_var() {
 		assert(builder_context::current_builder_context != nullptr);
-		builder_context::current_builder_context->static_var_tuples.push_back(tracking_tuple((unsigned char *)&val, sizeof(T)));
+		tuple_index = builder_context::current_builder_context->push_static_var((unsigned char *)&val, sizeof(T));
 	}
 	static_var(const T &v) {
 		assert(builder_context::current_builder_context != nullptr);
-		builder_context::current_builder_context->static_var_tuples.push_back(tracking_tuple((unsigned char *)&val, sizeof(T)));
 		val = v;
+		tuple_index = builder_context::current_builder_context->push_static_var((unsigned char *)&val, sizeof(T));
 	}
+	// Copies have to be tracked too
+	static_var(const static_var &other) : static_var(other.val) {}
 	~static_var() {
 		assert(builder_context::current_builder_context != nullptr);
 		assert(builder_context::current_builder_context->static_var_tuples.size() > 0);
 		assert(builder_context::current_builder_context->static_var_tuples.back().ptr == (unsigned char *)&val);
-		builder_context::current_builder_context->static_var_tuples.pop_back();
+		builder_context::current_builder_context->pop_static_var();
 	}
 	operator builder() { return (builder)val; }
+
+private:
+	T val;
+	void update(void) {
+		assert(builder_context::current_builder_context != nullptr);
+		builder_context::current_builder_context->update_static_var(tuple_index);
+	}
 };
 
 } // namespace builder
@@ -0,0 +1,52 @@
+#ifndef UTIL_NODE_POOL_H
+#define UTIL_NODE_POOL_H
+#include <cstddef>
+#include <new>
+
+namespace util {
+
+// Size class allocator for the AST nodes. Extraction creates and drops
+// huge numbers of small blocks on every re-execution, the pool recycles
+// their memory through per thread free lists instead of going to malloc.
+// Memory is carved out of large chunks that are kept until
+// node_pool_release, the free lists of threads that exit are handed to the
+// next thread that runs out
+void *node_pool_allocate(size_t size);
+void node_pool_deallocate(void *ptr, size_t size);
+
+// Bytes currently handed out by the pool and the bytes held in chunks
+size_t node_pool_bytes_in_use(void);
+size_t node_pool_bytes_reserved(void);
+
+// Returns all the chunks to the system once no node is alive anymore, like
+// after the generated code is written and the ASTs are dropped. Returns false
+// and keeps the chunks if some nodes are still alive. No other thread may
+// create or destroy blocks while this runs. Without it the pool holds on to
+// the peak of the live nodes, for one extraction usually a few 256KB chunks
+bool node_pool_release(void);
+
+// Used with std::allocate_shared so that the block and its control
+// block come from a single pooled allocation
+template <typename T>
+class node_pool_allocator {
+public:
+	typedef T value_type;
+	node_pool_allocator() = default;
+	template <typename U>
+	node_pool_allocator(const node_pool_allocator<U> &) {}
+
+	T *allocate(size_t n) { return static_cast<T *>(node_pool_allocate(n * sizeof(T))); }
+	void deallocate(T *p, size_t n) { node_pool_deallocate(p, n * sizeof(T)); }
+
+	template <typename U>
+	bool operator==(const node_pool_allocator<U> &) const {
+		return true;
+	}
+	template <typename U>
+	bool operator!=(const node_pool_allocator<U> &) const {
+		return false;
+	}
+};
+
+} // namespace util
+#endif
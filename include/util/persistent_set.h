@@ -0,0 +1,168 @@
+#ifndef UTIL_PERSISTENT_SET_H
+#define UTIL_PERSISTENT_SET_H
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace util {
+
+// Hash set that shares its contents with its copies. It is a hash array
+// mapped trie with 32 way nodes, so copies are O(1) and updates copy at
+// most one path of the trie. Nodes that are not shared with another copy
+// are updated in place
+template <typename T, typename Hash = std::hash<T>>
+class persistent_set {
+public:
+	persistent_set() = default;
+
+	size_t size(void) const { return count; }
+	bool empty(void) const { return count == 0; }
+
+	bool contains(const T &value) const {
+		size_t hash = Hash()(value);
+		const node *n = root.get();
+		for (unsigned level = 0; n != nullptr; level += bits) {
+			if (level >= hash_bits)
+				return find_collision(n, value) != n->values.size();
+			unsigned bit = 1u << ((hash >> level) & mask);
+			if (n->datamap & bit)
+				return n->values[index_of(n->datamap, bit)] == value;
+			if (!(n->nodemap & bit))
+				return false;
+			n = n->nodes[index_of(n->nodemap, bit)].get();
+		}
+		return false;
+	}
+
+	// Returns false if the value was already in the set
+	bool insert(const T &value) {
+		if (contains(value))
+			return false;
+		if (root == nullptr)
+			root = std::make_shared<node>();
+		insert_into(root, value, Hash()(value), 0);
+		count++;
+		return true;
+	}
+
+	// Returns false if the value wasn't in the set
+	bool erase(const T &value) {
+		if (!contains(value))
+			return false;
+		erase_from(root, value, Hash()(value), 0);
+		count--;
+		return true;
+	}
+
+private:
+	static const unsigned bits = 5;
+	static const unsigned mask = (1u << bits) - 1;
+	static const unsigned hash_bits = sizeof(size_t) * 8;
+
+	// Slots of a node either hold a value or point to a child node. Nodes
+	// below the last level of the hash hold all the colliding values
+	struct node {
+		unsigned datamap = 0;
+		unsigned nodemap = 0;
+		std::vector<T> values;
+		std::vector<std::shared_ptr<node>> nodes;
+	};
+	typedef std::shared_ptr<node> node_ptr;
+
+	node_ptr root;
+	size_t count = 0;
+
+	static unsigned index_of(unsigned map, unsigned bit) { return __builtin_popcount(map & (bit - 1)); }
+	static size_t find_collision(const node *n, const T &value) {
+		size_t i = 0;
+		for (; i < n->values.size(); i++) {
+			if (n->values[i] == value)
+				break;
+		}
+		return i;
+	}
+
+	static void make_unique(node_ptr &n) {
+		if (n.use_count() == 1) {
+			// Pairs with the release in the destructor of the last other owner
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return;
+		}
+		n = std::make_shared<node>(*n);
+	}
+
+	// Node holding two values whose hashes agree up to level
+	static node_ptr make_pair_node(const T &v1, size_t h1, const T &v2, size_t h2, unsigned level) {
+		node_ptr n = std::make_shared<node>();
+		if (level >= hash_bits) {
+			n->values.push_back(v1);
+			n->values.push_back(v2);
+			return n;
+		}
+		unsigned b1 = 1u << ((h1 >> level) & mask);
+		unsigned b2 = 1u << ((h2 >> level) & mask);
+		if (b1 == b2) {
+			n->nodemap = b1;
+			n->nodes.push_back(make_pair_node(v1, h1, v2, h2, level + bits));
+			return n;
+		}
+		n->datamap = b1 | b2;
+		if (b1 < b2) {
+			n->values.push_back(v1);
+			n->values.push_back(v2);
+		} else {
+			n->values.push_back(v2);
+			n->values.push_back(v1);
+		}
+		return n;
+	}
+
+	static void insert_into(node_ptr &n, const T &value, size_t hash, unsigned level) {
+		make_unique(n);
+		if (level >= hash_bits) {
+			n->values.push_back(value);
+			return;
+		}
+		unsigned bit = 1u << ((hash >> level) & mask);
+		if (n->nodemap & bit) {
+			insert_into(n->nodes[index_of(n->nodemap, bit)], value, hash, level + bits);
+		} else if (n->datamap & bit) {
+			// The slot is taken by another value, both move to a new child
+			unsigned index = index_of(n->datamap, bit);
+			T existing = n->values[index];
+			n->values.erase(n->values.begin() + index);
+			n->datamap &= ~bit;
+			node_ptr child = make_pair_node(existing, Hash()(existing), value, hash, level + bits);
+			n->nodemap |= bit;
+			n->nodes.insert(n->nodes.begin() + index_of(n->nodemap, bit), child);
+		} else {
+			n->datamap |= bit;
+			n->values.insert(n->values.begin() + index_of(n->datamap, bit), value);
+		}
+	}
+
+	static void erase_from(node_ptr &n, const T &value, size_t hash, unsigned level) {
+		make_unique(n);
+		if (level >= hash_bits) {
+			n->values.erase(n->values.begin() + find_collision(n.get(), value));
+			return;
+		}
+		unsigned bit = 1u << ((hash >> level) & mask);
+		if (n->datamap & bit) {
+			n->values.erase(n->values.begin() + index_of(n->datamap, bit));
+			n->datamap &= ~bit;
+			return;
+		}
+		unsigned index = index_of(n->nodemap, bit);
+		erase_from(n->nodes[index], value, hash, level + bits);
+		node_ptr &child = n->nodes[index];
+		if (child->values.empty() && child->nodes.empty()) {
+			n->nodes.erase(n->nodes.begin() + index);
+			n->nodemap &= ~bit;
+		}
+	}
+};
+
+} // namespace util
+#endif
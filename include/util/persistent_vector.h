@@ -0,0 +1,122 @@
+#ifndef UTIL_PERSISTENT_VECTOR_H
+#define UTIL_PERSISTENT_VECTOR_H
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace util {
+
+// Vector that shares its contents with its copies. It is a 32 way trie of
+// full leaves with the last (partial) leaf kept separately, so copies are
+// O(1) and push_back copies at most one path of the trie. Nodes that are
+// not shared with another copy are updated in place
+template <typename T>
+class persistent_vector {
+public:
+	// The leaves are std::vectors, so this is a proxy for bool
+	typedef typename std::vector<T>::const_reference const_reference;
+
+	persistent_vector() : root(std::make_shared<node>()) {}
+
+	size_t size(void) const { return count; }
+	bool empty(void) const { return count == 0; }
+
+	const_reference operator[](size_t i) const {
+		assert(i < count);
+		if (i >= tail_offset())
+			return (*tail)[i & mask];
+		const node *n = root.get();
+		for (unsigned level = shift; level > 0; level -= bits)
+			n = n->children[(i >> level) & mask].get();
+		return n->values[i & mask];
+	}
+	const_reference back(void) const { return (*this)[count - 1]; }
+
+	void push_back(const T &value) {
+		if (tail == nullptr)
+			tail = std::make_shared<std::vector<T>>();
+		if (count - tail_offset() < width) {
+			make_unique(tail);
+			tail->push_back(value);
+			count++;
+			return;
+		}
+		// The tail is full, it moves into the trie as a leaf
+		node_ptr leaf = std::make_shared<node>();
+		if (is_unique(tail))
+			leaf->values = std::move(*tail);
+		else
+			leaf->values = *tail;
+		if ((count >> bits) > ((size_t)1 << shift)) {
+			node_ptr new_root = std::make_shared<node>();
+			new_root->children.resize(width);
+			new_root->children[0] = root;
+			new_root->children[1] = new_path(shift, leaf);
+			root = new_root;
+			shift += bits;
+		} else {
+			push_tail(shift, root, leaf);
+		}
+		tail = std::make_shared<std::vector<T>>();
+		tail->reserve(width);
+		tail->push_back(value);
+		count++;
+	}
+
+private:
+	static const unsigned bits = 5;
+	static const size_t width = (size_t)1 << bits;
+	static const size_t mask = width - 1;
+
+	struct node {
+		std::vector<std::shared_ptr<node>> children;
+		std::vector<T> values;
+	};
+	typedef std::shared_ptr<node> node_ptr;
+
+	node_ptr root;
+	std::shared_ptr<std::vector<T>> tail;
+	size_t count = 0;
+	unsigned shift = bits;
+
+	size_t tail_offset(void) const { return count < width ? 0 : ((count - 1) >> bits) << bits; }
+
+	template <typename P>
+	static bool is_unique(const std::shared_ptr<P> &p) {
+		if (p.use_count() != 1)
+			return false;
+		// Pairs with the release in the destructor of the last other owner
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return true;
+	}
+	template <typename P>
+	static void make_unique(std::shared_ptr<P> &p) {
+		if (!is_unique(p))
+			p = std::make_shared<P>(*p);
+	}
+
+	static node_ptr new_path(unsigned level, node_ptr leaf) {
+		if (level == 0)
+			return leaf;
+		node_ptr ret = std::make_shared<node>();
+		ret->children.resize(width);
+		ret->children[0] = new_path(level - bits, leaf);
+		return ret;
+	}
+	void push_tail(unsigned level, node_ptr &parent, node_ptr leaf) {
+		make_unique(parent);
+		if (parent->children.empty())
+			parent->children.resize(width);
+		size_t index = ((count - 1) >> level) & mask;
+		if (level == bits)
+			parent->children[index] = leaf;
+		else if (parent->children[index] != nullptr)
+			push_tail(level - bits, parent->children[index], leaf);
+		else
+			parent->children[index] = new_path(level - bits, leaf);
+	}
+};
+
+} // namespace util
+#endif
@@ -0,0 +1,64 @@
+#ifndef UTIL_THREAD_POOL_H
+#define UTIL_THREAD_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+// A small fork-join pool with per worker deques and work stealing.
+// Tasks are owned by the caller and must stay alive until wait() returns.
+// Threads that wait on a task keep executing other queued tasks,
+// so nested fork-join (like recursive branch exploration) never deadlocks
+class work_stealing_pool {
+public:
+	class task {
+	public:
+		task(std::function<void(void)> f) : func(f), done(false) {}
+
+	private:
+		friend class work_stealing_pool;
+		std::function<void(void)> func;
+		std::atomic<bool> done;
+		std::exception_ptr error;
+	};
+
+	// num_workers can be 0, in which case all tasks are run by
+	// the threads waiting on them
+	work_stealing_pool(unsigned int num_workers);
+	~work_stealing_pool();
+
+	void spawn(task *t);
+	// Waits for the task to finish and rethrows any exception it threw
+	void wait(task *t);
+
+	unsigned int num_workers(void) { return threads.size(); }
+
+private:
+	struct task_queue {
+		std::mutex lock;
+		std::deque<task *> tasks;
+	};
+	// One queue per worker and one last queue for tasks
+	// spawned from threads outside the pool
+	std::vector<std::unique_ptr<task_queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex idle_lock;
+	std::condition_variable idle_cond;
+	std::atomic<unsigned int> pending;
+	bool stopping = false;
+
+	int current_queue_index(void);
+	bool run_one(int self);
+	void worker_loop(int index);
+};
+
+} // namespace util
+#endif
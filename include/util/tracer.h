@@ -1,6 +1,8 @@
 #ifndef TRACER_H
 #define TRACER_H
+#include <atomic>
 #include <execinfo.h>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -11,54 +13,64 @@ class builder_context;
 
 namespace tracer {
 
+// A tag identifies a point in the execution of the staged program by
+// the return addresses on the stack and the values of all the live static vars.
+// Tags are stored on every block, so only a 128 bit hash of the
+// stack is kept. The full stack is recorded in a side table for
+// debugging if record_tag_stacks is set
 class tag {
 public:
-	std::vector<unsigned long long> pointers;
-	std::vector<std::string> static_var_snapshots;
+	unsigned long long hash_high = 0;
+	unsigned long long hash_low = 0;
+	// Index into the table of recorded stacks, 0 if not recorded
+	unsigned int stack_id = 0;
 
-	bool operator==(const tag &other) {
-		if (other.pointers.size() != pointers.size())
-			return false;
-		for (unsigned int i = 0; i < pointers.size(); i++)
-			if (pointers[i] != other.pointers[i])
-				return false;
-		if (other.static_var_snapshots.size() != static_var_snapshots.size())
-			return false;
-		for (unsigned int i = 0; i < static_var_snapshots.size(); i++)
-			if (static_var_snapshots[i] != other.static_var_snapshots[i])
-				return false;
-		return true;
+	bool operator==(const tag &other) const { return hash_high == other.hash_high && hash_low == other.hash_low; }
+	bool operator!=(const tag &other) const { return !operator==(other); }
+	bool operator<(const tag &other) const {
+		if (hash_high != other.hash_high)
+			return hash_high < other.hash_high;
+		return hash_low < other.hash_low;
 	}
-	bool operator!=(const tag &other) { return !operator==(other); }
-	bool is_empty(void) { return pointers.size() == 0; }
+	bool is_empty(void) const { return hash_high == 0 && hash_low == 0; }
 	void clear(void) {
-		pointers.clear();
-		static_var_snapshots.clear();
+		hash_high = hash_low = 0;
+		stack_id = 0;
 	}
-	std::string stringify(void) {
-		std::string output_string = "[";
-		for (unsigned int i = 0; i < pointers.size(); i++) {
-			char temp[128];
-			sprintf(temp, "%llx", pointers[i]);
-			output_string += temp;
-			if (i != pointers.size() - 1)
-				output_string += ", ";
-		}
-		output_string += "]:[";
-		for (unsigned int i = 0; i < static_var_snapshots.size(); i++) {
-			output_string += static_var_snapshots[i];
-			if (i != static_var_snapshots.size() - 1)
-				output_string += ", ";
-		}
-		output_string += "]";
+	std::string stringify(void) const;
+};
 
-		return output_string;
-	}
+// Full stack behind a tag, only used for debugging
+class tag_stack {
+public:
+	std::vector<unsigned long long> pointers;
+	std::vector<std::string> static_var_snapshots;
 };
 
+// Should be set before any extraction starts
+extern bool record_tag_stacks;
+// Returns nullptr if the stack for the tag wasn't recorded
+const tag_stack *get_tag_stack(const tag &t);
+
 tag get_unique_tag(void);
+// The counter behind get_unique_tag. Processes forked during an extraction
+// move it to shared memory so that their unique tags don't collide
+std::atomic<unsigned long long> *get_unique_tag_counter(void);
+void set_unique_tag_counter(std::atomic<unsigned long long> *counter);
+
+// Hash of the value of a static var at a position in the context. The
+// hashes of all the static vars are summed up and added to the tags
+void hash_static_var(const unsigned char *ptr, unsigned int size, unsigned int position, unsigned long long &hash_high,
+		     unsigned long long &hash_low);
 
 tag get_offset_in_function_impl(builder::builder_context *current_builder_context);
 
 } // namespace tracer
+
+namespace std {
+template <>
+struct hash<tracer::tag> {
+	size_t operator()(const tracer::tag &t) const { return (size_t)t.hash_low; }
+};
+} // namespace std
 #endif
@@ -1,9 +1,10 @@
 #ifndef UTIL_VAR_FINDER_H
 #define UTIL_VAR_FINDER_H
+#include "util/tracer.h"
 #include <string>
 namespace util {
 std::string find_variable_name(void*);
-std::string find_variable_name_cached(void*, std::string tag_string);
+std::string find_variable_name_cached(void*, const tracer::tag &offset);
 }
 
 #endif
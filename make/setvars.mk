@@ -1,6 +1,7 @@
 # Initialize config parameters if not initialized
 RECOVER_VAR_NAMES ?= 0
 TRACER_USE_LIBUNWIND ?= 0
+TRACER_USE_FRAME_POINTERS ?= 0
 DEBUG ?= 0
 ifeq ($(RECOVER_VAR_NAMES),1)
 ifneq ($(shell uname), Linux)
@@ -13,8 +14,9 @@ endif
 # Create CFLAGS, LINKER_FLAGS, CFLAGS_INTERNAL and INCLUDE_FLAGS based on config
 CFLAGS_INTERNAL=-std=c++11 -Wall -Wextra -Wno-unused-parameter -Wno-missing-field-initializers -Wmissing-declarations 
 CFLAGS_INTERNAL+=-Woverloaded-virtual -Wno-deprecated -Wdelete-non-virtual-dtor -Werror -Wno-vla -pedantic-errors
+CFLAGS_INTERNAL+=-pthread
 CFLAGS=
-LINKER_FLAGS=-L$(BUILD_DIR)/ -l$(LIBRARY_NAME)
+LINKER_FLAGS=-L$(BUILD_DIR)/ -l$(LIBRARY_NAME) -pthread
 INCLUDE_FLAGS=-I$(INCLUDE_DIR) -I$(BUILD_DIR)/gen_headers/
 
 ifeq ($(DEBUG),1)
@@ -28,6 +30,15 @@ ifeq ($(TRACER_USE_LIBUNWIND),1)
 CFLAGS_INTERNAL+=-DTRACER_USE_LIBUNWIND
 endif
 
+ifeq ($(TRACER_USE_FRAME_POINTERS),1)
+ifeq ($(TRACER_USE_LIBUNWIND),1)
+$(error TRACER_USE_FRAME_POINTERS and TRACER_USE_LIBUNWIND cannot be used together)
+endif
+CFLAGS_INTERNAL+=-DTRACER_USE_FRAME_POINTERS
+# The staged code is on the walked stack too, so users need the flag as well
+CFLAGS+=-fno-omit-frame-pointer
+endif
+
 
 LIBUNWIND_PATH ?= _UNSET_
 ifeq ($(RECOVER_VAR_NAMES),1)
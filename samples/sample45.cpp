@@ -0,0 +1,35 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Exploring branches in parallel produces the same AST as serial extraction
+static void foo(dyn_var<int> x) {
+	dyn_var<int> a = 0;
+	for (static_var<int> i = 0; i < 3; i++) {
+		if (x > i)
+			a = a + i;
+		else
+			a = a - 1;
+	}
+	for (dyn_var<int> j = 0; j < x; j = j + 1) {
+		if (j % 2 == 0)
+			a = a * 2;
+	}
+}
+int main(int argc, char *argv[]) {
+	builder::builder_context serial_context;
+	auto serial_ast = serial_context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(serial_ast, std::cout, 0);
+
+	builder::builder_context parallel_context;
+	parallel_context.use_parallel_exploration = true;
+	parallel_context.parallel_exploration_threads = 4;
+	auto parallel_ast = parallel_context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(parallel_ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,34 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/static_var.h"
+#include "builder/dyn_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Extracting many specializations of a function concurrently
+static dyn_var<int> power_f(dyn_var<int> base, static_var<int> exponent) {
+	dyn_var<int> res = 1, x = base;
+	while (exponent > 0) {
+		if (exponent % 2 == 1)
+			res = res * x;
+		x = x * x;
+		exponent = exponent / 2;
+	}
+	return res;
+}
+int main(int argc, char *argv[]) {
+	std::vector<builder::extraction_job> jobs;
+	for (int exponent = 1; exponent <= 6; exponent++)
+		jobs.push_back(builder::make_extraction_job(power_f, "power_" + std::to_string(exponent), exponent));
+
+	builder::builder_context context;
+	std::vector<builder::extraction_stats> stats;
+	auto asts = context.extract_function_asts(jobs, 4, &stats);
+	for (unsigned int i = 0; i < asts.size(); i++) {
+		block::c_code_generator::generate_code(asts[i], std::cout, 0);
+		std::cout << "// executions: " << stats[i].executions << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,38 @@
+/*NO_TEST*/
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/static_var.h"
+#include "builder/dyn_var.h"
+#include <chrono>
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Microbenchmark for the tracer, build with make bench_tracer to compare all the modes
+static void bench(dyn_var<int> x) {
+	dyn_var<int> a = 0;
+	for (static_var<int> i = 0; i < 64; i++) {
+		if (x > i)
+			a = a + i * x;
+		else
+			a = a - x;
+	}
+}
+int main(int argc, char *argv[]) {
+#if defined(TRACER_USE_LIBUNWIND)
+	const char *mode = "libunwind";
+#elif defined(TRACER_USE_FRAME_POINTERS)
+	const char *mode = "frame pointers";
+#else
+	const char *mode = "backtrace";
+#endif
+	const int iterations = 20;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		builder::builder_context().extract_function_ast(bench, "bench");
+	auto end = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+	std::cout << "Tracer mode: " << mode << ", " << ms / iterations << " ms per extraction" << std::endl;
+	return 0;
+}
@@ -0,0 +1,60 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/exceptions.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Exploring branches in forked processes produces the same AST as serial extraction
+static void foo(dyn_var<int> x) {
+	dyn_var<int> a = 0;
+	for (static_var<int> i = 0; i < 3; i++) {
+		if (x > i)
+			a = a + i;
+		else
+			a = a - 1;
+	}
+	dyn_var<int> j = 0;
+	while (j < x) {
+		if (j % 3 == 0)
+			a = a * 2;
+		j = j + 1;
+	}
+}
+int main(int argc, char *argv[]) {
+	builder::builder_context serial_context;
+	auto serial_ast = serial_context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(serial_ast, std::cout, 0);
+	std::cout << "executions: " << serial_context.stats->executions << std::endl;
+
+	builder::builder_context fork_context;
+	fork_context.use_fork_exploration = true;
+	auto fork_ast = fork_context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(fork_ast, std::cout, 0);
+	std::cout << "executions: " << fork_context.stats->executions << std::endl;
+
+	// Branches beyond the limit are explored in process
+	builder::builder_context limited_context;
+	limited_context.use_fork_exploration = true;
+	limited_context.max_fork_children = 2;
+	auto limited_ast = limited_context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(limited_ast, std::cout, 0);
+	std::cout << "executions: " << limited_context.stats->executions << std::endl;
+
+	// Forked paths count against the budget of the whole extraction
+	builder::builder_context budget_context;
+	budget_context.use_fork_exploration = true;
+	budget_context.use_memoization = false;
+	budget_context.max_executions = 5;
+	try {
+		budget_context.extract_function_ast(foo, "foo");
+	} catch (builder::ExtractionBudgetException &e) {
+		std::string report = e.what();
+		std::cout << report.substr(0, report.find('\n')) << std::endl;
+	}
+	std::cout << "executions: " << budget_context.stats->executions << std::endl;
+	return 0;
+}
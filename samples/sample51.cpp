@@ -0,0 +1,55 @@
+#include "blocks/block_visitor.h"
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Passes can be added, disabled and reordered per context
+static void foo(dyn_var<int> x) {
+	dyn_var<int> a = 0;
+	for (dyn_var<int> i = 0; i < x; i = i + 1) {
+		if (i % 2 == 0)
+			a = a + i;
+	}
+}
+
+class if_counter : public block::block_visitor {
+public:
+	using block_visitor::visit;
+	int count = 0;
+	virtual void visit(block::if_stmt::Ptr s) override {
+		count++;
+		block_visitor::visit(s);
+	}
+};
+
+static void print_passes(builder::builder_context &context) {
+	for (auto &p : context.stats->passes)
+		std::cout << p.name << ": " << p.nodes_before << " nodes before, " << p.nodes_changed << " nodes changed"
+			  << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	context.passes.count_nodes = true;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	print_passes(context);
+
+	builder::builder_context custom_context;
+	custom_context.passes.count_nodes = true;
+	custom_context.passes.set_enabled("find_for_loops", false);
+	custom_context.passes.insert_pass_after("find_loops", "count_ifs", [](block::stmt::Ptr ast) {
+		if_counter counter;
+		ast->accept(&counter);
+		std::cout << "ifs after find_loops: " << counter.count << std::endl;
+	});
+	ast = custom_context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	print_passes(custom_context);
+	return 0;
+}
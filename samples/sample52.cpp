@@ -0,0 +1,49 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Constants that went through dyn_vars are folded once RCE has put them
+// back into the expressions
+static void foo(dyn_var<int> x, dyn_var<unsigned int> y, dyn_var<int *> z) {
+	dyn_var<int> a = 3;
+	dyn_var<int> b = a * 4 + 2;
+	z[0] = b - 14 + x;
+	z[1] = (x + 0) * 1;
+	z[2] = (x + 3) + 4;
+	z[3] = (x - 5) + 5;
+	z[4] = y * 8 + y / 4 + y % 16;
+	z[5] = x * 8;
+	// Both of these would overflow an int, they are left alone
+	dyn_var<int> big = 1000000000;
+	z[6] = big * 3;
+	dyn_var<int> shift = 31;
+	z[7] = 1 << shift;
+	dyn_var<double> d = 1.5;
+	dyn_var<double> e = d * 2 + 0.25;
+	dyn_var<double> f = 0.1;
+	dyn_var<double> g = f + 0.2;
+	z[8] = e < g;
+	dyn_var<int> zero = 0;
+	z[9] = zero && x;
+	dyn_var<int> c = 3;
+	z[10] = c * 4 + 2 - x;
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	context.run_rce = true;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+
+	builder::builder_context fold_context;
+	fold_context.run_rce = true;
+	fold_context.run_const_fold = true;
+	ast = fold_context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,34 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Loads and arithmetic repeated across statements are computed once
+static void stencil(dyn_var<int *> in, dyn_var<int *> out, dyn_var<int> i, dyn_var<int> n) {
+	dyn_var<int> left = in[i - 1] + in[i] + in[i + 1];
+	dyn_var<int> right = in[i] + in[i + 1] + in[i + 2];
+	out[i] = left * right + (i * n + 1);
+	// The store to out could change in, the loads are done again
+	out[i + 1] = in[i] * (i * n + 1);
+	i = i + 1;
+	// i changed, nothing is reused
+	out[i] = in[i] * (i * n + 1);
+	if (n != 0 && in[n] > 0)
+		out[0] = in[n] + in[n];
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(stencil, "stencil");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+
+	builder::builder_context cse_context;
+	cse_context.run_cse = true;
+	ast = cse_context.extract_function_ast(stencil, "stencil");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,50 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/cfg.h"
+#include "blocks/dataflow.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <algorithm>
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Builds the control flow graph of an extracted function and runs liveness on it
+static void foo(dyn_var<int *> a, dyn_var<int> n) {
+	dyn_var<int> sum = 0;
+	dyn_var<int> unused = 5;
+	for (dyn_var<int> i = 0; i < n; i = i + 1) {
+		if (a[i] < 0)
+			continue;
+		sum = sum + a[i];
+	}
+	unused = sum;
+	a[0] = sum;
+}
+
+static void print_vars(const block::var_set &vars) {
+	std::vector<std::string> names;
+	for (auto v : vars)
+		names.push_back(v->var_name);
+	std::sort(names.begin(), names.end());
+	for (auto &name : names)
+		std::cout << " " << name;
+	std::cout << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+
+	auto cfg = block::control_flow_graph::build(ast);
+	cfg->dump(std::cout);
+
+	auto live = block::compute_liveness(*cfg);
+	for (auto &bb : cfg->blocks) {
+		std::cout << "live into bb" << bb->id << ":";
+		print_vars(live.in[bb->id]);
+	}
+	return 0;
+}
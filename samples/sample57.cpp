@@ -0,0 +1,32 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// The row offsets of the inner loop and the scale of the outer loop are
+// computed once before the loops
+static void foo(dyn_var<int *> a, dyn_var<int *> b, dyn_var<int> n, dyn_var<int> m) {
+	for (dyn_var<int> i = 0; i < n; i = i + 1) {
+		for (dyn_var<int> j = 0; j < m; j = j + 1) {
+			a[i * m + j] = b[i * m + j] * (n * m) + b[j * 4 / 2];
+		}
+	}
+	dyn_var<int> k = 0;
+	while (k < n - 1) {
+		// The divisor could be zero, the store could change b[0]
+		a[k] = b[0] + n / m;
+		k = k + 1;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	context.run_licm = true;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
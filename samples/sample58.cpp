@@ -0,0 +1,34 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Loops counting down, with strides and with compound conditions are
+// recovered as for loops. Loops that multiply or shift the var aren't
+// counted loops and stay while loops
+static void foo(dyn_var<int *> a, dyn_var<int> n) {
+	for (dyn_var<int> i = n - 1; i >= 0; i = i - 1)
+		a[i] = i;
+	for (dyn_var<int> i = 0; i < n && a[i] != 0; i += 3)
+		a[i] = 0;
+	for (dyn_var<int> i = 1; n > i; i = i * 2)
+		a[i] = 1;
+	for (dyn_var<int> i = n; i != 0; i--) {
+		if (a[i] == 5)
+			continue;
+		a[i] = 2;
+	}
+	for (dyn_var<int> i = 64; i > 1; i = i >> 1)
+		a[i] = 3;
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
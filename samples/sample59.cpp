@@ -0,0 +1,61 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/omp_annotations.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Loops annotated with OMP_PARALLEL are printed as OpenMP parallel loops
+static void foo(dyn_var<int *> a, dyn_var<int *> b, dyn_var<int> n) {
+	dyn_var<int> sum = 0;
+	dyn_var<int> t = 0;
+	builder::annotate(OMP_PARALLEL ":reduction(+):schedule(static)");
+	for (dyn_var<int> i = 0; i < n; i = i + 1) {
+		t = a[i] * 2;
+		b[i] = t;
+		sum = sum + t;
+	}
+	builder::annotate(OMP_PARALLEL ":collapse(2)");
+	for (dyn_var<int> i = 0; i < n; i = i + 1) {
+		for (dyn_var<int> j = 0; j < n; j = j + 1) {
+			b[i * n + j] = a[j] + sum;
+		}
+	}
+	a[0] = sum + t;
+}
+
+// i++ is printed as i = i + 1, max is computed with an if
+static void bar(dyn_var<int *> a, dyn_var<int *> b, dyn_var<int> n) {
+	dyn_var<int> m = a[0];
+	builder::annotate(OMP_PARALLEL ":reduction(max)");
+	for (dyn_var<int> i = 0; i < n; i++) {
+		if (a[i] > m)
+			m = a[i];
+	}
+	dyn_var<int> s = 0;
+	builder::annotate(OMP_PARALLEL ":reduction(-)");
+	for (dyn_var<int> i = 0; i < n; i++) {
+		s = s - a[i];
+	}
+	// prev carries a value to the next iteration, the loop is not parallelized
+	dyn_var<int> prev = 0;
+	builder::annotate(OMP_PARALLEL);
+	for (dyn_var<int> i = 0; i < n; i++) {
+		b[i] = prev;
+		prev = a[i] + 1;
+	}
+	a[0] = m + s + prev;
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	builder::builder_context bar_context;
+	ast = bar_context.extract_function_ast(bar, "bar");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,42 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/omp_annotations.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Pointers that don't alias and are aligned, and a loop the compiler
+// should vectorize
+static void foo(dyn_var<float *> a, dyn_var<float *> b, dyn_var<int> n) {
+	a.block_var->setMetadata<bool>("restrict", true);
+	a.block_var->setMetadata<int>("aligned", 32);
+	b.block_var->setMetadata<bool>("restrict", true);
+	dyn_var<float[16]> scale;
+	scale.block_var->setMetadata<int>("aligned", 64);
+	scale[0] = 2;
+	builder::annotate(OMP_SIMD ":simdlen(8)");
+	for (dyn_var<int> i = 0; i < n; i = i + 1)
+		a[i] = a[i] + b[i] * scale[0];
+}
+
+// Arrays are restrict in the brackets of the parameters
+static void bar(dyn_var<float[]> a, dyn_var<float[]> b, dyn_var<int> n) {
+	a.block_var->setMetadata<bool>("restrict", true);
+	b.block_var->setMetadata<bool>("restrict", true);
+	builder::annotate(OMP_SIMD);
+	for (dyn_var<int> i = 0; i < n; i++)
+		a[i] = a[i] * b[i];
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	builder::builder_context bar_context;
+	ast = bar_context.extract_function_ast(bar, "bar");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/licm.h"
+#include <iostream>
+
+using namespace block;
+
+// Memoization can put the same loop into the two paths of a branch. The
+// temporary would only be declared before one of them, so the shared loop
+// keeps its invariants. The AST is built by hand to get the shared loop
+// without depending on how the loop finders handle memoized tails
+static var::Ptr make_var(std::string name, type::Ptr t) {
+	var::Ptr v = make_node<var>();
+	v->var_name = name;
+	v->var_type = t;
+	return v;
+}
+static expr::Ptr ref(var::Ptr v) {
+	var_expr::Ptr e = make_node<var_expr>();
+	e->var1 = v;
+	return e;
+}
+static expr::Ptr constant(long long value) {
+	int_const::Ptr e = make_node<int_const>();
+	e->value = value;
+	return e;
+}
+template <typename T>
+static expr::Ptr binary(expr::Ptr a, expr::Ptr b) {
+	typename T::Ptr e = make_node<T>();
+	e->expr1 = a;
+	e->expr2 = b;
+	return e;
+}
+static stmt::Ptr assign(expr::Ptr lhs, expr::Ptr rhs) {
+	assign_expr::Ptr a = make_node<assign_expr>();
+	a->var1 = lhs;
+	a->expr1 = rhs;
+	expr_stmt::Ptr s = make_node<expr_stmt>();
+	s->expr1 = a;
+	return s;
+}
+static stmt_block::Ptr make_block(std::vector<stmt::Ptr> stmts) {
+	stmt_block::Ptr b = make_node<stmt_block>();
+	b->stmts = stmts;
+	return b;
+}
+// while (i < y) { a[i] = x * y; i = i + 1; }
+static stmt::Ptr make_loop(var::Ptr a, var::Ptr x, var::Ptr y, var::Ptr i) {
+	sq_bkt_expr::Ptr element = make_node<sq_bkt_expr>();
+	element->var_expr = ref(a);
+	element->index = ref(i);
+	while_stmt::Ptr loop = make_node<while_stmt>();
+	loop->cond = binary<lt_expr>(ref(i), ref(y));
+	loop->body = make_block({assign(element, binary<mul_expr>(ref(x), ref(y))),
+				 assign(ref(i), binary<plus_expr>(ref(i), constant(1)))});
+	return loop;
+}
+
+int main(int argc, char *argv[]) {
+	scalar_type::Ptr int_type = make_node<scalar_type>();
+	int_type->scalar_type_id = scalar_type::INT_TYPE;
+	scalar_type::Ptr void_type = make_node<scalar_type>();
+	void_type->scalar_type_id = scalar_type::VOID_TYPE;
+	pointer_type::Ptr int_ptr_type = make_node<pointer_type>();
+	int_ptr_type->pointee_type = int_type;
+
+	var::Ptr a = make_var("a", int_ptr_type);
+	var::Ptr x = make_var("x", int_type);
+	var::Ptr y = make_var("y", int_type);
+	var::Ptr i = make_var("i", int_type);
+
+	decl_stmt::Ptr decl = make_node<decl_stmt>();
+	decl->decl_var = i;
+	decl->init_expr = constant(0);
+
+	stmt::Ptr shared_loop = make_loop(a, x, y, i);
+	if_stmt::Ptr branch = make_node<if_stmt>();
+	branch->cond = binary<gt_expr>(ref(x), constant(0));
+	branch->then_stmt = make_block({shared_loop});
+	branch->else_stmt = make_block({assign(ref(y), binary<plus_expr>(ref(y), constant(1))), shared_loop});
+
+	func_decl::Ptr func = make_node<func_decl>();
+	func->func_name = "foo";
+	func->return_type = void_type;
+	func->args = {a, x, y};
+	func->body = make_block({decl, branch, assign(ref(i), constant(0)), make_loop(a, x, y, i)});
+
+	hoist_loop_invariants(func);
+	c_code_generator::generate_code(func, std::cout, 0);
+	return 0;
+}
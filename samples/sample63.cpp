@@ -0,0 +1,32 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include "util/node_pool.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// The node pool gives its chunks back once all the ASTs are dropped
+static void foo(dyn_var<int *> a, dyn_var<int> x) {
+	for (static_var<int> i = 0; i < 4; i++) {
+		if (x > i)
+			a[i] = x - i;
+	}
+}
+static void extract(void) {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	// The AST is still alive, nothing is released
+	std::cout << "released: " << util::node_pool_release() << std::endl;
+}
+int main(int argc, char *argv[]) {
+	extract();
+	std::cout << "released: " << util::node_pool_release() << std::endl;
+	std::cout << "reserved: " << util::node_pool_bytes_reserved() << std::endl;
+	// The pool starts over with new chunks
+	extract();
+	return 0;
+}
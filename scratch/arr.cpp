@@ -0,0 +1,19 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/omp_annotations.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include <iostream>
+using builder::dyn_var;
+static void foo(dyn_var<float[]> a, dyn_var<float[]> b, dyn_var<int> n) {
+	a.block_var->setMetadata<bool>("restrict", true);
+	b.block_var->setMetadata<bool>("restrict", true);
+	for (dyn_var<int> i = 0; i < n; i = i + 1)
+		a[i] = a[i] + b[i];
+}
+int main() {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,24 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/omp_annotations.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include <iostream>
+using builder::dyn_var;
+static void foo(dyn_var<float[][4]> a, dyn_var<float[]> b, dyn_var<int> n) {
+	a.block_var->setMetadata<bool>("restrict", true);
+	builder::annotate(OMP_SIMD);
+	for (dyn_var<int> i = 0; i < n; i = i + 1) {
+		b[i] = a[i][0];
+		n = n - 1;
+	}
+	builder::annotate(OMP_SIMD);
+	for (dyn_var<int> i = 1; i < n; i = i * 2)
+		b[i] = 0;
+}
+int main() {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,12 @@
+
+int execute (int arg0) {
+  int var0 = arg0;
+  int var1 = 1;
+  int var2 = var0;
+  var1 = var1 * var2;
+  var2 = var2 * var2;
+  var2 = var2 * var2;
+  int var3 = var1 * var2;
+  return var3;
+}
+
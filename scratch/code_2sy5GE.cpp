@@ -0,0 +1,15 @@
+#include <vector>
+extern "C" int execute (void) {
+  std::vector<int> var0 = {0, 1, 2};
+  std::vector<int> var1 = var0;
+  int var2 = 0;
+  label0:
+  if (var2 < 5) {
+    var1[0] = var1[1] + var1[0];
+    var2 = var2 + 1;
+    goto label0;
+  } 
+  int var3 = var1[0];
+  return var3;
+}
+
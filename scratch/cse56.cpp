@@ -0,0 +1,39 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Early exits leave memoized copies of the tail in every path that reaches it
+static dyn_var<int> foo(dyn_var<int *> a, dyn_var<int> x, dyn_var<int> y) {
+	dyn_var<int> z = 0;
+	if (x > 0) {
+		z = x;
+	} else {
+		if (y > 0)
+			z = y;
+		else
+			return -1;
+	}
+	a[0] = z * 2;
+	a[1] = a[0] + z;
+	a[2] = a[1] * a[0];
+	return a[2] - z;
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+
+	builder::builder_context shared_context;
+	shared_context.run_cse = true;
+	ast = shared_context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	std::cout << "shared tails: " << shared_context.stats->tails_shared << std::endl;
+	std::cout << "bytes saved: " << shared_context.stats->tail_bytes_saved << std::endl;
+	return 0;
+}
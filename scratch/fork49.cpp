@@ -0,0 +1,44 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/exceptions.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Independent conditions make the number of paths grow exponentially without memoization
+static void foo(dyn_var<int> x) {
+	dyn_var<int> a = 0;
+	for (static_var<int> i = 0; i < 6; i++) {
+		if (x > i)
+			a = a + 1;
+	}
+}
+static void print_counts(builder::builder_context &context) {
+	std::cout << "executions: " << context.stats->executions << std::endl;
+	std::cout << "max branch depth: " << context.stats->max_branch_depth << std::endl;
+	std::cout << "memoization hits: " << context.stats->memoization_hits << std::endl;
+	std::cout << "loop backs: " << context.stats->loop_backs << std::endl;
+	std::cout << "ast nodes: " << context.stats->ast_nodes << std::endl;
+}
+int main(int argc, char *argv[]) {
+	builder::builder_context context; context.use_fork_exploration = true;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	print_counts(context);
+
+	builder::builder_context unmemoized_context;
+	unmemoized_context.use_memoization = false; unmemoized_context.use_fork_exploration = true;
+	unmemoized_context.max_executions = 50;
+	try {
+		unmemoized_context.extract_function_ast(foo, "foo");
+	} catch (builder::ExtractionBudgetException &e) {
+		// The rest of the report has the timings and the tags of the branches
+		std::string report = e.what();
+		std::cout << report.substr(0, report.find('\n')) << std::endl;
+	}
+	print_counts(unmemoized_context);
+	return 0;
+}
@@ -0,0 +1,37 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+using builder::dyn_var;
+using builder::static_var;
+
+// A second extraction of the same function is served from the memoization cache
+static void foo(dyn_var<int> x) {
+	dyn_var<int> a = 0;
+	for (static_var<int> i = 0; i < 4; i++) {
+		if (x > i)
+			a = a + i;
+		else
+			a = a - 1;
+	}
+	for (dyn_var<int> j = 0; j < x; j = j + 1) {
+		if (j % 2 == 0)
+			a = a * 2;
+	}
+}
+int main(int argc, char *argv[]) {
+	std::string cache_file = "/tmp/buildit_sample50_" + std::to_string(getpid()) + ".cache";
+	for (int run = 0; run < 2; run++) {
+		builder::builder_context context; context.use_fork_exploration = true;
+		context.memoization_cache_file = cache_file;
+		auto ast = context.extract_function_ast(foo, "foo");
+		block::c_code_generator::generate_code(ast, std::cout, 0);
+		std::cout << "executions: " << context.stats->executions << std::endl;
+	}
+	remove(cache_file.c_str());
+	return 0;
+}
@@ -0,0 +1,24 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/static_var.h"
+#include "builder/dyn_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+static void foo(dyn_var<int> x) {
+	static_var<int> i = 0;
+	int &r = i.mutable_val();
+	while (i < 3) {
+		x = x + i;
+		if (x > 10)
+			x = 0;
+		r = r + 1;
+	}
+}
+int main() {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,47 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/omp_annotations.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include <iostream>
+using builder::dyn_var;
+static void bar(dyn_var<int *> a, dyn_var<int> n) {
+	dyn_var<int> last = 0;
+	builder::annotate(OMP_PARALLEL);
+	for (dyn_var<int> i = 0; i < n; i++) {
+		if (a[i] > 0)
+			last = i;
+	}
+	dyn_var<int> x = 0;
+	builder::annotate(OMP_PARALLEL ":reduction(^)");
+	for (dyn_var<int> i = 0; i < n; i = i + 1) {
+		x = x + a[i];
+	}
+	dyn_var<int> m = 0;
+	builder::annotate(OMP_PARALLEL ":reduction(max)");
+	for (dyn_var<int> i = 0; i < n; i = i + 1) {
+		m = m + a[i];
+	}
+	builder::annotate(OMP_PARALLEL);
+	for (dyn_var<int> i = 1; i < n; i = i * 2) {
+		a[i] = 0;
+	}
+	builder::annotate(OMP_PARALLEL);
+	for (dyn_var<int> i = 0; i < n; i = i + 1) {
+		if (a[i] == 3)
+			break;
+		a[i] = 1;
+	}
+	dyn_var<int> k = 0;
+	builder::annotate(OMP_PARALLEL);
+	for (k = 0; k < n; k = k + 1) {
+		a[k] = 1;
+	}
+	a[0] = last + x + m + k;
+}
+int main() {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(bar, "bar");
+	ast->dump(std::cout, 0);
+	return 0;
+}
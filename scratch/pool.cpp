@@ -0,0 +1,25 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include "util/node_pool.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+static void foo(dyn_var<int> x) {
+	dyn_var<int> a = 0;
+	for (static_var<int> i = 0; i < 14; i++) {
+		if (x > i)
+			a = a + 1;
+	}
+}
+int main() {
+	std::cout << util::node_pool_bytes_in_use() << " " << util::node_pool_bytes_reserved() << std::endl;
+	{
+		builder::builder_context context; context.use_memoization = false;
+		auto ast = context.extract_function_ast(foo, "foo");
+		std::cout << util::node_pool_bytes_in_use() << " " << util::node_pool_bytes_reserved() << std::endl;
+	}
+	std::cout << util::node_pool_bytes_in_use() << " " << util::node_pool_bytes_reserved() << std::endl;
+}
@@ -0,0 +1,29 @@
+#include "util/persistent_vector.h"
+#include "util/persistent_set.h"
+#include <unordered_set>
+#include <cstdio>
+#include <cstdlib>
+struct badhash { size_t operator()(int x) const { return x % 7; } };
+int main() {
+	util::persistent_vector<int> v; std::vector<int> r;
+	std::vector<util::persistent_vector<int>> snaps; std::vector<std::vector<int>> rsnaps;
+	for (int i = 0; i < 200000; i++) {
+		v.push_back(i * 3); r.push_back(i * 3);
+		if (rand() % 5000 == 0) { snaps.push_back(v); rsnaps.push_back(r); }
+	}
+	for (size_t s = 0; s < snaps.size(); s++) { auto c = snaps[s]; for (int k=0;k<100;k++){c.push_back(-k); rsnaps[s].push_back(-k);} for (size_t i = 0; i < c.size(); i++) if (c[i] != rsnaps[s][i]) { printf("vec snap fail\n"); return 1; } }
+	for (size_t i = 0; i < r.size(); i++) if (v[i] != r[i]) { printf("vec fail %zu\n", i); return 1; }
+	util::persistent_set<int> ps; std::unordered_set<int> rs;
+	util::persistent_set<int, badhash> bs; std::unordered_set<int> brs;
+	std::vector<util::persistent_set<int>> ss; std::vector<std::unordered_set<int>> rss;
+	for (int i = 0; i < 300000; i++) {
+		int x = rand() % 50000;
+		if (rand() % 3 == 0) { if (ps.erase(x) != (rs.erase(x) == 1)) { printf("erase fail\n"); return 1; } bs.erase(x % 300); brs.erase(x % 300); }
+		else { if (ps.insert(x) != rs.insert(x).second) { printf("ins fail\n"); return 1; } bs.insert(x % 300); brs.insert(x % 300); }
+		if (rand() % 30000 == 0) { ss.push_back(ps); rss.push_back(rs); }
+	}
+	for (int x = 0; x < 50000; x++) if (ps.contains(x) != (rs.count(x) == 1)) { printf("contains fail\n"); return 1; }
+	for (int x = 0; x < 300; x++) if (bs.contains(x) != (brs.count(x) == 1)) { printf("bad contains fail\n"); return 1; }
+	for (size_t s = 0; s < ss.size(); s++) { if (ss[s].size() != rss[s].size()) {printf("size fail\n"); return 1;} for (int x = 0; x < 50000; x++) if (ss[s].contains(x) != (rss[s].count(x) == 1)) { printf("snap fail\n"); return 1; } }
+	printf("ok %zu %zu\n", ps.size(), ss.size());
+}
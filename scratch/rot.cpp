@@ -0,0 +1,21 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/omp_annotations.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include <iostream>
+using builder::dyn_var;
+static void bar(dyn_var<int *> a, dyn_var<int> n) {
+	dyn_var<int> s = 0;
+	builder::annotate(OMP_PARALLEL ":reduction(-)");
+	for (dyn_var<int> i = 0; i < n; i++) {
+		s = s - a[i];
+	}
+	a[0] = s;
+}
+int main() {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(bar, "bar");
+	ast->dump(std::cout, 0);
+	return 0;
+}
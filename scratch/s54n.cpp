@@ -0,0 +1,57 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Writes only stop the substitution of the decls that read what was written
+static void foo(dyn_var<int *> a, dyn_var<int> n) {
+	dyn_var<int> x = a[0] * 2;
+	dyn_var<int> y = n + 1;
+	dyn_var<int> z = 0;
+	// Never read again, the store and then the decl are removed
+	z = z + 3;
+	// Neither x nor y read z
+	a[1] = x + y;
+
+	dyn_var<int> u = a[2] + n;
+	a[3] = 5;
+	// The store could have changed a[2]
+	a[4] = u;
+
+	dyn_var<int> v = n * 3;
+	dyn_var<int> w = 0;
+	dyn_var<int> i = 0;
+	while (i < n) {
+		// v is computed once outside the loop
+		w = w + v;
+		i = i + 1;
+	}
+	a[5] = w;
+
+	dyn_var<int> s = n * 7;
+	dyn_var<int> k = a[6];
+	dyn_var<int> p = k + 2;
+	dyn_var<int> j = 0;
+	while (j < n) {
+		a[j] = 0;
+		j = j + 1;
+	}
+	// The loop doesn't write n, s is still available after it
+	a[7] = s;
+	if (n > 3)
+		k = 0;
+	// k might have changed on one of the paths
+	a[8] = p;
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	context.run_rce = true; context.passes.set_enabled("find_for_loops", false);
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
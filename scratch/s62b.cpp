@@ -0,0 +1,41 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Memoization puts the same loop into both paths. A temporary would only
+// be declared before one of them, so invariants stay in the shared loop
+static dyn_var<int> foo(dyn_var<int *> a, dyn_var<int> x, dyn_var<int> y) {
+	dyn_var<int> z = 0;
+	dyn_var<int> i = 0;
+	while (i < x) {
+		a[i] = x * y;
+		i = i + 1;
+	}
+	if (x > 0) {
+		z = x;
+	} else {
+		if (y > 0)
+			z = y;
+		else
+			return -1;
+	}
+	i = 0;
+	while (i < y) {
+		a[i] = z * x + i;
+		i = i + 1;
+	}
+	return z;
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,32 @@
+#include "blocks/c_code_generator.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+using builder::dyn_var;
+using builder::static_var;
+
+// Memoization puts the same tail statements in both paths, they are left alone
+static dyn_var<int> foo(dyn_var<int> x, dyn_var<int> y) {
+	dyn_var<int> z = 0;
+	dyn_var<int> b = 0;
+	if (x > 0) {
+		z = x;
+	} else {
+		if (y > 0)
+			z = y;
+		else
+			return -1;
+	}
+	b = z * y + 1;
+	return b * (z * y + x);
+}
+
+int main(int argc, char *argv[]) {
+	builder::builder_context context;
+	context.run_cse = true;
+	auto ast = context.extract_function_ast(foo, "foo");
+	block::c_code_generator::generate_code(ast, std::cout, 0);
+	return 0;
+}
@@ -0,0 +1,6 @@
+#include <execinfo.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cstdlib>
+static void handler(int) { void *a[64]; int n = backtrace(a, 64); backtrace_symbols_fd(a, n, 2); _exit(1); }
+struct install { install() { signal(SIGSEGV, handler); } } installer;
@@ -0,0 +1,38 @@
+#include "blocks/c_code_generator.h"
+#include "blocks/block_visitor.h"
+#include "builder/builder.h"
+#include "builder/builder_context.h"
+#include "builder/dyn_var.h"
+#include "builder/static_var.h"
+#include <iostream>
+#include <unordered_map>
+using builder::dyn_var;
+using builder::static_var;
+struct counter : public block::block_visitor {
+	using block::block_visitor::visit;
+	std::unordered_map<block::stmt *, int> n;
+	virtual void visit(block::stmt_block::Ptr b) override {
+		for (auto s : b->stmts) if (++n[s.get()] == 1) s->accept(this);
+	}
+};
+static dyn_var<int> foo(dyn_var<int> x, dyn_var<int> y) {
+	dyn_var<int> z = 0;
+	dyn_var<int> b = 0;
+	if (x > 0) {
+		z = x;
+	} else {
+		if (y > 0)
+			z = y;
+		else
+			return -1;
+	}
+	b = z * y + 1;
+	return b * (z * y + x);
+}
+int main() {
+	builder::builder_context context;
+	auto ast = context.extract_function_ast(foo, "foo");
+	counter c; ast->accept(&c);
+	int shared = 0; for (auto &p : c.n) shared += p.second > 1;
+	std::cout << "shared " << shared << std::endl;
+}
@@ -0,0 +1,12 @@
+import re,sys,subprocess
+n=sys.argv[1]
+old=open('samples/outputs/sample%s'%n).read()
+oldv=open('samples/outputs.var_names/sample%s'%n).read()
+a=re.findall(r'\w+',old); b=re.findall(r'\w+',oldv)
+assert len(a)==len(b)
+m={}
+for x,y in zip(a,b):
+    if x!=y: m[x]=y
+new=subprocess.check_output(['./build/sample%s'%n]).decode()
+open('samples/outputs/sample%s'%n,'w').write(new)
+open('samples/outputs.var_names/sample%s'%n,'w').write(re.sub(r'\w+',lambda t:m.get(t.group(0),t.group(0)),new))
@@ -1,6 +1,8 @@
 #include "blocks/block.h"
 
 namespace block {
+std::atomic<unsigned long long> block_creation_counter(0);
+
 void block::dump(std::ostream &oss, int indent) {
 
 	// No printing for a simple block
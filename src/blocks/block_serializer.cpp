@@ -0,0 +1,756 @@
+#include "blocks/block_serializer.h"
+#include <cstring>
+
+namespace block {
+
+enum {
+	NULL_BLOCK,
+	SHARED_BLOCK,
+	ADDRESS_BLOCK,
+	NOT_EXPR,
+	AND_EXPR,
+	BITWISE_AND_EXPR,
+	OR_EXPR,
+	BITWISE_OR_EXPR,
+	PLUS_EXPR,
+	MINUS_EXPR,
+	MUL_EXPR,
+	DIV_EXPR,
+	LT_EXPR,
+	GT_EXPR,
+	LTE_EXPR,
+	GTE_EXPR,
+	LSHIFT_EXPR,
+	RSHIFT_EXPR,
+	EQUALS_EXPR,
+	NE_EXPR,
+	MOD_EXPR,
+	VAR_EXPR,
+	INT_CONST,
+	DOUBLE_CONST,
+	FLOAT_CONST,
+	STRING_CONST,
+	ASSIGN_EXPR,
+	SQ_BKT_EXPR,
+	FUNCTION_CALL_EXPR,
+	INITIALIZER_LIST_EXPR,
+	MEMBER_ACCESS_EXPR,
+	ADDR_OF_EXPR,
+	EXPR_STMT,
+	STMT_BLOCK,
+	DECL_STMT,
+	IF_STMT,
+	LABEL,
+	LABEL_STMT,
+	GOTO_STMT,
+	WHILE_STMT,
+	FOR_STMT,
+	BREAK_STMT,
+	CONTINUE_STMT,
+	FUNC_DECL,
+	RETURN_STMT,
+	VAR,
+	SCALAR_TYPE,
+	POINTER_TYPE,
+	FUNCTION_TYPE,
+	ARRAY_TYPE,
+	BUILDER_VAR_TYPE,
+	NAMED_TYPE,
+	NUM_BLOCK_KINDS
+};
+
+void block_serializer::write_u64(unsigned long long v) {
+	buffer.append((const char *)&v, sizeof(v));
+}
+void block_serializer::write_string(const std::string &s) {
+	write_u64(s.size());
+	buffer.append(s);
+}
+void block_serializer::write_tag(const tracer::tag &t) {
+	// The recorded stacks are local to the process, only the hash is written
+	write_u64(t.hash_high);
+	write_u64(t.hash_low);
+}
+
+void block_serializer::write_block(block::Ptr b) {
+	if (b == nullptr) {
+		write_u64(NULL_BLOCK);
+		return;
+	}
+	auto it = written_ids.find(b.get());
+	if (it != written_ids.end()) {
+		write_u64(SHARED_BLOCK);
+		write_u64(it->second);
+		return;
+	}
+	if (write_by_address && write_by_address(b)) {
+		write_u64(ADDRESS_BLOCK);
+		write_u64((unsigned long long)b.get());
+		return;
+	}
+	// The id has to be assigned before the children are written
+	unsigned long long id = written_ids.size();
+	written_ids[b.get()] = id;
+	b->accept(this);
+}
+
+void block_serializer::write_header(int kind, block::Ptr b) {
+	write_u64(kind);
+	write_tag(b->static_offset);
+	write_u64(b->metadata_map.size());
+	for (auto &md : b->metadata_map) {
+		// Only the metadata used by the code generators can be written
+		if (!md.second->isa<std::vector<std::string>>()) {
+			failed = true;
+			return;
+		}
+		write_string(md.first);
+		const std::vector<std::string> &vals = md.second->to<std::vector<std::string>>()->val;
+		write_u64(vals.size());
+		for (auto &v : vals)
+			write_string(v);
+	}
+	if (isa<stmt>(b))
+		write_string(to<stmt>(b)->annotation);
+}
+void block_serializer::write_binary(int kind, binary_expr::Ptr e) {
+	write_header(kind, e);
+	write_block(e->expr1);
+	write_block(e->expr2);
+}
+
+// Abstract and unknown blocks can't be written
+void block_serializer::visit(block::Ptr) {
+	failed = true;
+}
+void block_serializer::visit(expr::Ptr) {
+	failed = true;
+}
+void block_serializer::visit(unary_expr::Ptr) {
+	failed = true;
+}
+void block_serializer::visit(binary_expr::Ptr) {
+	failed = true;
+}
+void block_serializer::visit(const_expr::Ptr) {
+	failed = true;
+}
+void block_serializer::visit(stmt::Ptr) {
+	failed = true;
+}
+void block_serializer::visit(type::Ptr) {
+	failed = true;
+}
+void block_serializer::visit(foreign_expr_base::Ptr) {
+	failed = true;
+}
+
+void block_serializer::visit(not_expr::Ptr e) {
+	write_header(NOT_EXPR, e);
+	write_block(e->expr1);
+}
+void block_serializer::visit(and_expr::Ptr e) {
+	write_binary(AND_EXPR, e);
+}
+void block_serializer::visit(bitwise_and_expr::Ptr e) {
+	write_binary(BITWISE_AND_EXPR, e);
+}
+void block_serializer::visit(or_expr::Ptr e) {
+	write_binary(OR_EXPR, e);
+}
+void block_serializer::visit(bitwise_or_expr::Ptr e) {
+	write_binary(BITWISE_OR_EXPR, e);
+}
+void block_serializer::visit(plus_expr::Ptr e) {
+	write_binary(PLUS_EXPR, e);
+}
+void block_serializer::visit(minus_expr::Ptr e) {
+	write_binary(MINUS_EXPR, e);
+}
+void block_serializer::visit(mul_expr::Ptr e) {
+	write_binary(MUL_EXPR, e);
+}
+void block_serializer::visit(div_expr::Ptr e) {
+	write_binary(DIV_EXPR, e);
+}
+void block_serializer::visit(lt_expr::Ptr e) {
+	write_binary(LT_EXPR, e);
+}
+void block_serializer::visit(gt_expr::Ptr e) {
+	write_binary(GT_EXPR, e);
+}
+void block_serializer::visit(lte_expr::Ptr e) {
+	write_binary(LTE_EXPR, e);
+}
+void block_serializer::visit(gte_expr::Ptr e) {
+	write_binary(GTE_EXPR, e);
+}
+void block_serializer::visit(lshift_expr::Ptr e) {
+	write_binary(LSHIFT_EXPR, e);
+}
+void block_serializer::visit(rshift_expr::Ptr e) {
+	write_binary(RSHIFT_EXPR, e);
+}
+void block_serializer::visit(equals_expr::Ptr e) {
+	write_binary(EQUALS_EXPR, e);
+}
+void block_serializer::visit(ne_expr::Ptr e) {
+	write_binary(NE_EXPR, e);
+}
+void block_serializer::visit(mod_expr::Ptr e) {
+	write_binary(MOD_EXPR, e);
+}
+void block_serializer::visit(var_expr::Ptr e) {
+	write_header(VAR_EXPR, e);
+	write_block(e->var1);
+}
+void block_serializer::visit(int_const::Ptr e) {
+	write_header(INT_CONST, e);
+	write_u64((unsigned long long)e->value);
+}
+void block_serializer::visit(double_const::Ptr e) {
+	write_header(DOUBLE_CONST, e);
+	unsigned long long v;
+	memcpy(&v, &e->value, sizeof(v));
+	write_u64(v);
+}
+void block_serializer::visit(float_const::Ptr e) {
+	write_header(FLOAT_CONST, e);
+	unsigned int v;
+	memcpy(&v, &e->value, sizeof(v));
+	write_u64(v);
+}
+void block_serializer::visit(string_const::Ptr e) {
+	write_header(STRING_CONST, e);
+	write_string(e->value);
+}
+void block_serializer::visit(assign_expr::Ptr e) {
+	write_header(ASSIGN_EXPR, e);
+	write_block(e->var1);
+	write_block(e->expr1);
+}
+void block_serializer::visit(sq_bkt_expr::Ptr e) {
+	write_header(SQ_BKT_EXPR, e);
+	write_block(e->var_expr);
+	write_block(e->index);
+}
+void block_serializer::visit(function_call_expr::Ptr e) {
+	write_header(FUNCTION_CALL_EXPR, e);
+	write_block(e->expr1);
+	write_u64(e->args.size());
+	for (auto a : e->args)
+		write_block(a);
+}
+void block_serializer::visit(initializer_list_expr::Ptr e) {
+	write_header(INITIALIZER_LIST_EXPR, e);
+	write_u64(e->elems.size());
+	for (auto a : e->elems)
+		write_block(a);
+}
+void block_serializer::visit(member_access_expr::Ptr e) {
+	write_header(MEMBER_ACCESS_EXPR, e);
+	write_block(e->parent_expr);
+	write_string(e->member_name);
+}
+void block_serializer::visit(addr_of_expr::Ptr e) {
+	write_header(ADDR_OF_EXPR, e);
+	write_block(e->expr1);
+}
+void block_serializer::visit(expr_stmt::Ptr s) {
+	write_header(EXPR_STMT, s);
+	write_block(s->expr1);
+}
+void block_serializer::visit(stmt_block::Ptr s) {
+	write_header(STMT_BLOCK, s);
+	write_u64(s->stmts.size());
+	for (auto a : s->stmts)
+		write_block(a);
+}
+void block_serializer::visit(decl_stmt::Ptr s) {
+	write_header(DECL_STMT, s);
+	write_block(s->decl_var);
+	write_block(s->init_expr);
+}
+void block_serializer::visit(if_stmt::Ptr s) {
+	write_header(IF_STMT, s);
+	write_block(s->cond);
+	write_block(s->then_stmt);
+	write_block(s->else_stmt);
+}
+void block_serializer::visit(label::Ptr l) {
+	write_header(LABEL, l);
+	write_string(l->label_name);
+}
+void block_serializer::visit(label_stmt::Ptr s) {
+	write_header(LABEL_STMT, s);
+	write_block(s->label1);
+}
+void block_serializer::visit(goto_stmt::Ptr s) {
+	write_header(GOTO_STMT, s);
+	write_block(s->label1);
+	write_tag(s->temporary_label_number);
+}
+void block_serializer::visit(while_stmt::Ptr s) {
+	write_header(WHILE_STMT, s);
+	write_block(s->body);
+	write_block(s->cond);
+	write_u64(s->continue_blocks.size());
+	for (auto a : s->continue_blocks)
+		write_block(a);
+}
+void block_serializer::visit(for_stmt::Ptr s) {
+	write_header(FOR_STMT, s);
+	write_block(s->decl_stmt);
+	write_block(s->cond);
+	write_block(s->update);
+	write_block(s->body);
+}
+void block_serializer::visit(break_stmt::Ptr s) {
+	write_header(BREAK_STMT, s);
+	write_string(s->type);
+}
+void block_serializer::visit(continue_stmt::Ptr s) {
+	write_header(CONTINUE_STMT, s);
+}
+void block_serializer::visit(func_decl::Ptr s) {
+	write_header(FUNC_DECL, s);
+	write_string(s->func_name);
+	write_block(s->return_type);
+	write_u64(s->args.size());
+	for (auto a : s->args)
+		write_block(a);
+	write_block(s->body);
+}
+void block_serializer::visit(return_stmt::Ptr s) {
+	write_header(RETURN_STMT, s);
+	write_block(s->return_val);
+}
+void block_serializer::visit(var::Ptr v) {
+	write_header(VAR, v);
+	write_string(v->var_name);
+	write_string(v->preferred_name);
+	write_block(v->var_type);
+}
+void block_serializer::visit(scalar_type::Ptr t) {
+	write_header(SCALAR_TYPE, t);
+	write_u64(t->scalar_type_id);
+}
+void block_serializer::visit(pointer_type::Ptr t) {
+	write_header(POINTER_TYPE, t);
+	write_block(t->pointee_type);
+}
+void block_serializer::visit(function_type::Ptr t) {
+	write_header(FUNCTION_TYPE, t);
+	write_block(t->return_type);
+	write_u64(t->arg_types.size());
+	for (auto a : t->arg_types)
+		write_block(a);
+}
+void block_serializer::visit(array_type::Ptr t) {
+	write_header(ARRAY_TYPE, t);
+	write_block(t->element_type);
+	write_u64((unsigned long long)t->size);
+}
+void block_serializer::visit(builder_var_type::Ptr t) {
+	write_header(BUILDER_VAR_TYPE, t);
+	write_u64(t->builder_var_type_id);
+	write_block(t->closure_type);
+}
+void block_serializer::visit(named_type::Ptr t) {
+	write_header(NAMED_TYPE, t);
+	write_string(t->type_name);
+	write_u64(t->template_args.size());
+	for (auto a : t->template_args)
+		write_block(a);
+}
+
+unsigned long long block_deserializer::read_u64(void) {
+	unsigned long long v = 0;
+	if (failed || buffer.size() - position < sizeof(v)) {
+		failed = true;
+		return 0;
+	}
+	memcpy(&v, buffer.data() + position, sizeof(v));
+	position += sizeof(v);
+	return v;
+}
+std::string block_deserializer::read_string(void) {
+	unsigned long long size = read_u64();
+	if (failed || buffer.size() - position < size) {
+		failed = true;
+		return "";
+	}
+	std::string s = buffer.substr(position, size);
+	position += size;
+	return s;
+}
+tracer::tag block_deserializer::read_tag(void) {
+	tracer::tag t;
+	t.hash_high = read_u64();
+	t.hash_low = read_u64();
+	return t;
+}
+
+void block_deserializer::read_header(block::Ptr b) {
+	b->static_offset = read_tag();
+	unsigned long long num_metadata = read_u64();
+	for (unsigned long long i = 0; i < num_metadata && !failed; i++) {
+		std::string name = read_string();
+		unsigned long long num_vals = read_u64();
+		std::vector<std::string> vals;
+		for (unsigned long long j = 0; j < num_vals && !failed; j++)
+			vals.push_back(read_string());
+		b->setMetadata(name, vals);
+	}
+	if (isa<stmt>(b))
+		to<stmt>(b)->annotation = read_string();
+}
+
+template <typename T>
+block::Ptr block_deserializer::read_binary(void) {
+	typename T::Ptr e = make_node<T>();
+	read_blocks.push_back(e);
+	read_header(e);
+	e->expr1 = read_block_as<expr>();
+	e->expr2 = read_block_as<expr>();
+	return e;
+}
+
+block::Ptr block_deserializer::read_block(void) {
+	unsigned long long kind = read_u64();
+	if (failed)
+		return nullptr;
+	switch (kind) {
+	case NULL_BLOCK:
+		return nullptr;
+	case SHARED_BLOCK: {
+		unsigned long long id = read_u64();
+		if (failed || id >= read_blocks.size()) {
+			failed = true;
+			return nullptr;
+		}
+		return read_blocks[id];
+	}
+	case ADDRESS_BLOCK: {
+		unsigned long long address = read_u64();
+		if (failed || !read_addresses) {
+			failed = true;
+			return nullptr;
+		}
+		return ((block *)address)->shared_from_this();
+	}
+	case AND_EXPR:
+		return read_binary<and_expr>();
+	case BITWISE_AND_EXPR:
+		return read_binary<bitwise_and_expr>();
+	case OR_EXPR:
+		return read_binary<or_expr>();
+	case BITWISE_OR_EXPR:
+		return read_binary<bitwise_or_expr>();
+	case PLUS_EXPR:
+		return read_binary<plus_expr>();
+	case MINUS_EXPR:
+		return read_binary<minus_expr>();
+	case MUL_EXPR:
+		return read_binary<mul_expr>();
+	case DIV_EXPR:
+		return read_binary<div_expr>();
+	case LT_EXPR:
+		return read_binary<lt_expr>();
+	case GT_EXPR:
+		return read_binary<gt_expr>();
+	case LTE_EXPR:
+		return read_binary<lte_expr>();
+	case GTE_EXPR:
+		return read_binary<gte_expr>();
+	case LSHIFT_EXPR:
+		return read_binary<lshift_expr>();
+	case RSHIFT_EXPR:
+		return read_binary<rshift_expr>();
+	case EQUALS_EXPR:
+		return read_binary<equals_expr>();
+	case NE_EXPR:
+		return read_binary<ne_expr>();
+	case MOD_EXPR:
+		return read_binary<mod_expr>();
+	default:
+		break;
+	}
+	if (kind >= NUM_BLOCK_KINDS) {
+		failed = true;
+		return nullptr;
+	}
+
+	// Every other kind is created here and registered before the
+	// children are read, the same order the ids were assigned in
+	block::Ptr b;
+	switch (kind) {
+	case NOT_EXPR:
+		b = make_node<not_expr>();
+		break;
+	case VAR_EXPR:
+		b = make_node<var_expr>();
+		break;
+	case INT_CONST:
+		b = make_node<int_const>();
+		break;
+	case DOUBLE_CONST:
+		b = make_node<double_const>();
+		break;
+	case FLOAT_CONST:
+		b = make_node<float_const>();
+		break;
+	case STRING_CONST:
+		b = make_node<string_const>();
+		break;
+	case ASSIGN_EXPR:
+		b = make_node<assign_expr>();
+		break;
+	case SQ_BKT_EXPR:
+		b = make_node<sq_bkt_expr>();
+		break;
+	case FUNCTION_CALL_EXPR:
+		b = make_node<function_call_expr>();
+		break;
+	case INITIALIZER_LIST_EXPR:
+		b = make_node<initializer_list_expr>();
+		break;
+	case MEMBER_ACCESS_EXPR:
+		b = make_node<member_access_expr>();
+		break;
+	case ADDR_OF_EXPR:
+		b = make_node<addr_of_expr>();
+		break;
+	case EXPR_STMT:
+		b = make_node<expr_stmt>();
+		break;
+	case STMT_BLOCK:
+		b = make_node<stmt_block>();
+		break;
+	case DECL_STMT:
+		b = make_node<decl_stmt>();
+		break;
+	case IF_STMT:
+		b = make_node<if_stmt>();
+		break;
+	case LABEL:
+		b = make_node<label>();
+		break;
+	case LABEL_STMT:
+		b = make_node<label_stmt>();
+		break;
+	case GOTO_STMT:
+		b = make_node<goto_stmt>();
+		break;
+	case WHILE_STMT:
+		b = make_node<while_stmt>();
+		break;
+	case FOR_STMT:
+		b = make_node<for_stmt>();
+		break;
+	case BREAK_STMT:
+		b = make_node<break_stmt>();
+		break;
+	case CONTINUE_STMT:
+		b = make_node<continue_stmt>();
+		break;
+	case FUNC_DECL:
+		b = make_node<func_decl>();
+		break;
+	case RETURN_STMT:
+		b = make_node<return_stmt>();
+		break;
+	case VAR:
+		b = make_node<var>();
+		break;
+	case SCALAR_TYPE:
+		b = make_node<scalar_type>();
+		break;
+	case POINTER_TYPE:
+		b = make_node<pointer_type>();
+		break;
+	case FUNCTION_TYPE:
+		b = make_node<function_type>();
+		break;
+	case ARRAY_TYPE:
+		b = make_node<array_type>();
+		break;
+	case BUILDER_VAR_TYPE:
+		b = make_node<builder_var_type>();
+		break;
+	case NAMED_TYPE:
+		b = make_node<named_type>();
+		break;
+	}
+	read_blocks.push_back(b);
+	read_header(b);
+
+	switch (kind) {
+	case NOT_EXPR:
+		to<not_expr>(b)->expr1 = read_block_as<expr>();
+		break;
+	case VAR_EXPR:
+		to<var_expr>(b)->var1 = read_block_as<var>();
+		break;
+	case INT_CONST:
+		to<int_const>(b)->value = (long long)read_u64();
+		break;
+	case DOUBLE_CONST: {
+		unsigned long long v = read_u64();
+		memcpy(&to<double_const>(b)->value, &v, sizeof(v));
+		break;
+	}
+	case FLOAT_CONST: {
+		unsigned int v = read_u64();
+		memcpy(&to<float_const>(b)->value, &v, sizeof(v));
+		break;
+	}
+	case STRING_CONST:
+		to<string_const>(b)->value = read_string();
+		break;
+	case ASSIGN_EXPR:
+		to<assign_expr>(b)->var1 = read_block_as<expr>();
+		to<assign_expr>(b)->expr1 = read_block_as<expr>();
+		break;
+	case SQ_BKT_EXPR:
+		to<sq_bkt_expr>(b)->var_expr = read_block_as<expr>();
+		to<sq_bkt_expr>(b)->index = read_block_as<expr>();
+		break;
+	case FUNCTION_CALL_EXPR: {
+		function_call_expr::Ptr e = to<function_call_expr>(b);
+		e->expr1 = read_block_as<expr>();
+		unsigned long long num_args = read_u64();
+		for (unsigned long long i = 0; i < num_args && !failed; i++)
+			e->args.push_back(read_block_as<expr>());
+		break;
+	}
+	case INITIALIZER_LIST_EXPR: {
+		initializer_list_expr::Ptr e = to<initializer_list_expr>(b);
+		unsigned long long num_elems = read_u64();
+		for (unsigned long long i = 0; i < num_elems && !failed; i++)
+			e->elems.push_back(read_block_as<expr>());
+		break;
+	}
+	case MEMBER_ACCESS_EXPR:
+		to<member_access_expr>(b)->parent_expr = read_block_as<expr>();
+		to<member_access_expr>(b)->member_name = read_string();
+		break;
+	case ADDR_OF_EXPR:
+		to<addr_of_expr>(b)->expr1 = read_block_as<expr>();
+		break;
+	case EXPR_STMT:
+		to<expr_stmt>(b)->expr1 = read_block_as<expr>();
+		break;
+	case STMT_BLOCK: {
+		stmt_block::Ptr s = to<stmt_block>(b);
+		unsigned long long num_stmts = read_u64();
+		for (unsigned long long i = 0; i < num_stmts && !failed; i++)
+			s->stmts.push_back(read_block_as<stmt>());
+		break;
+	}
+	case DECL_STMT:
+		to<decl_stmt>(b)->decl_var = read_block_as<var>();
+		to<decl_stmt>(b)->init_expr = read_block_as<expr>();
+		break;
+	case IF_STMT:
+		to<if_stmt>(b)->cond = read_block_as<expr>();
+		to<if_stmt>(b)->then_stmt = read_block_as<stmt>();
+		to<if_stmt>(b)->else_stmt = read_block_as<stmt>();
+		break;
+	case LABEL:
+		to<label>(b)->label_name = read_string();
+		break;
+	case LABEL_STMT:
+		to<label_stmt>(b)->label1 = read_block_as<label>();
+		break;
+	case GOTO_STMT:
+		to<goto_stmt>(b)->label1 = read_block_as<label>();
+		to<goto_stmt>(b)->temporary_label_number = read_tag();
+		break;
+	case WHILE_STMT: {
+		while_stmt::Ptr s = to<while_stmt>(b);
+		s->body = read_block_as<stmt>();
+		s->cond = read_block_as<expr>();
+		unsigned long long num_blocks = read_u64();
+		for (unsigned long long i = 0; i < num_blocks && !failed; i++)
+			s->continue_blocks.push_back(read_block_as<stmt_block>());
+		break;
+	}
+	case FOR_STMT:
+		to<for_stmt>(b)->decl_stmt = read_block_as<stmt>();
+		to<for_stmt>(b)->cond = read_block_as<expr>();
+		to<for_stmt>(b)->update = read_block_as<expr>();
+		to<for_stmt>(b)->body = read_block_as<stmt>();
+		break;
+	case BREAK_STMT:
+		to<break_stmt>(b)->type = read_string();
+		break;
+	case CONTINUE_STMT:
+		break;
+	case FUNC_DECL: {
+		func_decl::Ptr f = to<func_decl>(b);
+		f->func_name = read_string();
+		f->return_type = read_block_as<type>();
+		unsigned long long num_args = read_u64();
+		for (unsigned long long i = 0; i < num_args && !failed; i++)
+			f->args.push_back(read_block_as<var>());
+		f->body = read_block_as<stmt>();
+		break;
+	}
+	case RETURN_STMT:
+		to<return_stmt>(b)->return_val = read_block_as<expr>();
+		break;
+	case VAR:
+		to<var>(b)->var_name = read_string();
+		to<var>(b)->preferred_name = read_string();
+		to<var>(b)->var_type = read_block_as<type>();
+		break;
+	case SCALAR_TYPE: {
+		unsigned long long id = read_u64();
+		if (id > scalar_type::SIGNED_CHAR_TYPE) {
+			failed = true;
+			break;
+		}
+		to<scalar_type>(b)->scalar_type_id = (decltype(scalar_type::scalar_type_id))id;
+		break;
+	}
+	case POINTER_TYPE:
+		to<pointer_type>(b)->pointee_type = read_block_as<type>();
+		break;
+	case FUNCTION_TYPE: {
+		function_type::Ptr t = to<function_type>(b);
+		t->return_type = read_block_as<type>();
+		unsigned long long num_args = read_u64();
+		for (unsigned long long i = 0; i < num_args && !failed; i++)
+			t->arg_types.push_back(read_block_as<type>());
+		break;
+	}
+	case ARRAY_TYPE:
+		to<array_type>(b)->element_type = read_block_as<type>();
+		to<array_type>(b)->size = (int)read_u64();
+		break;
+	case BUILDER_VAR_TYPE: {
+		unsigned long long id = read_u64();
+		if (id > builder_var_type::STATIC_VAR) {
+			failed = true;
+			break;
+		}
+		to<builder_var_type>(b)->builder_var_type_id = (decltype(builder_var_type::builder_var_type_id))id;
+		to<builder_var_type>(b)->closure_type = read_block_as<type>();
+		break;
+	}
+	case NAMED_TYPE: {
+		named_type::Ptr t = to<named_type>(b);
+		t->type_name = read_string();
+		unsigned long long num_args = read_u64();
+		for (unsigned long long i = 0; i < num_args && !failed; i++)
+			t->template_args.push_back(read_block_as<type>());
+		break;
+	}
+	}
+	if (failed)
+		return nullptr;
+	return b;
+}
+
+} // namespace block
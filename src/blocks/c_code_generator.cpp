@@ -1,19 +1,18 @@
 #include "blocks/c_code_generator.h"
+#include "blocks/omp_annotations.h"
 #include <iomanip>
 #include <limits>
 #include <math.h>
-#include <sstream>
 
 namespace block {
 void c_code_generator::visit(not_expr::Ptr a) {
-  std::stringstream ss;
-  ss << "!(";
+  oss << "!(";
   a->expr1->accept(this);
-  ss << last;
-  ss << ")";
-  last = ss.str();
+  oss << ")";
 }
 
+// Binary operators and assignments are always bracketed when they appear
+// as an operand, everything else binds tighter than any operator slot
 static bool expr_needs_bracket(expr::Ptr a) {
 	if (isa<binary_expr>(a))
 		return true;
@@ -21,29 +20,20 @@ static bool expr_needs_bracket(expr::Ptr a) {
 		return true;
 	return false;
 }
-void c_code_generator::emit_binary_expr(binary_expr::Ptr a,
-					std::string character) {
-  std::stringstream ss;
-  if (expr_needs_bracket(a->expr1)) {
-    ss << "(";
-    a->expr1->accept(this);
-    ss << last;
-    ss << ")";
-  } else {
-    a->expr1->accept(this);
-    ss << last;
-  }
-  ss << " " << character << " ";
-  if (expr_needs_bracket(a->expr2)) {
-    ss << "(";
-    a->expr2->accept(this);
-    ss << last;
-    ss << ")";
+void c_code_generator::emit_operand(expr::Ptr a) {
+  if (expr_needs_bracket(a)) {
+    oss << "(";
+    a->accept(this);
+    oss << ")";
   } else {
-    a->expr2->accept(this);
-    ss << last;
+    a->accept(this);
   }
-  last = ss.str();
+}
+void c_code_generator::emit_binary_expr(binary_expr::Ptr a,
+					const char *character) {
+  emit_operand(a->expr1);
+  oss << " " << character << " ";
+  emit_operand(a->expr2);
 }
 void c_code_generator::visit(and_expr::Ptr a) { emit_binary_expr(a, "&&"); }
 void c_code_generator::visit(bitwise_and_expr::Ptr a) { emit_binary_expr(a, "&"); }
@@ -62,113 +52,87 @@ void c_code_generator::visit(rshift_expr::Ptr a) { emit_binary_expr(a, ">>"); }
 void c_code_generator::visit(equals_expr::Ptr a) { emit_binary_expr(a, "=="); }
 void c_code_generator::visit(ne_expr::Ptr a) { emit_binary_expr(a, "!="); }
 void c_code_generator::visit(mod_expr::Ptr a) { emit_binary_expr(a, "%"); }
-void c_code_generator::visit(var_expr::Ptr a) { last = a->var1->var_name; }
-void c_code_generator::visit(int_const::Ptr a) { last = std::to_string(a->value); }
+void c_code_generator::visit(var_expr::Ptr a) { oss << a->var1->var_name; }
+void c_code_generator::visit(int_const::Ptr a) { oss << std::to_string(a->value); }
+// The precision is set only for the one value so that the rest of the
+// stream is unaffected
+static void emit_floating(std::ostream &oss, double value) {
+  std::streamsize old_precision = oss.precision(15);
+  oss << value;
+  oss.precision(old_precision);
+  if (floor(value) == value)
+    oss << ".0";
+}
 void c_code_generator::visit(double_const::Ptr a) {
-  std::stringstream ss;
-  ss << std::setprecision(15);
-  ss << a->value;
-  if (floor(a->value) == a->value)
-    ss << ".0";
-  last = ss.str();
+  emit_floating(oss, a->value);
 }
 void c_code_generator::visit(float_const::Ptr a) {
-  std::stringstream ss;
-  ss << std::setprecision(15);
-  ss << a->value;
-  if (floor(a->value) == a->value)
-    ss << ".0";
-  ss << "f";
-  last = ss.str();
+  emit_floating(oss, a->value);
+  oss << "f";
 }
 void c_code_generator::visit(string_const::Ptr a) {
-  std::stringstream ss;
-  ss << "\"" << a->value << "\"";
-  last = ss.str();
+  oss << "\"" << a->value << "\"";
 }
 void c_code_generator::visit(assign_expr::Ptr a) {
-  std::stringstream ss;
-  if (expr_needs_bracket(a->var1)) {
-    ss << "(";
-    a->var1->accept(this);
-    ss << last;
-    ss << ")";
-  } else {
-    a->var1->accept(this);
-    ss << last;
-  }
-  ss << " = ";
+  emit_operand(a->var1);
+  oss << " = ";
   a->expr1->accept(this);
-  ss << last;
-  last = ss.str();
 }
 void c_code_generator::visit(expr_stmt::Ptr a) {
-  std::stringstream ss;
   a->expr1->accept(this);
-  ss << last;
-  ss << ";";
+  oss << ";";
   if (a->annotation != "")
-    ss << " //" << a->annotation;  
-  last = ss.str();
+    oss << " //" << a->annotation;
 }
 void c_code_generator::visit(stmt_block::Ptr a) {
-  std::stringstream ss;
-  ss << "{" << std::endl;
+  oss << "{" << std::endl;
   curr_indent += 1;
   for (auto stmt : a->stmts) {
-    printer::indent(ss, curr_indent);
+    printer::indent(oss, curr_indent);
     stmt->accept(this);
-    ss << last;
-    ss << std::endl;
+    oss << std::endl;
   }
   curr_indent -= 1;
-  printer::indent(ss, curr_indent);
+  printer::indent(oss, curr_indent);
 
-  ss << "}";
-  last = ss.str();
+  oss << "}";
 }
 void c_code_generator::visit(scalar_type::Ptr type) {
-  std::stringstream ss;
   switch(type->scalar_type_id) {
-    case scalar_type::BOOL_TYPE: ss << "bool"; break;
-    case scalar_type::SIGNED_CHAR_TYPE: ss << "signed char"; break;
-    case scalar_type::SHORT_INT_TYPE: ss << "short int"; break;
-    case scalar_type::UNSIGNED_SHORT_INT_TYPE: ss << "unsigned short int"; break;
-    case scalar_type::INT_TYPE: ss << "int"; break;
-    case scalar_type::UNSIGNED_INT_TYPE: ss << "unsigned int"; break;
-    case scalar_type::LONG_INT_TYPE: ss << "long int"; break;
-    case scalar_type::UNSIGNED_LONG_INT_TYPE: ss << "unsigned long int"; break;
-    case scalar_type::LONG_LONG_INT_TYPE: ss << "long long int"; break;
-    case scalar_type::UNSIGNED_LONG_LONG_INT_TYPE: ss << "unsigned long long int"; break;
-    case scalar_type::CHAR_TYPE: ss << "char"; break;
-    case scalar_type::UNSIGNED_CHAR_TYPE: ss << "unsigned char"; break;
-    case scalar_type::VOID_TYPE: ss << "void"; break;
-    case scalar_type::FLOAT_TYPE: ss << "float"; break;
-    case scalar_type::DOUBLE_TYPE: ss << "double"; break;
+    case scalar_type::BOOL_TYPE: oss << "bool"; break;
+    case scalar_type::SIGNED_CHAR_TYPE: oss << "signed char"; break;
+    case scalar_type::SHORT_INT_TYPE: oss << "short int"; break;
+    case scalar_type::UNSIGNED_SHORT_INT_TYPE: oss << "unsigned short int"; break;
+    case scalar_type::INT_TYPE: oss << "int"; break;
+    case scalar_type::UNSIGNED_INT_TYPE: oss << "unsigned int"; break;
+    case scalar_type::LONG_INT_TYPE: oss << "long int"; break;
+    case scalar_type::UNSIGNED_LONG_INT_TYPE: oss << "unsigned long int"; break;
+    case scalar_type::LONG_LONG_INT_TYPE: oss << "long long int"; break;
+    case scalar_type::UNSIGNED_LONG_LONG_INT_TYPE: oss << "unsigned long long int"; break;
+    case scalar_type::CHAR_TYPE: oss << "char"; break;
+    case scalar_type::UNSIGNED_CHAR_TYPE: oss << "unsigned char"; break;
+    case scalar_type::VOID_TYPE: oss << "void"; break;
+    case scalar_type::FLOAT_TYPE: oss << "float"; break;
+    case scalar_type::DOUBLE_TYPE: oss << "double"; break;
     default:
       assert(false && "Invalid scalar type");
   }
-  last = ss.str();
 }
 void c_code_generator::visit(named_type::Ptr type) {
-  std::stringstream ss;
-  ss << type->type_name;
+  oss << type->type_name;
   if (type->template_args.size()) {
-    ss << "<";
+    oss << "<";
     bool needs_comma = false;
     for (auto a: type->template_args) {
       if (needs_comma)
-	ss << ", ";
+	oss << ", ";
       needs_comma = true;
-      a->accept(this);	
-      ss << last;
+      a->accept(this);
     }
-    ss << ">";
+    oss << ">";
   }
-  last = ss.str();
 }
 void c_code_generator::visit(pointer_type::Ptr type) {
-  std::stringstream ss;
   if (!isa<scalar_type>(type->pointee_type) &&
       !isa<pointer_type>(type->pointee_type) &&
       !isa<named_type>(type->pointee_type))
@@ -176,389 +140,355 @@ void c_code_generator::visit(pointer_type::Ptr type) {
 	   false &&
 	   "Printing pointers of complex type is not supported yet");
   type->pointee_type->accept(this);
-  ss << last;
-  ss << "*";
-  last = ss.str();
+  oss << "*";
 }
 void c_code_generator::visit(array_type::Ptr type) {
-  std::stringstream ss;
   if (!isa<scalar_type>(type->element_type) &&
       !isa<pointer_type>(type->element_type) &&
       !isa<named_type>(type->element_type))
     assert(false &&
 	   "Printing arrays of complex type is not supported yet");
   type->element_type->accept(this);
-  ss << last;
   if (type->size != -1)
-    ss << "[" << type->size << "]";
+    oss << "[" << type->size << "]";
   else
-    ss << "[]";
-  last = ss.str();
+    oss << "[]";
 }
 void c_code_generator::visit(builder_var_type::Ptr type) {
-  std::stringstream ss;
   if (type->builder_var_type_id == builder_var_type::DYN_VAR)
-    ss << "builder::dyn_var<";
+    oss << "builder::dyn_var<";
   else if (type->builder_var_type_id == builder_var_type::STATIC_VAR)
-    ss << "builder::static_var<";
+    oss << "builder::static_var<";
   type->closure_type->accept(this);
-  ss << last;
-  ss << ">";
-  last = ss.str();
+  oss << ">";
+}
+void c_code_generator::visit(var::Ptr var) {
+  oss << var->var_name;
+}
+
+static void emit_attributes(std::ostream &oss, block::Ptr b) {
+  if (b->hasMetadata<std::vector<std::string>>("attributes")) {
+    const auto &attributes = b->getMetadata<std::vector<std::string>>("attributes");
+    for (auto attr: attributes) {
+      oss << " " << attr;
+    }
+  }
 }
-void c_code_generator::visit(var::Ptr var) { 
-  last = var->var_name;
+
+// Pointers and array parameters with "restrict" metadata are declared
+// __restrict, the arrays as pointers to their first element. Vars with
+// "aligned" metadata get the alignment as an attribute for arrays and through
+// __builtin_assume_aligned on the init for pointers
+static bool is_restrict(var::Ptr v) {
+  return v != nullptr && (isa<pointer_type>(v->var_type) || isa<array_type>(v->var_type)) &&
+         v->hasMetadata<bool>("restrict") && v->getMetadata<bool>("restrict");
+}
+static int get_alignment(var::Ptr v) {
+  if (!v->hasMetadata<int>("aligned"))
+    return 0;
+  return v->getMetadata<int>("aligned");
 }
 
-static void print_array_decl(array_type::Ptr atype, var::Ptr decl_var, c_code_generator* self, 
-				    std::stringstream &append) {
-  std::stringstream ss;
-  append << "[";
-  if (atype->size != -1)
-    append << atype->size;
-  append << "]";
+// The element type comes before the name and the sizes of all the
+// dimensions after it, outermost first
+void c_code_generator::emit_array_decl(array_type::Ptr atype, var::Ptr decl_var) {
+  type::Ptr element_type = atype->element_type;
+  while (isa<array_type>(element_type))
+    element_type = to<array_type>(element_type)->element_type;
+  if (!isa<scalar_type>(element_type) && !isa<pointer_type>(element_type)
+      && !isa<named_type>(element_type))
+    assert(false && "Printing arrays of complex type is not supported yet");
 
-  if (isa<array_type>(atype->element_type)) {
-    print_array_decl(to<array_type>(atype->element_type), decl_var, self, append);
-    ss << self->last;
+  element_type->accept(this);
+  emit_attributes(oss, decl_var);
+  oss << " ";
+  oss << decl_var->var_name;
+  type::Ptr t = atype;
+  while (isa<array_type>(t)) {
+    array_type::Ptr dim = to<array_type>(t);
+    oss << "[";
+    if (dim->size != -1)
+      oss << dim->size;
+    oss << "]";
+    t = dim->element_type;
   }
-  else if (isa<scalar_type>(atype->element_type) || isa<pointer_type>(atype->element_type) 
-	   || isa<named_type>(atype->element_type)) {
-    atype->element_type->accept(self);	
-    ss << self->last;
-    if (decl_var->hasMetadata<std::vector<std::string>>("attributes")) {
-      const auto &attributes = decl_var->getMetadata<std::vector<std::string>>("attributes");
-      for (auto attr: attributes) {
-	ss << " " << attr;
-      }
-    }
-    ss << " ";
-    ss << decl_var->var_name;
-    ss << append.str();	
-  } else {
+  if (get_alignment(decl_var) != 0)
+    oss << " __attribute__((aligned(" << get_alignment(decl_var) << ")))";
+}
+
+// A pointer to the first element of the array, like float* a for float a[]
+// and float (*a)[4] for float a[][4]
+void c_code_generator::emit_array_pointer(array_type::Ptr atype, var::Ptr decl_var, bool restrict_ptr) {
+  type::Ptr element_type = atype->element_type;
+  while (isa<array_type>(element_type))
+    element_type = to<array_type>(element_type)->element_type;
+  if (!isa<scalar_type>(element_type) && !isa<pointer_type>(element_type)
+      && !isa<named_type>(element_type))
     assert(false && "Printing arrays of complex type is not supported yet");
+
+  element_type->accept(this);
+  bool nested = isa<array_type>(atype->element_type);
+  oss << (nested ? " (*" : "*");
+  if (restrict_ptr)
+    oss << " __restrict";
+  emit_attributes(oss, decl_var);
+  oss << " " << decl_var->var_name;
+  if (nested)
+    oss << ")";
+  for (type::Ptr t = atype->element_type; isa<array_type>(t); t = to<array_type>(t)->element_type)
+    oss << "[" << to<array_type>(t)->size << "]";
+}
+
+void c_code_generator::emit_func_ptr(function_type::Ptr type, const std::string &name) {
+  type->return_type->accept(this);
+  oss << " (*";
+  oss << name;
+  oss << ")(";
+  for (unsigned int i = 0; i < type->arg_types.size(); i++) {
+    type->arg_types[i]->accept(this);
+    if (i != type->arg_types.size() - 1)
+      oss << ", ";
   }
-  //  return ss.str();
-  self->last = ss.str();
+  oss << ")";
 }
 
 void c_code_generator::visit(decl_stmt::Ptr a) {
-  std::stringstream ss;
+  std::string unapplied = omp_unapplied_comment(a);
+  if (unapplied != "") {
+    oss << unapplied << std::endl;
+    printer::indent(oss, curr_indent);
+  }
+  // An array without a size can't be initialized with another one, like the
+  // copy of an array argument, so the copy points to its first element instead
+  bool array_copy = isa<array_type>(a->decl_var->var_type) && to<array_type>(a->decl_var->var_type)->size == -1 &&
+                    a->init_expr != nullptr && isa<var_expr>(a->init_expr) &&
+                    isa<array_type>(to<var_expr>(a->init_expr)->var1->var_type);
   if (isa<function_type>(a->decl_var->var_type)) {
-    function_type::Ptr type =
-      to<function_type>(a->decl_var->var_type);
-    type->return_type->accept(this);
-    ss << last;
-    ss << " (*";
-    ss << a->decl_var->var_name;
-    ss << ")(";
-    for (unsigned int i = 0; i < type->arg_types.size(); i++) {
-      type->arg_types[i]->accept(this);
-      ss << last;
-      if (i != type->arg_types.size() - 1)
-	ss << ", ";
-    }
-    ss << ")";
-    if (a->init_expr != nullptr) {
-      ss << " = ";
-      a->init_expr->accept(this);
-      ss << last;
-    }
-    ss << ";";
-    last = ss.str();
-    return;
+    emit_func_ptr(to<function_type>(a->decl_var->var_type), a->decl_var->var_name);
+  } else if (array_copy) {
+    emit_array_pointer(to<array_type>(a->decl_var->var_type), a->decl_var, is_restrict(a->decl_var));
   } else if (isa<array_type>(a->decl_var->var_type)) {
-    array_type::Ptr type = to<array_type>(a->decl_var->var_type);
-    std::stringstream s;
-    print_array_decl(type, a->decl_var, this, s);
-    ss << last;
-    if (a->init_expr != nullptr) {
-      ss << " = ";
-      a->init_expr->accept(this);
-      ss << last;
-    }
-    ss << ";";
-    last = ss.str();
-    return;
-  }
-
-  a->decl_var->var_type->accept(this);
-  ss << last;
-  if (a->decl_var->hasMetadata<std::vector<std::string>>("attributes")) {
-    const auto &attributes = a->decl_var->getMetadata<std::vector<std::string>>("attributes");
-    for (auto attr: attributes) {
-      ss << " " << attr;
-    }
-  }
-  ss << " ";
-  ss << a->decl_var->var_name;
-  if (a->init_expr == nullptr) {
-    ss << ";";
+    emit_array_decl(to<array_type>(a->decl_var->var_type), a->decl_var);
   } else {
-    ss << " = ";
+    a->decl_var->var_type->accept(this);
+    if (is_restrict(a->decl_var))
+      oss << " __restrict";
+    emit_attributes(oss, a->decl_var);
+    oss << " ";
+    oss << a->decl_var->var_name;
+  }
+  if (a->init_expr != nullptr && isa<pointer_type>(a->decl_var->var_type) && get_alignment(a->decl_var) != 0) {
+    oss << " = (";
+    a->decl_var->var_type->accept(this);
+    oss << ")__builtin_assume_aligned(";
+    a->init_expr->accept(this);
+    oss << ", " << get_alignment(a->decl_var) << ")";
+  } else if (a->init_expr != nullptr) {
+    oss << " = ";
     a->init_expr->accept(this);
-    ss << last;
-    ss << ";";
   }
-  last = ss.str();
+  oss << ";";
 }
 void c_code_generator::visit(if_stmt::Ptr a) {
-  std::stringstream ss;
-  ss << "if (";
+  oss << "if (";
   a->cond->accept(this);
-  ss << last;
-  ss << ")";
+  oss << ")";
   if (isa<stmt_block>(a->then_stmt)) {
-    ss << " ";
+    oss << " ";
     a->then_stmt->accept(this);
-    ss << last;
-    ss << " ";
+    oss << " ";
   } else {
-    ss << std::endl;
+    oss << std::endl;
     curr_indent++;
-    printer::indent(ss, curr_indent);
+    printer::indent(oss, curr_indent);
     a->then_stmt->accept(this);
-    ss << last;
-    ss << std::endl;
+    oss << std::endl;
     curr_indent--;
   }
 
   if (isa<stmt_block>(a->else_stmt)) {
-    if (to<stmt_block>(a->else_stmt)->stmts.size() == 0) {
-      last = ss.str();
+    if (to<stmt_block>(a->else_stmt)->stmts.size() == 0)
       return;
-    }
-    ss << "else";
-    ss << " ";
+    oss << "else";
+    oss << " ";
     a->else_stmt->accept(this);
-    ss << last;
   } else {
-    ss << "else";
-    ss << std::endl;
+    oss << "else";
+    oss << std::endl;
     curr_indent++;
-    printer::indent(ss, curr_indent);
+    printer::indent(oss, curr_indent);
     a->else_stmt->accept(this);
-    ss << last;
     curr_indent--;
   }
-  last = ss.str();
 }
 void c_code_generator::visit(while_stmt::Ptr a) {
-  std::stringstream ss;
-  ss << "while (";
+  oss << "while (";
   a->cond->accept(this);
-  ss << last;
-  ss << ")";
+  oss << ")";
   if (isa<stmt_block>(a->body)) {
-    ss << " ";
+    oss << " ";
     a->body->accept(this);
-    ss << last;
   } else {
-    ss << std::endl;
+    oss << std::endl;
     curr_indent++;
-    printer::indent(ss, curr_indent);
+    printer::indent(oss, curr_indent);
     a->body->accept(this);
-    ss << last;
     curr_indent--;
   }
-  last = ss.str();
 }
 void c_code_generator::visit(for_stmt::Ptr a) {
-  std::stringstream ss;
-  ss << "for (";
+  std::string pragma = omp_parallel_pragma(a);
+  if (pragma == "")
+    pragma = omp_simd_pragma(a);
+  if (pragma != "") {
+    oss << pragma << std::endl;
+    printer::indent(oss, curr_indent);
+  }
+  oss << "for (";
   a->decl_stmt->accept(this);
-  ss << last;
-  ss << " ";
+  oss << " ";
   a->cond->accept(this);
-  ss << last;
-  ss << "; ";
+  oss << "; ";
   a->update->accept(this);
-  ss << last;
-  ss << ")";
+  oss << ")";
   if (isa<stmt_block>(a->body)) {
-    ss << " ";
+    oss << " ";
     a->body->accept(this);
-    ss << last;
   } else {
-    ss << std::endl;
+    oss << std::endl;
     curr_indent++;
-    printer::indent(ss, curr_indent);
+    printer::indent(oss, curr_indent);
     a->body->accept(this);
-    ss << last;
     curr_indent--;
   }
-  last = ss.str();
 }
-void c_code_generator::visit(break_stmt::Ptr a) { last = "break;"; }
-void c_code_generator::visit(continue_stmt::Ptr a) { last = "continue;"; }
+void c_code_generator::visit(break_stmt::Ptr a) { oss << "break;"; }
+void c_code_generator::visit(continue_stmt::Ptr a) { oss << "continue;"; }
 void c_code_generator::visit(sq_bkt_expr::Ptr a) {
-  std::stringstream ss;
-  if (expr_needs_bracket(a->var_expr)) {
-    ss << "(";
-  }
-  a->var_expr->accept(this);
-  ss << last;
-  if (expr_needs_bracket(a->var_expr)) {
-    ss << ")";
-  }
-  ss << "[";
+  emit_operand(a->var_expr);
+  oss << "[";
   a->index->accept(this);
-  ss << last;
-  ss << "]";
-  last = ss.str();
+  oss << "]";
 }
 void c_code_generator::visit(function_call_expr::Ptr a) {
-  std::stringstream ss;
-  if (expr_needs_bracket(a->expr1)) {
-    ss << "(";
-  }
-  a->expr1->accept(this);
-  ss << last;
-  if (expr_needs_bracket(a->expr1)) {
-    ss << ")";
-  }
-  ss << "(";
+  emit_operand(a->expr1);
+  oss << "(";
   for (unsigned int i = 0; i < a->args.size(); i++) {
     a->args[i]->accept(this);
-    ss << last;
     if (i != a->args.size() - 1)
-      ss << ", ";
+      oss << ", ";
   }
-  ss << ")";
-  last = ss.str();
+  oss << ")";
 }
 void c_code_generator::visit(initializer_list_expr::Ptr a) {
-  std::stringstream ss;
-  ss << "{";
+  oss << "{";
   for (unsigned int i = 0; i < a->elems.size(); i++) {
     a->elems[i]->accept(this);
-    ss << last;
     if (i != a->elems.size() - 1)
-      ss << ", ";
+      oss << ", ";
   }
-  ss << "}";
-  last = ss.str();
+  oss << "}";
 }
 void c_code_generator::handle_func_arg(var::Ptr a) {
-  std::stringstream ss;
-  function_type::Ptr type =
-    to<function_type>(a->var_type);
-  type->return_type->accept(this);
-  ss << last;
-  ss << " (*";
-  ss << a->var_name;
-  ss << ")(";
-  for (unsigned int i = 0; i < type->arg_types.size(); i++) {
-    type->arg_types[i]->accept(this);
-    ss << last;
-    if (i != type->arg_types.size() - 1)
-      ss << ", ";
+  emit_func_ptr(to<function_type>(a->var_type), a->var_name);
+}
+// The staged function sees the args through copies declared at the start of
+// the body, the metadata is set on those
+static var::Ptr find_arg_copy(func_decl::Ptr f, var::Ptr arg) {
+  if (!isa<stmt_block>(f->body))
+    return nullptr;
+  for (auto s : to<stmt_block>(f->body)->stmts) {
+    if (!isa<decl_stmt>(s))
+      continue;
+    expr::Ptr init = to<decl_stmt>(s)->init_expr;
+    if (init != nullptr && isa<var_expr>(init) && to<var_expr>(init)->var1 == arg)
+      return to<decl_stmt>(s)->decl_var;
   }
-  ss << ")";
-  last = ss.str();
+  return nullptr;
 }
 void c_code_generator::visit(func_decl::Ptr a) {
-  std::stringstream ss;
   a->return_type->accept(this);
-  ss << last;
-  if (a->hasMetadata<std::vector<std::string>>("attributes")) {
-    const auto &attributes = a->getMetadata<std::vector<std::string>>("attributes");
-    for (auto attr: attributes) {
-      ss << " " << attr;
-    }
-  }
-  ss << " " << a->func_name;
-  ss << " (";
+  emit_attributes(oss, a);
+  oss << " " << a->func_name;
+  oss << " (";
   bool printDelim = false;
   for (auto arg : a->args) {
     if (printDelim)
-      ss << ", ";
+      oss << ", ";
     printDelim = true;
     if (isa<function_type>(arg->var_type)) {
       handle_func_arg(arg);
+    } else if (isa<array_type>(arg->var_type)) {
+      // An array parameter is a pointer, printing it as one keeps __restrict valid C++
+      if (is_restrict(arg) || is_restrict(find_arg_copy(a, arg)))
+        emit_array_pointer(to<array_type>(arg->var_type), arg, true);
+      else
+        emit_array_decl(to<array_type>(arg->var_type), arg);
     } else {
       arg->var_type->accept(this);
-      ss << last;
-      ss << " " << arg->var_name;
+      if (is_restrict(arg) || is_restrict(find_arg_copy(a, arg)))
+        oss << " __restrict";
+      oss << " " << arg->var_name;
     }
   }
   if (!printDelim)
-    ss << "void";
-  ss << ")";
+    oss << "void";
+  oss << ")";
   if (isa<stmt_block>(a->body)) {
-    ss << " ";
+    oss << " ";
     a->body->accept(this);
-    ss << last;
-    ss << std::endl;
+    oss << std::endl;
   } else {
-    ss << std::endl;
+    oss << std::endl;
     curr_indent++;
-    printer::indent(ss, curr_indent);
+    printer::indent(oss, curr_indent);
     a->body->accept(this);
-    ss << last;
-    ss << std::endl;
+    oss << std::endl;
     curr_indent--;
   }
-  last = ss.str();
 }
-void c_code_generator::visit(goto_stmt::Ptr a) { 
-  std::stringstream ss;
-  //a->dump(ss, 1); 
-  ss << "goto ";
-  ss << a->label1->label_name << ";";
-  last = ss.str();
+void c_code_generator::visit(goto_stmt::Ptr a) {
+  oss << "goto ";
+  oss << a->label1->label_name << ";";
 }
-void c_code_generator::visit(label_stmt::Ptr a) { 
-  std::stringstream ss;
-  ss << a->label1->label_name << ":";
-  last = ss.str();
+void c_code_generator::visit(label_stmt::Ptr a) {
+  oss << a->label1->label_name << ":";
 }
 void c_code_generator::visit(return_stmt::Ptr a) {
-  std::stringstream ss;
-  ss << "return ";
+  oss << "return ";
   a->return_val->accept(this);
-  ss << last;
-  ss << ";";
-  last = ss.str();
+  oss << ";";
 }
 void c_code_generator::visit(member_access_expr::Ptr a) {
-  std::stringstream ss;
   if (isa<sq_bkt_expr>(a->parent_expr)) {
     sq_bkt_expr::Ptr parent = to<sq_bkt_expr>(a->parent_expr);
     if (isa<int_const>(parent->index)) {
       auto index = to<int_const>(parent->index);
       if (index->value == 0) {
 	if (!isa<var_expr>(parent->var_expr)) {
-	  ss << "(";
+	  oss << "(";
 	}
 	parent->var_expr->accept(this);
-	ss << last;
 	if (!isa<var_expr>(parent->var_expr)) {
-	  ss << ")";
+	  oss << ")";
 	}
-	ss << "->" << a->member_name;	
-	last = ss.str();
+	oss << "->" << a->member_name;
 	return;
       }
     }
   }
 
   if (!isa<var_expr>(a->parent_expr))
-    ss << "(";
+    oss << "(";
   a->parent_expr->accept(this);
-  ss << last;
   if (!isa<var_expr>(a->parent_expr))
-    ss << ")";
+    oss << ")";
 
-  ss << "." << a->member_name;
-  last = ss.str();
+  oss << "." << a->member_name;
 }
 void c_code_generator::visit(addr_of_expr::Ptr a) {
-  std::stringstream ss;
-  ss << "(&(";
+  oss << "(&(";
   a->expr1->accept(this);
-  ss << last;
-  ss << "))";
-  last = ss.str();
+  oss << "))";
 }
 } // namespace block
@@ -0,0 +1,242 @@
+#include "blocks/cfg.h"
+#include "blocks/c_code_generator.h"
+#include <unordered_map>
+
+namespace block {
+
+class cfg_builder {
+public:
+	control_flow_graph &cfg;
+	cfg_builder(control_flow_graph &g) : cfg(g) {}
+
+	basic_block *new_block(void) {
+		cfg.blocks.push_back(std::unique_ptr<basic_block>(new basic_block()));
+		cfg.blocks.back()->id = cfg.blocks.size() - 1;
+		return cfg.blocks.back().get();
+	}
+	void add_edge(basic_block *from, basic_block *to) {
+		from->successors.push_back(to);
+		to->predecessors.push_back(from);
+	}
+	// Returns the block control leaves the statement in, null if it
+	// doesn't fall through (like after a goto)
+	basic_block *build(stmt::Ptr s, basic_block *current);
+
+private:
+	std::vector<basic_block *> break_targets;
+	std::vector<basic_block *> continue_targets;
+	std::unordered_map<label *, basic_block *> label_blocks;
+
+	basic_block *label_block(label::Ptr l) {
+		auto it = label_blocks.find(l.get());
+		if (it != label_blocks.end())
+			return it->second;
+		basic_block *bb = new_block();
+		label_blocks[l.get()] = bb;
+		return bb;
+	}
+	basic_block *build_loop(stmt::Ptr loop, expr::Ptr cond, stmt::Ptr body, expr::Ptr update, basic_block *current);
+};
+
+basic_block *cfg_builder::build_loop(stmt::Ptr loop, expr::Ptr cond, stmt::Ptr body, expr::Ptr update,
+				     basic_block *current) {
+	basic_block *header = new_block();
+	add_edge(current, header);
+	header->nodes.push_back(cond);
+	header->terminator = loop;
+	basic_block *body_bb = new_block();
+	basic_block *exit_bb = new_block();
+	add_edge(header, body_bb);
+	add_edge(header, exit_bb);
+
+	// The update of a for loop gets a block of its own, continue goes there
+	basic_block *latch = header;
+	if (update != nullptr) {
+		latch = new_block();
+		latch->nodes.push_back(update);
+		add_edge(latch, header);
+	}
+	break_targets.push_back(exit_bb);
+	continue_targets.push_back(latch);
+	basic_block *body_end = build(body, body_bb);
+	if (body_end != nullptr)
+		add_edge(body_end, latch);
+	break_targets.pop_back();
+	continue_targets.pop_back();
+	return exit_bb;
+}
+
+basic_block *cfg_builder::build(stmt::Ptr s, basic_block *current) {
+	if (isa<label_stmt>(s)) {
+		basic_block *bb = label_block(to<label_stmt>(s)->label1);
+		if (current != nullptr)
+			add_edge(current, bb);
+		return bb;
+	}
+	// Code after a jump is only reachable through a label
+	if (current == nullptr)
+		current = new_block();
+
+	if (isa<stmt_block>(s)) {
+		for (auto child : to<stmt_block>(s)->stmts)
+			current = build(child, current);
+		return current;
+	} else if (isa<if_stmt>(s)) {
+		if_stmt::Ptr a = to<if_stmt>(s);
+		current->nodes.push_back(a->cond);
+		current->terminator = a;
+		basic_block *then_bb = new_block();
+		basic_block *else_bb = new_block();
+		add_edge(current, then_bb);
+		add_edge(current, else_bb);
+		basic_block *then_end = build(a->then_stmt, then_bb);
+		basic_block *else_end = build(a->else_stmt, else_bb);
+		if (then_end == nullptr && else_end == nullptr)
+			return nullptr;
+		basic_block *join = new_block();
+		if (then_end != nullptr)
+			add_edge(then_end, join);
+		if (else_end != nullptr)
+			add_edge(else_end, join);
+		return join;
+	} else if (isa<while_stmt>(s)) {
+		while_stmt::Ptr a = to<while_stmt>(s);
+		return build_loop(a, a->cond, a->body, nullptr, current);
+	} else if (isa<for_stmt>(s)) {
+		for_stmt::Ptr a = to<for_stmt>(s);
+		current = build(a->decl_stmt, current);
+		return build_loop(a, a->cond, a->body, a->update, current);
+	} else if (isa<goto_stmt>(s)) {
+		add_edge(current, label_block(to<goto_stmt>(s)->label1));
+		return nullptr;
+	} else if (isa<break_stmt>(s) || isa<continue_stmt>(s)) {
+		// Outside of a loop they end the code, like in the body of a loop built on its own
+		std::vector<basic_block *> &targets = isa<break_stmt>(s) ? break_targets : continue_targets;
+		add_edge(current, targets.empty() ? cfg.exit : targets.back());
+		return nullptr;
+	} else if (isa<return_stmt>(s)) {
+		current->nodes.push_back(s);
+		add_edge(current, cfg.exit);
+		return nullptr;
+	}
+	current->nodes.push_back(s);
+	return current;
+}
+
+std::unique_ptr<control_flow_graph> control_flow_graph::build(func_decl::Ptr func) { return build(func->body); }
+
+std::unique_ptr<control_flow_graph> control_flow_graph::build(stmt::Ptr body) {
+	// extract_function_ast hands out the func_decl as a stmt
+	if (isa<func_decl>(body))
+		body = to<func_decl>(body)->body;
+	std::unique_ptr<control_flow_graph> cfg(new control_flow_graph());
+	cfg_builder builder(*cfg);
+	cfg->entry = builder.new_block();
+	cfg->exit = builder.new_block();
+	basic_block *end = builder.build(body, cfg->entry);
+	if (end != nullptr)
+		builder.add_edge(end, cfg->exit);
+	cfg->compute_dominators();
+	return cfg;
+}
+
+std::vector<basic_block *> control_flow_graph::reverse_postorder(void) {
+	std::vector<basic_block *> order;
+	std::vector<bool> visited(blocks.size(), false);
+	// Explicit stack, extracted functions can nest deep enough to overflow the real one
+	std::vector<std::pair<basic_block *, unsigned int>> stack;
+	stack.push_back(std::make_pair(entry, 0));
+	visited[entry->id] = true;
+	while (!stack.empty()) {
+		auto &top = stack.back();
+		if (top.second < top.first->successors.size()) {
+			basic_block *next = top.first->successors[top.second++];
+			if (!visited[next->id]) {
+				visited[next->id] = true;
+				stack.push_back(std::make_pair(next, 0));
+			}
+		} else {
+			order.push_back(top.first);
+			stack.pop_back();
+		}
+	}
+	return std::vector<basic_block *>(order.rbegin(), order.rend());
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+void control_flow_graph::compute_dominators(void) {
+	std::vector<basic_block *> order = reverse_postorder();
+	std::vector<int> rpo_index(blocks.size(), -1);
+	for (unsigned int i = 0; i < order.size(); i++)
+		rpo_index[order[i]->id] = i;
+	for (auto &bb : blocks)
+		bb->idom = nullptr;
+
+	entry->idom = entry;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned int i = 1; i < order.size(); i++) {
+			basic_block *bb = order[i];
+			basic_block *new_idom = nullptr;
+			for (auto pred : bb->predecessors) {
+				if (pred->idom == nullptr)
+					continue;
+				if (new_idom == nullptr) {
+					new_idom = pred;
+					continue;
+				}
+				basic_block *a = pred, *b = new_idom;
+				while (a != b) {
+					while (rpo_index[a->id] > rpo_index[b->id])
+						a = a->idom;
+					while (rpo_index[b->id] > rpo_index[a->id])
+						b = b->idom;
+				}
+				new_idom = a;
+			}
+			if (bb->idom != new_idom) {
+				bb->idom = new_idom;
+				changed = true;
+			}
+		}
+	}
+	entry->idom = nullptr;
+}
+
+bool control_flow_graph::dominates(basic_block *a, basic_block *b) {
+	if (a == entry)
+		return b == entry || b->idom != nullptr;
+	for (; b != nullptr; b = b->idom) {
+		if (a == b)
+			return true;
+	}
+	return false;
+}
+
+static void dump_edges(std::ostream &oss, const char *name, const std::vector<basic_block *> &edges) {
+	oss << " " << name << ":";
+	for (auto bb : edges)
+		oss << " bb" << bb->id;
+}
+
+void control_flow_graph::dump(std::ostream &oss) {
+	for (auto &bb : blocks) {
+		oss << "bb" << bb->id;
+		if (bb.get() == entry)
+			oss << " (entry)";
+		if (bb.get() == exit)
+			oss << " (exit)";
+		dump_edges(oss, "preds", bb->predecessors);
+		dump_edges(oss, "succs", bb->successors);
+		if (bb->idom != nullptr)
+			oss << " idom: bb" << bb->idom->id;
+		oss << std::endl;
+		for (auto node : bb->nodes) {
+			printer::indent(oss, 1);
+			c_code_generator::generate_code(node, oss, 1);
+		}
+	}
+}
+
+} // namespace block
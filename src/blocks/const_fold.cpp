@@ -0,0 +1,364 @@
+#include "blocks/const_fold.h"
+#include "blocks/stmt.h"
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace block {
+
+// What is known about the C type of an expr. Only ints and the wider
+// integer types are tracked, chars and shorts would be promoted by the operators
+enum class int_class { none, any, is_signed, is_unsigned };
+
+static int_class classify_scalar(type::Ptr t) {
+	if (!isa<scalar_type>(t))
+		return int_class::none;
+	switch (to<scalar_type>(t)->scalar_type_id) {
+	case scalar_type::INT_TYPE:
+	case scalar_type::LONG_INT_TYPE:
+	case scalar_type::LONG_LONG_INT_TYPE:
+		return int_class::is_signed;
+	case scalar_type::UNSIGNED_INT_TYPE:
+	case scalar_type::UNSIGNED_LONG_INT_TYPE:
+	case scalar_type::UNSIGNED_LONG_LONG_INT_TYPE:
+		return int_class::is_unsigned;
+	default:
+		return int_class::none;
+	}
+}
+
+static int_class classify_expr(expr::Ptr e) {
+	if (isa<int_const>(e))
+		return int_class::is_signed;
+	if (isa<var_expr>(e))
+		return classify_scalar(to<var_expr>(e)->var1->var_type);
+	if (isa<sq_bkt_expr>(e)) {
+		auto base = to<sq_bkt_expr>(e)->var_expr;
+		if (!isa<var_expr>(base))
+			return int_class::none;
+		type::Ptr t = to<var_expr>(base)->var1->var_type;
+		if (isa<pointer_type>(t))
+			return classify_scalar(to<pointer_type>(t)->pointee_type);
+		if (isa<array_type>(t))
+			return classify_scalar(to<array_type>(t)->element_type);
+		return int_class::none;
+	}
+	if (isa<not_expr>(e))
+		return int_class::is_signed;
+	if (!isa<binary_expr>(e))
+		return int_class::none;
+
+	binary_expr::Ptr b = to<binary_expr>(e);
+	switch (b->kind) {
+	case block_kind::and_expr:
+	case block_kind::or_expr:
+	case block_kind::lt_expr:
+	case block_kind::gt_expr:
+	case block_kind::lte_expr:
+	case block_kind::gte_expr:
+	case block_kind::equals_expr:
+	case block_kind::ne_expr:
+		return int_class::is_signed;
+	case block_kind::lshift_expr:
+	case block_kind::rshift_expr:
+		return classify_expr(b->expr1);
+	default:
+		break;
+	}
+	int_class c1 = classify_expr(b->expr1);
+	int_class c2 = classify_expr(b->expr2);
+	if (c1 == int_class::none || c2 == int_class::none)
+		return int_class::none;
+	// The usual conversions can go either way when the ranks differ
+	if (c1 != c2)
+		return int_class::any;
+	return c1;
+}
+
+static bool fits_int(long long v) { return v >= INT_MIN && v <= INT_MAX; }
+
+// Literals that fit in an int are ints in C, so an operator on two of them
+// is only folded if the result fits too. Otherwise the C code would overflow
+static bool fold_int(block_kind kind, long long a, long long b, long long &r) {
+	bool wide = !fits_int(a) || !fits_int(b);
+	switch (kind) {
+	case block_kind::plus_expr:
+		if (__builtin_add_overflow(a, b, &r))
+			return false;
+		break;
+	case block_kind::minus_expr:
+		if (__builtin_sub_overflow(a, b, &r))
+			return false;
+		break;
+	case block_kind::mul_expr:
+		if (__builtin_mul_overflow(a, b, &r))
+			return false;
+		break;
+	case block_kind::div_expr:
+	case block_kind::mod_expr:
+		if (b == 0 || (a == LLONG_MIN && b == -1))
+			return false;
+		r = kind == block_kind::div_expr ? a / b : a % b;
+		break;
+	case block_kind::lshift_expr:
+		if (a < 0 || b < 0 || b >= (wide ? 63 : 31) || a > (LLONG_MAX >> b))
+			return false;
+		r = a << b;
+		break;
+	case block_kind::rshift_expr:
+		if (a < 0 || b < 0 || b >= (wide ? 63 : 31))
+			return false;
+		r = a >> b;
+		break;
+	case block_kind::bitwise_and_expr: r = a & b; break;
+	case block_kind::bitwise_or_expr: r = a | b; break;
+	case block_kind::and_expr: r = a && b; break;
+	case block_kind::or_expr: r = a || b; break;
+	case block_kind::lt_expr: r = a < b; break;
+	case block_kind::gt_expr: r = a > b; break;
+	case block_kind::lte_expr: r = a <= b; break;
+	case block_kind::gte_expr: r = a >= b; break;
+	case block_kind::equals_expr: r = a == b; break;
+	case block_kind::ne_expr: r = a != b; break;
+	default:
+		return false;
+	}
+	return wide || fits_int(r);
+}
+
+// Comparisons produce an int, the arithmetic operators a value of type T
+template <typename T>
+static bool fold_floating(block_kind kind, T a, T b, T &r, long long &cmp, bool &is_cmp) {
+	is_cmp = false;
+	switch (kind) {
+	case block_kind::plus_expr: r = a + b; break;
+	case block_kind::minus_expr: r = a - b; break;
+	case block_kind::mul_expr: r = a * b; break;
+	case block_kind::div_expr:
+		if (b == 0)
+			return false;
+		r = a / b;
+		break;
+	case block_kind::lt_expr: cmp = a < b; is_cmp = true; return true;
+	case block_kind::gt_expr: cmp = a > b; is_cmp = true; return true;
+	case block_kind::lte_expr: cmp = a <= b; is_cmp = true; return true;
+	case block_kind::gte_expr: cmp = a >= b; is_cmp = true; return true;
+	case block_kind::equals_expr: cmp = a == b; is_cmp = true; return true;
+	case block_kind::ne_expr: cmp = a != b; is_cmp = true; return true;
+	default:
+		return false;
+	}
+	return std::isfinite(r);
+}
+
+// The code generator prints 15 significant digits, a folded value that
+// needs more than that would change when the C code is compiled
+static bool prints_exactly(double v) {
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.15g", v);
+	return strtod(buffer, nullptr) == v;
+}
+
+static expr::Ptr make_int(long long value, expr::Ptr from) {
+	auto c = make_node<int_const>();
+	c->value = value;
+	c->static_offset = from->static_offset;
+	return c;
+}
+
+static bool is_const(expr::Ptr e) { return isa<int_const>(e) || isa<double_const>(e) || isa<float_const>(e); }
+
+static double const_value(expr::Ptr e) {
+	if (isa<int_const>(e))
+		return (double)to<int_const>(e)->value;
+	if (isa<float_const>(e))
+		return to<float_const>(e)->value;
+	return to<double_const>(e)->value;
+}
+
+static expr::Ptr fold_consts(binary_expr::Ptr a) {
+	expr::Ptr e1 = a->expr1;
+	expr::Ptr e2 = a->expr2;
+	long long cmp;
+	bool is_cmp;
+	if (isa<int_const>(e1) && isa<int_const>(e2)) {
+		long long r;
+		if (!fold_int(a->kind, to<int_const>(e1)->value, to<int_const>(e2)->value, r))
+			return nullptr;
+		return make_int(r, a);
+	}
+	if (isa<double_const>(e1) || isa<double_const>(e2)) {
+		double r;
+		if (!fold_floating<double>(a->kind, const_value(e1), const_value(e2), r, cmp, is_cmp))
+			return nullptr;
+		if (is_cmp)
+			return make_int(cmp, a);
+		if (!prints_exactly(r))
+			return nullptr;
+		auto c = make_node<double_const>();
+		c->value = r;
+		c->static_offset = a->static_offset;
+		return c;
+	}
+	// An int and a float are added as floats
+	float r;
+	if (!fold_floating<float>(a->kind, (float)const_value(e1), (float)const_value(e2), r, cmp, is_cmp))
+		return nullptr;
+	if (is_cmp)
+		return make_int(cmp, a);
+	auto c = make_node<float_const>();
+	c->value = r;
+	c->static_offset = a->static_offset;
+	return c;
+}
+
+static int power_of_two(long long v) {
+	if (v <= 0 || v > INT_MAX || (v & (v - 1)) != 0)
+		return -1;
+	int k = 0;
+	while ((1LL << k) != v)
+		k++;
+	return k;
+}
+
+template <typename T>
+static expr::Ptr make_binary(expr::Ptr e1, expr::Ptr e2, expr::Ptr from) {
+	auto b = make_node<T>();
+	b->expr1 = e1;
+	b->expr2 = e2;
+	b->static_offset = from->static_offset;
+	return b;
+}
+
+// (x + c1) + c2 and the like become x + (c1 + c2)
+static expr::Ptr fold_chain(binary_expr::Ptr a) {
+	if (!isa<plus_expr>(a) && !isa<minus_expr>(a))
+		return nullptr;
+	if (!isa<plus_expr>(a->expr1) && !isa<minus_expr>(a->expr1))
+		return nullptr;
+	binary_expr::Ptr inner = to<binary_expr>(a->expr1);
+	if (!isa<int_const>(inner->expr2) || classify_expr(inner->expr1) == int_class::none)
+		return nullptr;
+	long long c1 = to<int_const>(inner->expr2)->value;
+	long long c2 = to<int_const>(a->expr2)->value;
+	if (!fits_int(c1) || !fits_int(c2))
+		return nullptr;
+	long long sum = (isa<plus_expr>(inner) ? c1 : -c1) + (isa<plus_expr>(a) ? c2 : -c2);
+	if (!fits_int(sum) || !fits_int(-sum))
+		return nullptr;
+	if (sum == 0)
+		return inner->expr1;
+	if (sum > 0)
+		return make_binary<plus_expr>(inner->expr1, make_int(sum, a->expr2), a);
+	return make_binary<minus_expr>(inner->expr1, make_int(-sum, a->expr2), a);
+}
+
+// Rewrites of x op c and c op x for an integer x that don't change the
+// value or the type of the expr
+static expr::Ptr fold_identity(binary_expr::Ptr a) {
+	expr::Ptr x;
+	long long c;
+	bool const_on_right = isa<int_const>(a->expr2);
+	if (const_on_right) {
+		x = a->expr1;
+		c = to<int_const>(a->expr2)->value;
+	} else if (isa<int_const>(a->expr1)) {
+		x = a->expr2;
+		c = to<int_const>(a->expr1)->value;
+	} else {
+		return nullptr;
+	}
+	// The right side isn't evaluated if the left one decides the result,
+	// so it can be dropped whatever its type or side effects are
+	if (isa<and_expr>(a) && !const_on_right && c == 0)
+		return make_int(0, a);
+	if (isa<or_expr>(a) && !const_on_right && c != 0)
+		return make_int(1, a);
+
+	int_class xc = classify_expr(x);
+	if (xc == int_class::none)
+		return nullptr;
+
+	switch (a->kind) {
+	case block_kind::plus_expr:
+		if (c == 0)
+			return x;
+		break;
+	case block_kind::bitwise_or_expr:
+		if (c == 0)
+			return x;
+		break;
+	case block_kind::minus_expr:
+	case block_kind::lshift_expr:
+	case block_kind::rshift_expr:
+		if (const_on_right && c == 0)
+			return x;
+		break;
+	case block_kind::mul_expr:
+		if (c == 1)
+			return x;
+		// Shifting a negative number is undefined, so only unsigned values are shifted
+		if (xc == int_class::is_unsigned && power_of_two(c) > 0)
+			return make_binary<lshift_expr>(x, make_int(power_of_two(c), a), a);
+		break;
+	case block_kind::div_expr:
+		if (!const_on_right)
+			break;
+		if (c == 1)
+			return x;
+		if (xc == int_class::is_unsigned && power_of_two(c) > 0)
+			return make_binary<rshift_expr>(x, make_int(power_of_two(c), a), a);
+		break;
+	case block_kind::mod_expr:
+		if (const_on_right && xc == int_class::is_unsigned && power_of_two(c) > 0)
+			return make_binary<bitwise_and_expr>(x, make_int(c - 1, a), a);
+		break;
+	default:
+		break;
+	}
+	if (const_on_right)
+		return fold_chain(a);
+	return nullptr;
+}
+
+void const_folder::fold_binary(binary_expr::Ptr a) {
+	binary_helper(a);
+	expr::Ptr folded = nullptr;
+	if (is_const(a->expr1) && is_const(a->expr2))
+		folded = fold_consts(a);
+	else
+		folded = fold_identity(a);
+	if (folded != nullptr)
+		node = folded;
+}
+
+void const_folder::visit(not_expr::Ptr a) {
+	unary_helper(a);
+	if (is_const(a->expr1))
+		node = make_int(const_value(a->expr1) == 0, a);
+}
+void const_folder::visit(and_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(bitwise_and_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(or_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(bitwise_or_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(plus_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(minus_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(mul_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(div_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(lt_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(gt_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(lte_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(gte_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(lshift_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(rshift_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(equals_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(ne_expr::Ptr a) { fold_binary(a); }
+void const_folder::visit(mod_expr::Ptr a) { fold_binary(a); }
+
+void fold_constants(block::Ptr ast) {
+	const_folder folder;
+	ast->accept(&folder);
+}
+
+} // namespace block
@@ -0,0 +1,402 @@
+#include "blocks/cse.h"
+#include "blocks/block_visitor.h"
+#include "blocks/expr.h"
+#include "blocks/rce.h"
+#include "blocks/stmt.h"
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace block {
+
+static int scalar_id(type::Ptr t) { return to<scalar_type>(t)->scalar_type_id; }
+
+static type::Ptr make_scalar(int id) {
+	auto t = make_node<scalar_type>();
+	t->scalar_type_id = (decltype(t->scalar_type_id))id;
+	return t;
+}
+
+// Integer promotion followed by the rank and the signedness (LP64)
+static bool integer_rank(int id, int &rank, bool &is_unsigned) {
+	is_unsigned = false;
+	switch (id) {
+	case scalar_type::BOOL_TYPE:
+	case scalar_type::CHAR_TYPE:
+	case scalar_type::SIGNED_CHAR_TYPE:
+	case scalar_type::UNSIGNED_CHAR_TYPE:
+	case scalar_type::SHORT_INT_TYPE:
+	case scalar_type::UNSIGNED_SHORT_INT_TYPE:
+	case scalar_type::INT_TYPE: rank = 1; return true;
+	case scalar_type::UNSIGNED_INT_TYPE: rank = 1; is_unsigned = true; return true;
+	case scalar_type::LONG_INT_TYPE: rank = 2; return true;
+	case scalar_type::UNSIGNED_LONG_INT_TYPE: rank = 2; is_unsigned = true; return true;
+	case scalar_type::LONG_LONG_INT_TYPE: rank = 3; return true;
+	case scalar_type::UNSIGNED_LONG_LONG_INT_TYPE: rank = 3; is_unsigned = true; return true;
+	default: return false;
+	}
+}
+
+static int integer_id(int rank, bool is_unsigned) {
+	if (rank == 1)
+		return is_unsigned ? scalar_type::UNSIGNED_INT_TYPE : scalar_type::INT_TYPE;
+	if (rank == 2)
+		return is_unsigned ? scalar_type::UNSIGNED_LONG_INT_TYPE : scalar_type::LONG_INT_TYPE;
+	return is_unsigned ? scalar_type::UNSIGNED_LONG_LONG_INT_TYPE : scalar_type::LONG_LONG_INT_TYPE;
+}
+
+// The usual arithmetic conversions, -1 if either type isn't arithmetic
+static int arithmetic_result(type::Ptr t1, type::Ptr t2) {
+	if (!isa<scalar_type>(t1) || !isa<scalar_type>(t2))
+		return -1;
+	int id1 = scalar_id(t1), id2 = scalar_id(t2);
+	if (id1 == scalar_type::VOID_TYPE || id2 == scalar_type::VOID_TYPE)
+		return -1;
+	if (id1 == scalar_type::DOUBLE_TYPE || id2 == scalar_type::DOUBLE_TYPE)
+		return scalar_type::DOUBLE_TYPE;
+	if (id1 == scalar_type::FLOAT_TYPE || id2 == scalar_type::FLOAT_TYPE)
+		return scalar_type::FLOAT_TYPE;
+	int r1, r2;
+	bool u1, u2;
+	if (!integer_rank(id1, r1, u1) || !integer_rank(id2, r2, u2))
+		return -1;
+	if (u1 == u2)
+		return integer_id(std::max(r1, r2), u1);
+	int ru = u1 ? r1 : r2, rs = u1 ? r2 : r1;
+	if (ru >= rs)
+		return integer_id(ru, true);
+	// A wider signed type holds all the values of the unsigned one, long and
+	// long long have the same width
+	if (ru == 1)
+		return integer_id(rs, false);
+	return integer_id(rs, true);
+}
+
+type::Ptr expr_type(expr::Ptr e) {
+	if (isa<var_expr>(e))
+		return to<var_expr>(e)->var1->var_type;
+	if (isa<int_const>(e))
+		return make_scalar(scalar_type::INT_TYPE);
+	if (isa<double_const>(e))
+		return make_scalar(scalar_type::DOUBLE_TYPE);
+	if (isa<float_const>(e))
+		return make_scalar(scalar_type::FLOAT_TYPE);
+	if (isa<not_expr>(e))
+		return make_scalar(scalar_type::INT_TYPE);
+	if (isa<sq_bkt_expr>(e)) {
+		type::Ptr t = expr_type(to<sq_bkt_expr>(e)->var_expr);
+		if (isa<pointer_type>(t))
+			return to<pointer_type>(t)->pointee_type;
+		if (isa<array_type>(t))
+			return to<array_type>(t)->element_type;
+		return nullptr;
+	}
+	if (!isa<binary_expr>(e))
+		return nullptr;
+	binary_expr::Ptr b = to<binary_expr>(e);
+	type::Ptr t1 = expr_type(b->expr1);
+	type::Ptr t2 = expr_type(b->expr2);
+	if (t1 == nullptr || t2 == nullptr)
+		return nullptr;
+	int id = arithmetic_result(t1, t2);
+	if (id == -1)
+		return nullptr;
+	switch (b->kind) {
+	case block_kind::and_expr:
+	case block_kind::or_expr:
+	case block_kind::lt_expr:
+	case block_kind::gt_expr:
+	case block_kind::lte_expr:
+	case block_kind::gte_expr:
+	case block_kind::equals_expr:
+	case block_kind::ne_expr:
+		return make_scalar(scalar_type::INT_TYPE);
+	case block_kind::lshift_expr:
+	case block_kind::rshift_expr:
+		// The type of the promoted left operand
+		return make_scalar(arithmetic_result(t1, make_scalar(scalar_type::INT_TYPE)));
+	default:
+		return make_scalar(id);
+	}
+}
+
+bool same_expr(expr::Ptr a, expr::Ptr b) {
+	if (a->kind != b->kind)
+		return false;
+	switch (a->kind) {
+	case block_kind::var_expr: return to<var_expr>(a)->var1 == to<var_expr>(b)->var1;
+	case block_kind::int_const: return to<int_const>(a)->value == to<int_const>(b)->value;
+	case block_kind::double_const: return to<double_const>(a)->value == to<double_const>(b)->value;
+	case block_kind::float_const: return to<float_const>(a)->value == to<float_const>(b)->value;
+	case block_kind::not_expr: return same_expr(to<not_expr>(a)->expr1, to<not_expr>(b)->expr1);
+	case block_kind::sq_bkt_expr:
+		return same_expr(to<sq_bkt_expr>(a)->var_expr, to<sq_bkt_expr>(b)->var_expr) &&
+		       same_expr(to<sq_bkt_expr>(a)->index, to<sq_bkt_expr>(b)->index);
+	default:
+		break;
+	}
+	if (!isa<binary_expr>(a))
+		return false;
+	return same_expr(to<binary_expr>(a)->expr1, to<binary_expr>(b)->expr1) &&
+	       same_expr(to<binary_expr>(a)->expr2, to<binary_expr>(b)->expr2);
+}
+
+size_t hash_expr(expr::Ptr e) {
+	size_t h = (size_t)e->kind * 0x9e3779b97f4a7c15ULL;
+	if (isa<var_expr>(e))
+		return h ^ std::hash<var *>()(to<var_expr>(e)->var1.get());
+	if (isa<int_const>(e))
+		return h ^ std::hash<long long>()(to<int_const>(e)->value);
+	if (isa<double_const>(e))
+		return h ^ std::hash<double>()(to<double_const>(e)->value);
+	if (isa<float_const>(e))
+		return h ^ std::hash<float>()(to<float_const>(e)->value);
+	if (isa<not_expr>(e))
+		return h ^ (hash_expr(to<not_expr>(e)->expr1) * 31);
+	if (isa<sq_bkt_expr>(e))
+		return h ^ (hash_expr(to<sq_bkt_expr>(e)->var_expr) * 31 + hash_expr(to<sq_bkt_expr>(e)->index));
+	if (isa<binary_expr>(e))
+		return h ^ (hash_expr(to<binary_expr>(e)->expr1) * 31 + hash_expr(to<binary_expr>(e)->expr2));
+	return h;
+}
+
+// Only the exprs same_expr knows about can be part of a reused expr
+static bool is_reusable(expr::Ptr e) {
+	if (isa<var_expr>(e) || isa<int_const>(e) || isa<double_const>(e) || isa<float_const>(e))
+		return true;
+	if (isa<not_expr>(e))
+		return is_reusable(to<not_expr>(e)->expr1);
+	if (isa<sq_bkt_expr>(e))
+		return is_reusable(to<sq_bkt_expr>(e)->var_expr) && is_reusable(to<sq_bkt_expr>(e)->index);
+	if (isa<binary_expr>(e))
+		return is_reusable(to<binary_expr>(e)->expr1) && is_reusable(to<binary_expr>(e)->expr2);
+	return false;
+}
+
+class cse_group {
+public:
+	// The first occurrence, the temporary is declared before the statement it is in
+	expr::Ptr *first;
+	size_t stmt_index;
+	std::vector<expr::Ptr *> uses;
+	type::Ptr expr_type;
+	std::unordered_set<var *> vars_read;
+	bool reads_memory = false;
+	bool available = true;
+};
+
+class cse_finder : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::unordered_set<var *> address_taken;
+	shared_stmt_finder *shared = nullptr;
+	int temp_counter = 0;
+
+	virtual void visit(stmt_block::Ptr) override;
+
+private:
+	std::vector<std::unique_ptr<cse_group>> groups;
+	std::unordered_map<size_t, std::vector<cse_group *>> available;
+	size_t current_stmt;
+	std::unordered_set<stmt_block *> visited_blocks;
+
+	void find_reads(expr::Ptr e, cse_group *g);
+	void collect(expr::Ptr &slot, bool conditional);
+	void kill_all(void);
+	void kill_writes_to(expr::Ptr lhs);
+	bool is_pure(expr::Ptr e);
+};
+
+void cse_finder::find_reads(expr::Ptr e, cse_group *g) {
+	if (isa<var_expr>(e)) {
+		var *v = to<var_expr>(e)->var1.get();
+		g->vars_read.insert(v);
+		if (address_taken.count(v) || isa<array_type>(v->var_type))
+			g->reads_memory = true;
+	} else if (isa<not_expr>(e)) {
+		find_reads(to<not_expr>(e)->expr1, g);
+	} else if (isa<sq_bkt_expr>(e)) {
+		g->reads_memory = true;
+		find_reads(to<sq_bkt_expr>(e)->var_expr, g);
+		find_reads(to<sq_bkt_expr>(e)->index, g);
+	} else if (isa<binary_expr>(e)) {
+		find_reads(to<binary_expr>(e)->expr1, g);
+		find_reads(to<binary_expr>(e)->expr2, g);
+	}
+}
+
+// Exprs on the right of && and || are conditionally evaluated. They can
+// reuse a temporary, but computing one for them before the statement
+// could fault (like p != 0 && p[0])
+void cse_finder::collect(expr::Ptr &slot, bool conditional) {
+	expr::Ptr e = slot;
+	bool candidate = (isa<binary_expr>(e) || isa<not_expr>(e) || isa<sq_bkt_expr>(e)) && is_reusable(e);
+	type::Ptr t = nullptr;
+	if (candidate) {
+		t = expr_type(e);
+		if (!isa<scalar_type>(t) && !isa<pointer_type>(t))
+			candidate = false;
+	}
+	size_t h = 0;
+	if (candidate) {
+		h = hash_expr(e);
+		auto it = available.find(h);
+		if (it != available.end()) {
+			for (auto g : it->second) {
+				if (g->available && same_expr(*g->first, e)) {
+					g->uses.push_back(&slot);
+					return;
+				}
+			}
+		}
+	}
+
+	if (isa<binary_expr>(e)) {
+		binary_expr::Ptr b = to<binary_expr>(e);
+		collect(b->expr1, conditional);
+		collect(b->expr2, conditional || isa<and_expr>(b) || isa<or_expr>(b));
+	} else if (isa<not_expr>(e)) {
+		collect(to<not_expr>(e)->expr1, conditional);
+	} else if (isa<sq_bkt_expr>(e)) {
+		collect(to<sq_bkt_expr>(e)->var_expr, conditional);
+		collect(to<sq_bkt_expr>(e)->index, conditional);
+	} else if (isa<member_access_expr>(e)) {
+		collect(to<member_access_expr>(e)->parent_expr, conditional);
+	}
+
+	if (!candidate || conditional)
+		return;
+	std::unique_ptr<cse_group> g(new cse_group());
+	g->first = &slot;
+	g->stmt_index = current_stmt;
+	g->expr_type = t;
+	find_reads(e, g.get());
+	available[h].push_back(g.get());
+	groups.push_back(std::move(g));
+}
+
+void cse_finder::kill_all(void) {
+	for (auto &g : groups)
+		g->available = false;
+	available.clear();
+}
+
+void cse_finder::kill_writes_to(expr::Ptr lhs) {
+	bool writes_memory = true;
+	var *written = nullptr;
+	if (isa<var_expr>(lhs)) {
+		written = to<var_expr>(lhs)->var1.get();
+		writes_memory = address_taken.count(written) != 0;
+	}
+	for (auto &g : groups) {
+		if ((writes_memory && g->reads_memory) || (written != nullptr && g->vars_read.count(written)))
+			g->available = false;
+	}
+}
+
+bool cse_finder::is_pure(expr::Ptr e) {
+	check_side_effects checker;
+	e->accept(&checker);
+	return !checker.has_side_effects;
+}
+
+void cse_finder::visit(stmt_block::Ptr b) {
+	// A block inside a shared statement is reached more than once
+	if (!visited_blocks.insert(b.get()).second)
+		return;
+	groups.clear();
+	available.clear();
+	for (current_stmt = 0; current_stmt < b->stmts.size(); current_stmt++) {
+		stmt::Ptr s = b->stmts[current_stmt];
+		// The temporary would only be declared in one of the blocks with the statement
+		if (shared->is_shared(s)) {
+			kill_all();
+			continue;
+		}
+		if (isa<decl_stmt>(s)) {
+			decl_stmt::Ptr d = to<decl_stmt>(s);
+			if (d->init_expr == nullptr)
+				continue;
+			if (is_pure(d->init_expr))
+				collect(d->init_expr, false);
+			else
+				kill_all();
+			continue;
+		}
+		if (isa<expr_stmt>(s)) {
+			expr_stmt::Ptr es = to<expr_stmt>(s);
+			if (isa<assign_expr>(es->expr1)) {
+				assign_expr::Ptr a = to<assign_expr>(es->expr1);
+				if (is_pure(a->var1) && is_pure(a->expr1)) {
+					// The target itself isn't read, only the index of a store is
+					if (isa<sq_bkt_expr>(a->var1)) {
+						collect(to<sq_bkt_expr>(a->var1)->var_expr, false);
+						collect(to<sq_bkt_expr>(a->var1)->index, false);
+					}
+					collect(a->expr1, false);
+					kill_writes_to(a->var1);
+					continue;
+				}
+			} else if (is_pure(es->expr1)) {
+				collect(es->expr1, false);
+				continue;
+			}
+		}
+		// Control flow, labels and statements with other side effects
+		kill_all();
+	}
+
+	std::vector<std::vector<decl_stmt::Ptr>> temps(b->stmts.size());
+	for (auto &g : groups) {
+		if (g->uses.empty())
+			continue;
+		var::Ptr v = make_node<var>();
+		v->var_name = "cse_var_" + std::to_string(temp_counter++);
+		v->var_type = g->expr_type;
+		decl_stmt::Ptr decl = make_node<decl_stmt>();
+		decl->decl_var = v;
+		decl->init_expr = *g->first;
+		decl->static_offset = (*g->first)->static_offset;
+		temps[g->stmt_index].push_back(decl);
+
+		for (auto slot : g->uses) {
+			var_expr::Ptr ve = make_node<var_expr>();
+			ve->var1 = v;
+			ve->static_offset = (*slot)->static_offset;
+			*slot = ve;
+		}
+		var_expr::Ptr ve = make_node<var_expr>();
+		ve->var1 = v;
+		ve->static_offset = decl->static_offset;
+		*g->first = ve;
+	}
+	groups.clear();
+	available.clear();
+
+	std::vector<stmt::Ptr> new_stmts;
+	for (unsigned int i = 0; i < b->stmts.size(); i++) {
+		for (auto &decl : temps[i])
+			new_stmts.push_back(decl);
+		new_stmts.push_back(b->stmts[i]);
+	}
+	b->stmts = new_stmts;
+
+	// Nested blocks start over
+	for (auto s : b->stmts)
+		s->accept(this);
+}
+
+void eliminate_common_subexprs(block::Ptr ast) {
+	address_taken_finder finder;
+	ast->accept(&finder);
+	shared_stmt_finder shared;
+	ast->accept(&shared);
+	cse_finder cse;
+	cse.address_taken = finder.vars;
+	cse.shared = &shared;
+	ast->accept(&cse);
+}
+
+} // namespace block
@@ -0,0 +1,59 @@
+#include "blocks/dataflow.h"
+#include "blocks/block_visitor.h"
+
+namespace block {
+
+class def_use_finder : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::vector<var *> &defs;
+	std::vector<var *> &uses;
+	def_use_finder(std::vector<var *> &d, std::vector<var *> &u) : defs(d), uses(u) {}
+
+	virtual void visit(var_expr::Ptr e) override { uses.push_back(e->var1.get()); }
+	virtual void visit(assign_expr::Ptr e) override {
+		e->expr1->accept(this);
+		// Storing to a var doesn't read it, a store through a pointer or an index does
+		if (isa<var_expr>(e->var1))
+			defs.push_back(to<var_expr>(e->var1)->var1.get());
+		else
+			e->var1->accept(this);
+	}
+	virtual void visit(decl_stmt::Ptr s) override {
+		if (s->init_expr != nullptr)
+			s->init_expr->accept(this);
+		defs.push_back(s->decl_var.get());
+	}
+};
+
+void find_defs_and_uses(block::Ptr node, std::vector<var *> &defs, std::vector<var *> &uses) {
+	def_use_finder finder(defs, uses);
+	node->accept(&finder);
+}
+
+var_set liveness_problem::meet(const var_set &a, const var_set &b) {
+	var_set ret = a;
+	ret.insert(b.begin(), b.end());
+	return ret;
+}
+
+var_set liveness_problem::transfer(basic_block *bb, const var_set &live_out) {
+	var_set live = live_out;
+	std::vector<var *> defs, uses;
+	for (auto it = bb->nodes.rbegin(); it != bb->nodes.rend(); it++) {
+		defs.clear();
+		uses.clear();
+		find_defs_and_uses(*it, defs, uses);
+		for (auto v : defs)
+			live.erase(v);
+		live.insert(uses.begin(), uses.end());
+	}
+	return live;
+}
+
+dataflow_result<var_set> compute_liveness(control_flow_graph &cfg) {
+	liveness_problem problem;
+	return solve_dataflow(cfg, problem);
+}
+
+} // namespace block
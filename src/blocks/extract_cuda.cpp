@@ -4,7 +4,7 @@
 #include "blocks/c_code_generator.h"
 
 namespace block {
-// Unique counter to name generated kernels
+// Unique counter to name generated kernels for the calls that don't pass one
 int total_created_kernels = 0;
 
 // Local utility visitor to find the statement block 
@@ -51,6 +51,10 @@ static std::vector<var::Ptr> extract_extern_vars(block::Ptr function, stmt::Ptr
 
 static void var_replace_all(stmt::Ptr body, var::Ptr from, var::Ptr to);
 block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr> &new_decls) {
+	return extract_single_cuda(from, new_decls, total_created_kernels);
+}
+
+block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr> &new_decls, int &kernel_counter) {
 	if (!isa<stmt_block>(from)) {
 		std::cerr << "extract_single_cuda() expects a stmt_block" << std::endl;
 		return nullptr;
@@ -89,8 +93,7 @@ block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr> &new
 	}
 	std::vector<var::Ptr> vars = extract_extern_vars(from, inner_loop->body, outer_var, inner_var);
 
-	int this_kern_index = total_created_kernels;
-	total_created_kernels++;
+	int this_kern_index = kernel_counter++;
 	std::vector<var::Ptr> ret_vars;
 	if (is_coop) {
 		// If this is coop, we will create some extra decls to return the copied values
@@ -100,18 +103,18 @@ block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr> &new
 			c_code_generator::generate_code(v->var_type, type_str, 0);
 			std::string type_string = type_str.str();
 			type_string.pop_back();	
-			auto v_new = std::make_shared<var>();
+			auto v_new = make_node<var>();
 			v_new->var_type = builder::dyn_var<char>::create_block_type();	
 			//v_new->var_type = v->var_type;
 			v_new->var_name = "ret_" + std::to_string(this_kern_index) + "_" + std::to_string(i) + "[sizeof(" + type_string +")]";
-			auto v_new_ret = std::make_shared<var>();
+			auto v_new_ret = make_node<var>();
 			v_new_ret->var_type = builder::dyn_var<char>::create_block_type();	
 			v_new_ret->var_name = "ret_" + std::to_string(this_kern_index) + "_" + std::to_string(i);
 			ret_vars.push_back(v_new_ret);
 			i++;
 			v_new->setMetadata<std::vector<std::string>>("attributes", {"__device__"});
 
-			auto decl_new = std::make_shared<decl_stmt>();
+			auto decl_new = make_node<decl_stmt>();
 			decl_new->decl_var = v_new;
 			decl_new->init_expr = nullptr;
 			new_decls.push_back(decl_new);	
@@ -125,25 +128,25 @@ block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr> &new
 	expr::Ptr thread_count = to<lt_expr>(inner_loop->cond)->expr2;
 	
 	
-	var::Ptr cta_id = std::make_shared<var>();
+	var::Ptr cta_id = make_node<var>();
 	cta_id->var_name = "blockIdx.x";
 	cta_id->var_type = builder::dyn_var<int>::create_block_type();
 	
-	var::Ptr thread_id = std::make_shared<var>();
+	var::Ptr thread_id = make_node<var>();
 	thread_id->var_name = "threadIdx.x";
 	thread_id->var_type = builder::dyn_var<int>::create_block_type();
 	
 	var_replace_all(inner_loop->body, outer_var, cta_id);
 	var_replace_all(inner_loop->body, inner_var, thread_id);
 
-	func_decl::Ptr kernel = std::make_shared<func_decl>();
+	func_decl::Ptr kernel = make_node<func_decl>();
 	kernel->func_name = "cuda_kernel_" + std::to_string(this_kern_index);
 
 	kernel->return_type = builder::dyn_var<void>::create_block_type();
 	
 
-	function_call_expr::Ptr call = std::make_shared<function_call_expr>();
-	var::Ptr call_name = std::make_shared<var>();
+	function_call_expr::Ptr call = make_node<function_call_expr>();
+	var::Ptr call_name = make_node<var>();
 	if (!is_coop) {
 		call_name->var_type = builder::dyn_var<int>::create_block_type();
 		call_name->var_name = kernel->func_name;
@@ -163,8 +166,8 @@ block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr> &new
 	} else {
 		call_name->var_type = builder::dyn_var<int>::create_block_type();
 		call_name->var_name = "runtime::LaunchCooperativeKernel";
-		var_expr::Ptr param1 = std::make_shared<var_expr>();
-		var::Ptr param1_var = std::make_shared<var>();
+		var_expr::Ptr param1 = make_node<var_expr>();
+		var::Ptr param1_var = make_node<var>();
 		param1_var->var_type = builder::dyn_var<int>::create_block_type();
 		param1_var->var_name = "(void*)" + kernel->func_name;
 		param1->var1 = param1_var;
@@ -172,34 +175,34 @@ block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr> &new
 		call->args.push_back(cta_count);
 		call->args.push_back(thread_count);
 	}
-	var_expr::Ptr call_var_expr = std::make_shared<var_expr>();
+	var_expr::Ptr call_var_expr = make_node<var_expr>();
 	call_var_expr->var1 = call_name;
 	call->expr1 = call_var_expr;
-	expr_stmt::Ptr call_stmt = std::make_shared<expr_stmt>();
+	expr_stmt::Ptr call_stmt = make_node<expr_stmt>();
 	call_stmt->expr1 = call;
 
-	function_call_expr::Ptr call_sync = std::make_shared<function_call_expr>();
-	var::Ptr call_name_sync = std::make_shared<var>();
+	function_call_expr::Ptr call_sync = make_node<function_call_expr>();
+	var::Ptr call_name_sync = make_node<var>();
 	call_name_sync->var_type = builder::dyn_var<int>::create_block_type();
 	call_name_sync->var_name = "cudaDeviceSynchronize";
-	var_expr::Ptr call_var_expr_sync = std::make_shared<var_expr>();
+	var_expr::Ptr call_var_expr_sync = make_node<var_expr>();
 	call_var_expr_sync->var1 = call_name_sync;
 	call_sync->expr1 = call_var_expr_sync;
-	expr_stmt::Ptr call_stmt_sync = std::make_shared<expr_stmt>();
+	expr_stmt::Ptr call_stmt_sync = make_node<expr_stmt>();
 	call_stmt_sync->expr1 = call_sync;
 
 	for (unsigned int i = 0; i < vars.size(); i++) {
 		std::string arg_name = "arg" + std::to_string(i);	
-		var::Ptr arg = std::make_shared<var>();
+		var::Ptr arg = make_node<var>();
 		arg->var_name = arg_name;
 		arg->var_type = vars[i]->var_type;
 		var_replace_all(inner_loop->body, vars[i], arg);		
 		kernel->args.push_back(arg);
-		var_expr::Ptr arg_expr = std::make_shared<var_expr>();
+		var_expr::Ptr arg_expr = make_node<var_expr>();
 		arg_expr->var1 = vars[i];
 		call->args.push_back(arg_expr);
 	}
-	stmt_block::Ptr new_stmts = std::make_shared<stmt_block>();
+	stmt_block::Ptr new_stmts = make_node<stmt_block>();
 	
 	//block::stmt_block::Ptr old_stmts = to<block::stmt_block>(from);	
 	parent_finder finder;
@@ -212,53 +215,53 @@ block::Ptr extract_single_cuda(block::Ptr from, std::vector<decl_stmt::Ptr> &new
 	// If this is a coop kernel, return the values
 	std::vector<stmt::Ptr> copy_backs;
 	if (is_coop) {
-		auto if_s = std::make_shared<if_stmt>();
-		auto nvar = std::make_shared<var>();
+		auto if_s = make_node<if_stmt>();
+		auto nvar = make_node<var>();
 		nvar->var_type = builder::dyn_var<int>::create_block_type();
 		nvar->var_name = "!(blockIdx.x * blockDim.x + threadIdx.x)";
-		auto nvar_expr = std::make_shared<var_expr>();
+		auto nvar_expr = make_node<var_expr>();
 		nvar_expr->var1 = nvar;
 		if_s->cond = nvar_expr;
-		if_s->then_stmt = std::make_shared<stmt_block>();
-		if_s->else_stmt = std::make_shared<stmt_block>();
+		if_s->then_stmt = make_node<stmt_block>();
+		if_s->else_stmt = make_node<stmt_block>();
 		// Add an assignment for each variable
 		int i = 0;
-		auto v_copy = std::make_shared<var>();
+		auto v_copy = make_node<var>();
 		v_copy->var_type = builder::dyn_var<void(void)>::create_block_type();
 		v_copy->var_name = "runtime::cudaMemcpyFromSymbolMagic";
-		auto v_copy_expr = std::make_shared<var_expr>();
+		auto v_copy_expr = make_node<var_expr>();
 		v_copy_expr->var1 = v_copy;
 	
-		auto m_copy = std::make_shared<var>();
+		auto m_copy = make_node<var>();
 		m_copy->var_type = builder::dyn_var<void(void)>::create_block_type();
 		m_copy->var_name = "runtime::cudaMemcpyToSymbolMagic";
-		auto m_copy_expr = std::make_shared<var_expr>();
+		auto m_copy_expr = make_node<var_expr>();
 		m_copy_expr->var1 = m_copy;
 		
 
 		for (auto v: kernel->args) {
-			auto rhs = std::make_shared<var_expr>();
+			auto rhs = make_node<var_expr>();
 			rhs->var1 = v;
-			auto lhs = std::make_shared<var_expr>();
+			auto lhs = make_node<var_expr>();
 			lhs->var1 = ret_vars[i];
-			auto f2 = std::make_shared<function_call_expr>();
+			auto f2 = make_node<function_call_expr>();
 			f2->expr1 = m_copy_expr;
 			f2->args.push_back(lhs);
 			f2->args.push_back(rhs);
 
-			auto nexpr_stmt = std::make_shared<expr_stmt>();
+			auto nexpr_stmt = make_node<expr_stmt>();
 			nexpr_stmt->expr1 = f2;
 			to<stmt_block>(if_s->then_stmt)->stmts.push_back(nexpr_stmt);
 
 			// Also create a copy back
-			auto f = std::make_shared<function_call_expr>();
+			auto f = make_node<function_call_expr>();
 			f->expr1 = v_copy_expr;
-			auto addr = std::make_shared<addr_of_expr>();
+			auto addr = make_node<addr_of_expr>();
 			addr->expr1 = call->args[i+3];
 			f->args.push_back(addr);
 			f->args.push_back(lhs);
 			
-			auto stmt = std::make_shared<expr_stmt>();
+			auto stmt = make_node<expr_stmt>();
 			stmt->expr1 = f;
 			copy_backs.push_back(stmt);
 
@@ -324,11 +327,13 @@ void gather_extern_vars::visit(var_expr::Ptr expr) {
 		gathered.push_back(var1);
 }
 
-std::vector<block::Ptr> extract_cuda_from(block::Ptr from) {
+std::vector<block::Ptr> extract_cuda_from(block::Ptr from) { return extract_cuda_from(from, total_created_kernels); }
+
+std::vector<block::Ptr> extract_cuda_from(block::Ptr from, int &kernel_counter) {
 	std::vector<block::Ptr> new_decls;
 	block::Ptr kernel = nullptr;
 	std::vector<decl_stmt::Ptr> new_var_decls;
-	while ((kernel = extract_single_cuda(from, new_var_decls))) {
+	while ((kernel = extract_single_cuda(from, new_var_decls, kernel_counter))) {
 		for (auto a: new_var_decls)
 			new_decls.push_back(a);	
 		new_var_decls.clear();	
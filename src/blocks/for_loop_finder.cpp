@@ -1,34 +1,59 @@
 #include "blocks/for_loop_finder.h"
+#include "blocks/cse.h"
+#include "blocks/loop_finder.h"
 
 namespace block {
 
+static bool is_var(var::Ptr v, expr::Ptr e) { return isa<var_expr>(e) && to<var_expr>(e)->var1 == v; }
+
+// Updates that step the var by a fixed amount, v = v + e, v = e + v and
+// v = v - e. Multiplying and shifting updates stay while loops, OpenMP and
+// vectorizers expect a for loop to be a counted loop
 static bool is_update_expr(var::Ptr decl_var, expr::Ptr last_stmt_expr) {
 
-	if (isa<minus_expr>(last_stmt_expr)) {
-		// This is to allow statements like (a = a + 1) - 1;	
-		minus_expr::Ptr mexpr = to<minus_expr>(last_stmt_expr);
-		return is_update_expr(decl_var, mexpr->expr1);
+	if (isa<minus_expr>(last_stmt_expr) || isa<plus_expr>(last_stmt_expr)) {
+		// This is to allow statements like (a = a + 1) - 1 and (a = a - 1) + 1
+		binary_expr::Ptr bexpr = to<binary_expr>(last_stmt_expr);
+		return is_update_expr(decl_var, bexpr->expr1);
 	}
 
 	if (!isa<assign_expr>(last_stmt_expr))
 		return false;
 	assign_expr::Ptr update_expr = to<assign_expr>(last_stmt_expr);
-	if (!isa<var_expr>(update_expr->var1))
-		return false;
-	var_expr::Ptr lhs_expr = to<var_expr>(update_expr->var1);
-	if (decl_var != lhs_expr->var1)
-		return false;
-	if (!isa<plus_expr>(update_expr->expr1))
-		return false;
-	plus_expr::Ptr rhs_expr = to<plus_expr>(update_expr->expr1);
-	if (!isa<var_expr>(rhs_expr->expr1))
-		return false;
-	lhs_expr = to<var_expr>(rhs_expr->expr1);
-	if (decl_var != lhs_expr->var1)
+	if (!is_var(decl_var, update_expr->var1))
 		return false;
-	return true;
+	expr::Ptr rhs_expr = update_expr->expr1;
+	if (isa<plus_expr>(rhs_expr) && is_var(decl_var, to<binary_expr>(rhs_expr)->expr2))
+		return true;
+	if (isa<plus_expr>(rhs_expr) || isa<minus_expr>(rhs_expr))
+		return is_var(decl_var, to<binary_expr>(rhs_expr)->expr1);
+	return false;
+}
+
+// The value of the update is discarded, so the postfix forms are printed as
+// the assignment alone
+static expr::Ptr strip_postfix(expr::Ptr update) {
+	while ((isa<plus_expr>(update) || isa<minus_expr>(update)) && isa<assign_expr>(to<binary_expr>(update)->expr1))
+		update = to<binary_expr>(update)->expr1;
+	return update;
 }
 
+// A comparison of the var on either side, or a conjunction with one
+static bool is_loop_cond(var::Ptr decl_var, expr::Ptr cond) {
+	switch (cond->kind) {
+	case block_kind::lt_expr:
+	case block_kind::gt_expr:
+	case block_kind::lte_expr:
+	case block_kind::gte_expr:
+	case block_kind::ne_expr:
+		return is_var(decl_var, to<binary_expr>(cond)->expr1) || is_var(decl_var, to<binary_expr>(cond)->expr2);
+	case block_kind::and_expr:
+		return is_loop_cond(decl_var, to<and_expr>(cond)->expr1) ||
+		       is_loop_cond(decl_var, to<and_expr>(cond)->expr2);
+	default:
+		return false;
+	}
+}
 
 static bool is_update(var::Ptr decl_var, stmt::Ptr last_stmt) {
 	if (!isa<expr_stmt>(last_stmt))
@@ -81,7 +106,50 @@ static bool has_further_uses(decl_stmt::Ptr decl, std::vector<stmt::Ptr> stmts,
 	}
 	return false;
 }
+// A loop the compiler rotated is extracted as
+// if (c) { while (1) { ...; if (c) {} else break; } }, which is while (c) { ... }
+// as long as nothing continues to the top of the loop past the check.
+// Returns the while loop rewritten like that, null for other stmts
+static while_stmt::Ptr unrotate_loop(stmt::Ptr s) {
+	if (!isa<if_stmt>(s))
+		return nullptr;
+	if_stmt::Ptr guard = to<if_stmt>(s);
+	if (!isa<stmt_block>(guard->then_stmt) || !isa<stmt_block>(guard->else_stmt) ||
+	    !to<stmt_block>(guard->else_stmt)->stmts.empty())
+		return nullptr;
+	std::vector<stmt::Ptr> &then_stmts = to<stmt_block>(guard->then_stmt)->stmts;
+	if (then_stmts.size() != 1 || !isa<while_stmt>(then_stmts[0]))
+		return nullptr;
+	while_stmt::Ptr loop = to<while_stmt>(then_stmts[0]);
+	if (!isa<int_const>(loop->cond) || to<int_const>(loop->cond)->value == 0 || !isa<stmt_block>(loop->body))
+		return nullptr;
+	continue_finder continues;
+	loop->body->accept(&continues);
+	if (continues.has_continue)
+		return nullptr;
+	std::vector<stmt::Ptr> &body = to<stmt_block>(loop->body)->stmts;
+	if (body.empty() || !isa<if_stmt>(body.back()))
+		return nullptr;
+	// The ifs haven't been switched yet, so the check is if (c) {} else { break; }
+	if_stmt::Ptr check = to<if_stmt>(body.back());
+	if (!same_expr(check->cond, guard->cond))
+		return nullptr;
+	if (!isa<stmt_block>(check->then_stmt) || !to<stmt_block>(check->then_stmt)->stmts.empty())
+		return nullptr;
+	if (!isa<stmt_block>(check->else_stmt) || to<stmt_block>(check->else_stmt)->stmts.size() != 1 ||
+	    !isa<break_stmt>(to<stmt_block>(check->else_stmt)->stmts[0]))
+		return nullptr;
+	body.pop_back();
+	loop->cond = guard->cond;
+	return loop;
+}
+
 void for_loop_finder::visit(stmt_block::Ptr a) {
+	for (unsigned int i = 0; i < a->stmts.size(); i++) {
+		while_stmt::Ptr loop = unrotate_loop(a->stmts[i]);
+		if (loop != nullptr)
+			a->stmts[i] = loop;
+	}
 	while (1) {
 		int while_loop_index = -1;
 		std::vector<stmt_block::Ptr> parents;
@@ -109,14 +177,7 @@ void for_loop_finder::visit(stmt_block::Ptr a) {
 					init_var = to<var_expr>(assign->var1)->var1;
 				}
 
-				if (!isa<lt_expr>(loop->cond))
-					continue;
-				lt_expr::Ptr cond_expr = to<lt_expr>(loop->cond);
-				if (!isa<var_expr>(cond_expr->expr1))
-					continue;
-				var_expr::Ptr lhs_expr = to<var_expr>(cond_expr->expr1);
-
-				if (init_var != lhs_expr->var1)
+				if (!is_loop_cond(init_var, loop->cond))
 					continue;
 				if (!isa<stmt_block>(loop->body))
 					continue;
@@ -149,16 +210,16 @@ void for_loop_finder::visit(stmt_block::Ptr a) {
 			std::vector<stmt::Ptr> new_stmts;
 			for (int i = 0; i < while_loop_index; i++)
 				new_stmts.push_back(a->stmts[i]);
-			for_stmt::Ptr for_loop = std::make_shared<for_stmt>();
+			for_stmt::Ptr for_loop = make_node<for_stmt>();
 			for_loop->static_offset =
 			    a->stmts[while_loop_index]->static_offset;
 			// Before we merge the decl with the for loop, make sure 
 			// the variable being declared doesn't have any other uses
 			auto decl = a->stmts[while_loop_index];
 			if (isa<decl_stmt>(decl) && has_further_uses(to<decl_stmt>(decl), a->stmts, while_loop_index+2)) {
-				auto ce = std::make_shared<int_const>();
+				auto ce = make_node<int_const>();
 				ce->value = 0;
-				auto es = std::make_shared<expr_stmt>();
+				auto es = make_node<expr_stmt>();
 				es->expr1 = ce;
 				for_loop->decl_stmt = es;
 				// Keep the decl in the new stmts
@@ -188,11 +249,12 @@ void for_loop_finder::visit(stmt_block::Ptr a) {
 			}
 			// Even after this if the update is empty, just put an empty expression there
 			if (for_loop->update == nullptr) {	
-				auto ce = std::make_shared<int_const>();
+				auto ce = make_node<int_const>();
 				ce->value = 0;
 				for_loop->update = ce;
 			}
 
+			for_loop->update = strip_postfix(for_loop->update);
 			for_loop->body = loop->body;
 			new_stmts.push_back(for_loop);
 			for (unsigned int i = while_loop_index + 2;
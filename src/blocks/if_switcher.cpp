@@ -8,7 +8,7 @@ void if_switcher::visit(if_stmt::Ptr ifs) {
 		if (then_block->stmts.size() == 0) {
 			ifs->then_stmt = ifs->else_stmt;
 			ifs->else_stmt = then_block;
-			auto ne = std::make_shared<not_expr>();
+			auto ne = make_node<not_expr>();
 			ne->expr1 = ifs->cond;
 			ifs->cond = ne;
 		}
@@ -20,7 +20,7 @@ void label_creator::visit(stmt_block::Ptr a) {
 	for (stmt::Ptr stmt : a->stmts) {
 		if (std::find(collected_labels.begin(), collected_labels.end(),
 			      stmt->static_offset) != collected_labels.end()) {
-			label::Ptr new_label = std::make_shared<label>();
+			label::Ptr new_label = make_node<label>();
 			new_label->static_offset = stmt->static_offset;
 			//new_label->label_name =
 			    //"label" + stmt->static_offset.stringify();
@@ -28,13 +28,13 @@ void label_creator::visit(stmt_block::Ptr a) {
 			    "label" + std::to_string(current_label);
 			current_label++;
 			label_stmt::Ptr new_label_stmt =
-			    std::make_shared<label_stmt>();
+			    make_node<label_stmt>();
 			new_label_stmt->static_offset.clear();
 			new_label_stmt->label1 = new_label;
 			new_stmts.push_back(new_label_stmt);
 			// collected_labels.erase(stmt->static_offset);
 			erase_tag(collected_labels, stmt->static_offset);
-			offset_to_label[stmt->static_offset.stringify()] =
+			offset_to_label[stmt->static_offset] =
 			    new_label;
 		}
 		new_stmts.push_back(stmt);
@@ -43,6 +43,6 @@ void label_creator::visit(stmt_block::Ptr a) {
 	a->stmts = new_stmts;
 }
 void label_inserter::visit(goto_stmt::Ptr a) {
-	a->label1 = offset_to_label[a->temporary_label_number.stringify()];
+	a->label1 = offset_to_label[a->temporary_label_number];
 }
 } // namespace block
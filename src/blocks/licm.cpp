@@ -0,0 +1,271 @@
+#include "blocks/licm.h"
+#include "blocks/block_visitor.h"
+#include "blocks/cse.h"
+#include "blocks/rce.h"
+#include "blocks/stmt.h"
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace block {
+
+class loop_decl_finder : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::unordered_set<var *> vars;
+	// A goto could enter the loop without running the code before it
+	bool has_label = false;
+	// Memoization can share statements of the loop with other blocks, the
+	// temporaries would only be declared before this loop
+	shared_stmt_finder *shared = nullptr;
+	bool has_shared_stmt = false;
+	virtual void visit(decl_stmt::Ptr a) override {
+		vars.insert(a->decl_var.get());
+		block_visitor::visit(a);
+	}
+	virtual void visit(label_stmt::Ptr) override { has_label = true; }
+	virtual void visit(stmt_block::Ptr b) override {
+		for (auto s : b->stmts) {
+			if (shared != nullptr && shared->is_shared(s))
+				has_shared_stmt = true;
+		}
+		block_visitor::visit(b);
+	}
+};
+
+class licm_group {
+public:
+	expr::Ptr *first;
+	std::vector<expr::Ptr *> uses;
+	type::Ptr expr_type;
+};
+
+class invariant_hoister : public block_visitor {
+public:
+	using block_visitor::visit;
+	// The vars that aren't declared in the function are globals
+	std::unordered_set<var *> function_vars;
+	std::unordered_set<var *> address_taken;
+	shared_stmt_finder *shared = nullptr;
+	int temp_counter = 0;
+
+	virtual void visit(stmt_block::Ptr) override;
+
+private:
+	std::unordered_set<stmt_block *> visited_blocks;
+	// What the loop being hoisted from changes
+	std::unordered_set<var *> loop_writes;
+	bool loop_writes_memory = false;
+	std::vector<std::unique_ptr<licm_group>> groups;
+	std::unordered_map<size_t, std::vector<licm_group *>> groups_by_hash;
+
+	std::vector<stmt::Ptr> hoist(stmt::Ptr loop);
+	bool is_invariant(expr::Ptr e);
+	void collect(expr::Ptr &slot);
+	void collect_stmt(stmt::Ptr s);
+};
+
+static bool reads_var(expr::Ptr e) {
+	if (isa<var_expr>(e))
+		return true;
+	if (isa<not_expr>(e))
+		return reads_var(to<not_expr>(e)->expr1);
+	if (isa<binary_expr>(e))
+		return reads_var(to<binary_expr>(e)->expr1) || reads_var(to<binary_expr>(e)->expr2);
+	return false;
+}
+
+// Loads aren't moved, the loop could be what keeps a pointer from being
+// dereferenced. Integer division is only moved for divisors that can't trap
+bool invariant_hoister::is_invariant(expr::Ptr e) {
+	if (isa<var_expr>(e)) {
+		var *v = to<var_expr>(e)->var1.get();
+		if (loop_writes.count(v) || address_taken.count(v) || isa<array_type>(v->var_type))
+			return false;
+		return function_vars.count(v) || !loop_writes_memory;
+	}
+	if (isa<int_const>(e) || isa<double_const>(e) || isa<float_const>(e))
+		return true;
+	if (isa<not_expr>(e))
+		return is_invariant(to<not_expr>(e)->expr1);
+	if (!isa<binary_expr>(e))
+		return false;
+	binary_expr::Ptr b = to<binary_expr>(e);
+	if (isa<div_expr>(b) || isa<mod_expr>(b)) {
+		type::Ptr t = expr_type(b);
+		bool is_float = t != nullptr && (to<scalar_type>(t)->scalar_type_id == scalar_type::DOUBLE_TYPE ||
+						 to<scalar_type>(t)->scalar_type_id == scalar_type::FLOAT_TYPE);
+		if (!is_float) {
+			if (!isa<int_const>(b->expr2))
+				return false;
+			long long divisor = to<int_const>(b->expr2)->value;
+			if (divisor == 0 || divisor == -1)
+				return false;
+		}
+	}
+	return is_invariant(b->expr1) && is_invariant(b->expr2);
+}
+
+void invariant_hoister::collect(expr::Ptr &slot) {
+	expr::Ptr e = slot;
+	if ((isa<binary_expr>(e) || isa<not_expr>(e)) && reads_var(e) && is_invariant(e)) {
+		type::Ptr t = expr_type(e);
+		if (isa<scalar_type>(t) || isa<pointer_type>(t)) {
+			size_t h = hash_expr(e);
+			for (auto g : groups_by_hash[h]) {
+				if (same_expr(*g->first, e)) {
+					g->uses.push_back(&slot);
+					return;
+				}
+			}
+			std::unique_ptr<licm_group> g(new licm_group());
+			g->first = &slot;
+			g->expr_type = t;
+			groups_by_hash[h].push_back(g.get());
+			groups.push_back(std::move(g));
+			return;
+		}
+	}
+
+	if (isa<binary_expr>(e)) {
+		collect(to<binary_expr>(e)->expr1);
+		collect(to<binary_expr>(e)->expr2);
+	} else if (isa<not_expr>(e)) {
+		collect(to<not_expr>(e)->expr1);
+	} else if (isa<sq_bkt_expr>(e)) {
+		collect(to<sq_bkt_expr>(e)->var_expr);
+		collect(to<sq_bkt_expr>(e)->index);
+	} else if (isa<assign_expr>(e)) {
+		assign_expr::Ptr a = to<assign_expr>(e);
+		// The target isn't read, only the index of a store is
+		if (isa<sq_bkt_expr>(a->var1)) {
+			collect(to<sq_bkt_expr>(a->var1)->var_expr);
+			collect(to<sq_bkt_expr>(a->var1)->index);
+		}
+		collect(a->expr1);
+	} else if (isa<function_call_expr>(e)) {
+		for (auto &arg : to<function_call_expr>(e)->args)
+			collect(arg);
+	}
+}
+
+void invariant_hoister::collect_stmt(stmt::Ptr s) {
+	if (isa<expr_stmt>(s)) {
+		collect(to<expr_stmt>(s)->expr1);
+	} else if (isa<decl_stmt>(s)) {
+		if (to<decl_stmt>(s)->init_expr != nullptr)
+			collect(to<decl_stmt>(s)->init_expr);
+	} else if (isa<return_stmt>(s)) {
+		collect(to<return_stmt>(s)->return_val);
+	} else if (isa<stmt_block>(s)) {
+		for (auto child : to<stmt_block>(s)->stmts)
+			collect_stmt(child);
+	} else if (isa<if_stmt>(s)) {
+		if_stmt::Ptr a = to<if_stmt>(s);
+		collect(a->cond);
+		collect_stmt(a->then_stmt);
+		collect_stmt(a->else_stmt);
+	} else if (isa<while_stmt>(s)) {
+		collect(to<while_stmt>(s)->cond);
+		collect_stmt(to<while_stmt>(s)->body);
+	} else if (isa<for_stmt>(s)) {
+		for_stmt::Ptr a = to<for_stmt>(s);
+		collect_stmt(a->decl_stmt);
+		collect(a->cond);
+		collect(a->update);
+		collect_stmt(a->body);
+	}
+}
+
+// Returns the decls of the temporaries to put before the loop
+std::vector<stmt::Ptr> invariant_hoister::hoist(stmt::Ptr loop) {
+	std::vector<stmt::Ptr> decls;
+	if (shared->is_shared(loop))
+		return decls;
+	loop_decl_finder decl_finder;
+	decl_finder.shared = shared;
+	loop->accept(&decl_finder);
+	if (decl_finder.has_label || decl_finder.has_shared_stmt)
+		return decls;
+	loop_write_finder write_finder;
+	loop->accept(&write_finder);
+	loop_writes = write_finder.written_vars;
+	// Vars declared in the loop get a new value every iteration
+	loop_writes.insert(decl_finder.vars.begin(), decl_finder.vars.end());
+	loop_writes_memory = write_finder.writes_memory;
+
+	groups.clear();
+	groups_by_hash.clear();
+	if (isa<while_stmt>(loop)) {
+		collect(to<while_stmt>(loop)->cond);
+		collect_stmt(to<while_stmt>(loop)->body);
+	} else {
+		// The init of a for loop only runs once
+		for_stmt::Ptr f = to<for_stmt>(loop);
+		collect(f->cond);
+		collect(f->update);
+		collect_stmt(f->body);
+	}
+
+	for (auto &g : groups) {
+		var::Ptr v = make_node<var>();
+		v->var_name = "licm_var_" + std::to_string(temp_counter++);
+		v->var_type = g->expr_type;
+		decl_stmt::Ptr decl = make_node<decl_stmt>();
+		decl->decl_var = v;
+		decl->init_expr = *g->first;
+		decl->static_offset = (*g->first)->static_offset;
+		decls.push_back(decl);
+
+		g->uses.push_back(g->first);
+		for (auto slot : g->uses) {
+			var_expr::Ptr ve = make_node<var_expr>();
+			ve->var1 = v;
+			ve->static_offset = (*slot)->static_offset;
+			*slot = ve;
+		}
+	}
+	groups.clear();
+	groups_by_hash.clear();
+	return decls;
+}
+
+// Outer loops are hoisted from first, so an expr that doesn't change in
+// any of the loops around it moves all the way out at once
+void invariant_hoister::visit(stmt_block::Ptr b) {
+	// A block inside a shared statement is reached more than once
+	if (!visited_blocks.insert(b.get()).second)
+		return;
+	std::vector<stmt::Ptr> new_stmts;
+	for (auto s : b->stmts) {
+		if (isa<while_stmt>(s) || isa<for_stmt>(s)) {
+			std::vector<stmt::Ptr> decls = hoist(s);
+			new_stmts.insert(new_stmts.end(), decls.begin(), decls.end());
+		}
+		new_stmts.push_back(s);
+	}
+	b->stmts = new_stmts;
+	for (auto s : b->stmts)
+		s->accept(this);
+}
+
+void hoist_loop_invariants(block::Ptr ast) {
+	shared_stmt_finder shared;
+	ast->accept(&shared);
+	invariant_hoister hoister;
+	hoister.shared = &shared;
+	address_taken_finder address_finder;
+	ast->accept(&address_finder);
+	hoister.address_taken = address_finder.vars;
+	loop_decl_finder decl_finder;
+	ast->accept(&decl_finder);
+	hoister.function_vars = decl_finder.vars;
+	if (isa<func_decl>(ast)) {
+		for (auto arg : to<func_decl>(ast)->args)
+			hoister.function_vars.insert(arg.get());
+	}
+	ast->accept(&hoister);
+}
+
+} // namespace block
@@ -60,7 +60,7 @@ static void insert_continues(stmt_block::Ptr a, label::Ptr label_detect,
 		if (to<goto_stmt>(a->stmts.back())->label1 == label_detect) {
 			a->stmts.pop_back();
 			continue_stmt::Ptr cont =
-			    std::make_shared<continue_stmt>();
+			    make_node<continue_stmt>();
 			a->stmts.push_back(cont);
 			collect.push_back(a);
 		}
@@ -198,10 +198,10 @@ void loop_finder::visit_label(label_stmt::Ptr a, stmt_block::Ptr parent) {
 	}
 	parent->stmts.clear();
 
-	while_stmt::Ptr new_while = std::make_shared<while_stmt>();
-	new_while->cond = std::make_shared<int_const>();
+	while_stmt::Ptr new_while = make_node<while_stmt>();
+	new_while->cond = make_node<int_const>();
 	to<int_const>(new_while->cond)->value = 1;
-	new_while->body = std::make_shared<stmt_block>();
+	new_while->body = make_node<stmt_block>();
 	to<stmt_block>(new_while->body)->stmts = stmts_in_body;
 
 	std::vector<stmt_block::Ptr> parents;
@@ -236,7 +236,7 @@ void loop_finder::visit_label(label_stmt::Ptr a, stmt_block::Ptr parent) {
 		// if (block->stmts.size() > 0 &&
 		// isa<goto_stmt>(block->stmts.back())) continue;
 
-		break_stmt::Ptr new_break = std::make_shared<break_stmt>();
+		break_stmt::Ptr new_break = make_node<break_stmt>();
 		block->stmts.push_back(new_break);
 	}
 
@@ -268,7 +268,7 @@ void loop_finder::visit_label(label_stmt::Ptr a, stmt_block::Ptr parent) {
 				to<stmt_block>(else_stmt)->stmts[0])) {
 				new_while->cond = if_body->cond;
 				// new_while->body =
-				// std::make_shared<stmt_block>();
+				// make_node<stmt_block>();
 				new_while->body = then_stmt;
 				return;
 			}
@@ -278,7 +278,7 @@ void loop_finder::visit_label(label_stmt::Ptr a, stmt_block::Ptr parent) {
 			if (isa<break_stmt>(
 				to<stmt_block>(then_stmt)->stmts[0])) {
 				not_expr::Ptr new_cond =
-				    std::make_shared<not_expr>();
+				    make_node<not_expr>();
 				new_cond->static_offset =
 				    if_body->cond->static_offset;
 				new_cond->expr1 = if_body->cond;
@@ -300,12 +300,12 @@ void loop_finder::visit_label(label_stmt::Ptr a, stmt_block::Ptr parent) {
 			if (isa<break_stmt>(
 				to<stmt_block>(then_stmt)->stmts[0])) {
 				not_expr::Ptr new_cond =
-				    std::make_shared<not_expr>();
+				    make_node<not_expr>();
 				new_cond->static_offset =
 				    if_body->cond->static_offset;
 				new_cond->expr1 = if_body->cond;
 				new_while->cond = new_cond;
-				auto new_body = std::make_shared<stmt_block>();
+				auto new_body = make_node<stmt_block>();
 				for (unsigned int i = 1;
 				     i < to<stmt_block>(new_while->body)
 					     ->stmts.size();
@@ -8,8 +8,9 @@ static bool is_roll(std::string s) {
 		return true;
 	return false;
 }
-static int unique_counter = 0;
-static void process_match(stmt_block::Ptr b, int match_start, int match_end) {
+// unique_counter names the new vars, it belongs to the pass invocation so
+// the names don't depend on other functions extracted at the same time
+static void process_match(stmt_block::Ptr b, int match_start, int match_end, int &unique_counter) {
 	stmt::Ptr first = b->stmts[match_start];
 	constant_expr_finder finder;
 	first->accept(&finder);
@@ -46,68 +47,66 @@ static void process_match(stmt_block::Ptr b, int match_start, int match_end) {
 			new_vars.push_back(nullptr);
 			continue;
 		}
-		var::Ptr new_var = std::make_shared<var>();
+		var::Ptr new_var = make_node<var>();
 		new_var->var_name =
-		    "roll_var_" + std::to_string(unique_counter);
+		    "roll_var_" + std::to_string(unique_counter++);
 		
 		std::vector<std::string> attrs;
 		attrs.push_back("static");
 				
 		new_var->setMetadata("attributes", attrs);
 
-		unique_counter++;
 		new_var->var_type =
 		    builder::dyn_var<int[]>::create_block_type();
 		to<array_type>(new_var->var_type)->size =
 		    match_end - match_start;
-		decl_stmt::Ptr new_decl = std::make_shared<decl_stmt>();
+		decl_stmt::Ptr new_decl = make_node<decl_stmt>();
 		new_decl->decl_var = new_var;
 		new_vars.push_back(new_var);
 
 		initializer_list_expr::Ptr new_init =
-		    std::make_shared<initializer_list_expr>();
+		    make_node<initializer_list_expr>();
 		for (unsigned int j = 0; j < vals[i].size(); j++) {
 			int_const::Ptr new_const =
-			    std::make_shared<int_const>();
+			    make_node<int_const>();
 			new_const->value = vals[i][j];
 			new_init->elems.push_back(new_const);
 		}
 		new_decl->init_expr = new_init;
 		new_stmts.push_back(new_decl);
 	}
-	for_stmt::Ptr new_for = std::make_shared<for_stmt>();
+	for_stmt::Ptr new_for = make_node<for_stmt>();
 
-	var::Ptr i_var = std::make_shared<var>();
-	i_var->var_name = "index_var_" + std::to_string(unique_counter);
-	unique_counter++;
+	var::Ptr i_var = make_node<var>();
+	i_var->var_name = "index_var_" + std::to_string(unique_counter++);
 	i_var->var_type = builder::dyn_var<int>::create_block_type();
-	decl_stmt::Ptr new_decl = std::make_shared<decl_stmt>();
+	decl_stmt::Ptr new_decl = make_node<decl_stmt>();
 	new_decl->decl_var = i_var;
-	int_const::Ptr init_const = std::make_shared<int_const>();
+	int_const::Ptr init_const = make_node<int_const>();
 	init_const->value = 0;
 	new_decl->init_expr = init_const;
 	new_for->decl_stmt = new_decl;
 
-	lt_expr::Ptr new_lt = std::make_shared<lt_expr>();
-	var_expr::Ptr new_var_expr = std::make_shared<var_expr>();
+	lt_expr::Ptr new_lt = make_node<lt_expr>();
+	var_expr::Ptr new_var_expr = make_node<var_expr>();
 	new_var_expr->var1 = i_var;
-	int_const::Ptr new_const_expr = std::make_shared<int_const>();
+	int_const::Ptr new_const_expr = make_node<int_const>();
 	new_const_expr->value = match_end - match_start;
 	new_lt->expr1 = new_var_expr;
 	new_lt->expr2 = new_const_expr;
 	new_for->cond = new_lt;
 
-	assign_expr::Ptr new_assign = std::make_shared<assign_expr>();
-	new_var_expr = std::make_shared<var_expr>();
+	assign_expr::Ptr new_assign = make_node<assign_expr>();
+	new_var_expr = make_node<var_expr>();
 	new_var_expr->var1 = i_var;
 
-	var_expr::Ptr new_var_expr2 = std::make_shared<var_expr>();
+	var_expr::Ptr new_var_expr2 = make_node<var_expr>();
 	new_var_expr2->var1 = i_var;
 
-	new_const_expr = std::make_shared<int_const>();
+	new_const_expr = make_node<int_const>();
 	new_const_expr->value = 1;
 
-	plus_expr::Ptr new_plus = std::make_shared<plus_expr>();
+	plus_expr::Ptr new_plus = make_node<plus_expr>();
 	new_plus->expr1 = new_var_expr2;
 	new_plus->expr2 = new_const_expr;
 
@@ -115,25 +114,25 @@ static void process_match(stmt_block::Ptr b, int match_start, int match_end) {
 	new_assign->expr1 = new_plus;
 	new_for->update = new_assign;
 
-	new_for->body = std::make_shared<stmt_block>();
+	new_for->body = make_node<stmt_block>();
 
 	// Replace constants
 	std::vector<expr::Ptr> replace;
 
 	for (unsigned int i = 0; i < num_constants; i++) {
 		if (new_vars[i] == nullptr) {
-			var_expr::Ptr new_var2 = std::make_shared<var_expr>();
+			var_expr::Ptr new_var2 = make_node<var_expr>();
 			new_var2->var1 = i_var;
 			replace.push_back(new_var2);
 			continue;
 		}
 
-		sq_bkt_expr::Ptr new_sq_bkt = std::make_shared<sq_bkt_expr>();
+		sq_bkt_expr::Ptr new_sq_bkt = make_node<sq_bkt_expr>();
 
-		var_expr::Ptr new_var1 = std::make_shared<var_expr>();
+		var_expr::Ptr new_var1 = make_node<var_expr>();
 		new_var1->var1 = new_vars[i];
 
-		var_expr::Ptr new_var2 = std::make_shared<var_expr>();
+		var_expr::Ptr new_var2 = make_node<var_expr>();
 		new_var2->var1 = i_var;
 
 		new_sq_bkt->var_expr = new_var1;
@@ -180,7 +179,7 @@ void loop_roll_finder::visit(stmt_block::Ptr b) {
 			}
 		}
 		if (match_start != -1) {
-			process_match(b, match_start, match_end);
+			process_match(b, match_start, match_end, unique_counter);
 		} else
 			break;
 	}
@@ -0,0 +1,69 @@
+#include "blocks/node_collector.h"
+
+namespace block {
+
+#define COLLECT_NODE(name)                                                                                             \
+	void node_collector::visit(name::Ptr a) {                                                                      \
+		if (nodes.insert(a).second)                                                                            \
+			block_visitor::visit(a);                                                                       \
+	}
+
+COLLECT_NODE(block)
+COLLECT_NODE(expr)
+COLLECT_NODE(unary_expr)
+COLLECT_NODE(binary_expr)
+COLLECT_NODE(not_expr)
+COLLECT_NODE(and_expr)
+COLLECT_NODE(bitwise_and_expr)
+COLLECT_NODE(or_expr)
+COLLECT_NODE(bitwise_or_expr)
+COLLECT_NODE(plus_expr)
+COLLECT_NODE(minus_expr)
+COLLECT_NODE(mul_expr)
+COLLECT_NODE(div_expr)
+COLLECT_NODE(lt_expr)
+COLLECT_NODE(gt_expr)
+COLLECT_NODE(lte_expr)
+COLLECT_NODE(gte_expr)
+COLLECT_NODE(lshift_expr)
+COLLECT_NODE(rshift_expr)
+COLLECT_NODE(equals_expr)
+COLLECT_NODE(ne_expr)
+COLLECT_NODE(mod_expr)
+COLLECT_NODE(var_expr)
+COLLECT_NODE(const_expr)
+COLLECT_NODE(int_const)
+COLLECT_NODE(double_const)
+COLLECT_NODE(float_const)
+COLLECT_NODE(string_const)
+COLLECT_NODE(assign_expr)
+COLLECT_NODE(stmt)
+COLLECT_NODE(expr_stmt)
+COLLECT_NODE(stmt_block)
+COLLECT_NODE(decl_stmt)
+COLLECT_NODE(if_stmt)
+COLLECT_NODE(label)
+COLLECT_NODE(label_stmt)
+COLLECT_NODE(goto_stmt)
+COLLECT_NODE(while_stmt)
+COLLECT_NODE(for_stmt)
+COLLECT_NODE(break_stmt)
+COLLECT_NODE(continue_stmt)
+COLLECT_NODE(sq_bkt_expr)
+COLLECT_NODE(function_call_expr)
+COLLECT_NODE(initializer_list_expr)
+COLLECT_NODE(foreign_expr_base)
+COLLECT_NODE(member_access_expr)
+COLLECT_NODE(addr_of_expr)
+COLLECT_NODE(var)
+COLLECT_NODE(type)
+COLLECT_NODE(scalar_type)
+COLLECT_NODE(pointer_type)
+COLLECT_NODE(function_type)
+COLLECT_NODE(array_type)
+COLLECT_NODE(builder_var_type)
+COLLECT_NODE(named_type)
+COLLECT_NODE(func_decl)
+COLLECT_NODE(return_stmt)
+
+} // namespace block
@@ -0,0 +1,425 @@
+#include "blocks/omp_annotations.h"
+#include "blocks/cfg.h"
+#include "blocks/cse.h"
+#include "blocks/dataflow.h"
+#include "blocks/extract_cuda.h"
+#include "blocks/for_loop_finder.h"
+#include "blocks/rce.h"
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace block {
+
+static bool is_var(var::Ptr v, expr::Ptr e) { return isa<var_expr>(e) && to<var_expr>(e)->var1 == v; }
+
+static bool reads_var(var::Ptr v, expr::Ptr e) {
+	var_use_finder finder;
+	finder.to_find = v;
+	e->accept(&finder);
+	return finder.found;
+}
+
+// Finds the vars a loop assigns and the ones that are only ever updated
+// the way the reduction op combines values, without being read anywhere else
+class omp_write_finder : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::string reduction_op;
+	std::vector<var::Ptr> written;
+	std::unordered_map<var *, int> uses;
+	std::unordered_map<var *, int> reduction_updates;
+	std::unordered_map<var *, bool> other_writes;
+
+	virtual void visit(var_expr::Ptr e) override { uses[e->var1.get()]++; }
+	virtual void visit(assign_expr::Ptr e) override {
+		block_visitor::visit(e);
+		if (!isa<var_expr>(e->var1))
+			return;
+		var::Ptr v = to<var_expr>(e->var1)->var1;
+		add_written(v);
+		if (is_reduction_update(v, e->expr1))
+			reduction_updates[v.get()]++;
+		else
+			other_writes[v.get()] = true;
+	}
+	virtual void visit(if_stmt::Ptr s) override {
+		var::Ptr v = minmax_update(s);
+		if (v == nullptr) {
+			block_visitor::visit(s);
+			return;
+		}
+		// The value is read by the condition, the target is counted once more
+		// so that the update reads the var twice like v = v op e does
+		s->cond->accept(this);
+		uses[v.get()]++;
+		add_written(v);
+		reduction_updates[v.get()]++;
+	}
+	bool is_reduction(var::Ptr v) {
+		// The var is read by its updates and nowhere else
+		return !other_writes[v.get()] && uses[v.get()] == 2 * reduction_updates[v.get()];
+	}
+
+private:
+	void add_written(var::Ptr v) {
+		if (std::find(written.begin(), written.end(), v) == written.end())
+			written.push_back(v);
+	}
+	bool is_reduction_update(var::Ptr v, expr::Ptr rhs) {
+		if (!isa<binary_expr>(rhs))
+			return false;
+		binary_expr::Ptr b = to<binary_expr>(rhs);
+		// Subtracting partial sums adds them up, so + and - are the same reduction
+		if ((reduction_op == "+" || reduction_op == "-") && isa<minus_expr>(rhs))
+			return is_var(v, b->expr1);
+		block_kind kind = block_kind::block;
+		if (reduction_op == "+" || reduction_op == "-")
+			kind = block_kind::plus_expr;
+		else if (reduction_op == "*")
+			kind = block_kind::mul_expr;
+		else if (reduction_op == "&")
+			kind = block_kind::bitwise_and_expr;
+		else if (reduction_op == "|")
+			kind = block_kind::bitwise_or_expr;
+		else if (reduction_op == "&&")
+			kind = block_kind::and_expr;
+		else if (reduction_op == "||")
+			kind = block_kind::or_expr;
+		return rhs->kind == kind && (is_var(v, b->expr1) || is_var(v, b->expr2));
+	}
+	// max and min are computed with if (e > v) v = e; and if (e < v) v = e;
+	// returns the var updated like that, null otherwise
+	var::Ptr minmax_update(if_stmt::Ptr s) {
+		if (reduction_op != "max" && reduction_op != "min")
+			return nullptr;
+		if (!isa<stmt_block>(s->then_stmt) || !isa<stmt_block>(s->else_stmt) ||
+		    !to<stmt_block>(s->else_stmt)->stmts.empty())
+			return nullptr;
+		std::vector<stmt::Ptr> &then_stmts = to<stmt_block>(s->then_stmt)->stmts;
+		if (then_stmts.size() != 1 || !isa<expr_stmt>(then_stmts[0]) ||
+		    !isa<assign_expr>(to<expr_stmt>(then_stmts[0])->expr1))
+			return nullptr;
+		assign_expr::Ptr assign = to<assign_expr>(to<expr_stmt>(then_stmts[0])->expr1);
+		if (!isa<var_expr>(assign->var1))
+			return nullptr;
+		var::Ptr v = to<var_expr>(assign->var1)->var1;
+
+		bool greater = isa<gt_expr>(s->cond) || isa<gte_expr>(s->cond);
+		if (!greater && !isa<lt_expr>(s->cond) && !isa<lte_expr>(s->cond))
+			return nullptr;
+		binary_expr::Ptr cond = to<binary_expr>(s->cond);
+		expr::Ptr value;
+		bool value_larger;
+		if (is_var(v, cond->expr2)) {
+			value = cond->expr1;
+			value_larger = greater;
+		} else if (is_var(v, cond->expr1)) {
+			value = cond->expr2;
+			value_larger = !greater;
+		} else
+			return nullptr;
+		if (!same_expr(value, assign->expr1))
+			return nullptr;
+		return value_larger == (reduction_op == "max") ? v : nullptr;
+	}
+};
+
+static bool is_supported_reduction(const std::string &op) {
+	return op == "+" || op == "-" || op == "*" || op == "&" || op == "|" || op == "&&" || op == "||" ||
+	       op == "max" || op == "min";
+}
+
+// Finds the jumps that leave an iteration other than continue
+class omp_jump_finder : public block_visitor {
+public:
+	using block_visitor::visit;
+	bool jumps_out = false;
+	virtual void visit(break_stmt::Ptr) override {
+		if (loop_depth == 0)
+			jumps_out = true;
+	}
+	virtual void visit(return_stmt::Ptr) override { jumps_out = true; }
+	virtual void visit(goto_stmt::Ptr) override { jumps_out = true; }
+	virtual void visit(label_stmt::Ptr) override { jumps_out = true; }
+	virtual void visit(while_stmt::Ptr s) override {
+		loop_depth++;
+		block_visitor::visit(s);
+		loop_depth--;
+	}
+	virtual void visit(for_stmt::Ptr s) override {
+		loop_depth++;
+		block_visitor::visit(s);
+		loop_depth--;
+	}
+
+private:
+	int loop_depth = 0;
+};
+
+// Returns why the loop isn't in the canonical form OpenMP requires, an empty
+// string if it is. Loops are only checked, not rewritten into that form
+static std::string check_canonical(for_stmt::Ptr loop) {
+	var::Ptr v;
+	if (isa<decl_stmt>(loop->decl_stmt) && to<decl_stmt>(loop->decl_stmt)->init_expr != nullptr) {
+		v = to<decl_stmt>(loop->decl_stmt)->decl_var;
+	} else if (isa<expr_stmt>(loop->decl_stmt) && isa<assign_expr>(to<expr_stmt>(loop->decl_stmt)->expr1) &&
+		   isa<var_expr>(to<assign_expr>(to<expr_stmt>(loop->decl_stmt)->expr1)->var1)) {
+		v = to<var_expr>(to<assign_expr>(to<expr_stmt>(loop->decl_stmt)->expr1)->var1)->var1;
+	} else
+		return "the loop var is not initialized by the loop";
+	bool is_integer = isa<scalar_type>(v->var_type) &&
+			  to<scalar_type>(v->var_type)->scalar_type_id != scalar_type::FLOAT_TYPE &&
+			  to<scalar_type>(v->var_type)->scalar_type_id != scalar_type::DOUBLE_TYPE;
+	if (!is_integer && !isa<pointer_type>(v->var_type))
+		return v->var_name + " is not an integer or a pointer";
+
+	if (!isa<lt_expr>(loop->cond) && !isa<gt_expr>(loop->cond) && !isa<lte_expr>(loop->cond) &&
+	    !isa<gte_expr>(loop->cond) && !isa<ne_expr>(loop->cond))
+		return "the condition is not a comparison";
+	binary_expr::Ptr cond = to<binary_expr>(loop->cond);
+	expr::Ptr bound;
+	if (is_var(v, cond->expr1))
+		bound = cond->expr2;
+	else if (is_var(v, cond->expr2))
+		bound = cond->expr1;
+	else
+		return "the condition does not compare " + v->var_name;
+	if (reads_var(v, bound))
+		return "the bound depends on " + v->var_name;
+
+	expr::Ptr step;
+	if (isa<assign_expr>(loop->update) && is_var(v, to<assign_expr>(loop->update)->var1)) {
+		expr::Ptr rhs = to<assign_expr>(loop->update)->expr1;
+		if (isa<plus_expr>(rhs) && is_var(v, to<binary_expr>(rhs)->expr1))
+			step = to<binary_expr>(rhs)->expr2;
+		else if (isa<plus_expr>(rhs) && is_var(v, to<binary_expr>(rhs)->expr2))
+			step = to<binary_expr>(rhs)->expr1;
+		else if (isa<minus_expr>(rhs) && is_var(v, to<binary_expr>(rhs)->expr1))
+			step = to<binary_expr>(rhs)->expr2;
+	}
+	if (step == nullptr || reads_var(v, step))
+		return "the update does not add to or subtract from " + v->var_name;
+	if (isa<ne_expr>(loop->cond) && !(isa<int_const>(step) && to<int_const>(step)->value == 1))
+		return "the condition is != but the step is not 1";
+
+	loop_write_finder writes;
+	loop->body->accept(&writes);
+	if (writes.written_vars.count(v.get()))
+		return "the body assigns " + v->var_name;
+	gather_extern_vars bound_vars;
+	bound->accept(&bound_vars);
+	step->accept(&bound_vars);
+	for (auto u : bound_vars.gathered) {
+		if (writes.written_vars.count(u.get()))
+			return "the body assigns " + u->var_name + " which the bound or the step read";
+	}
+
+	omp_jump_finder jumps;
+	loop->body->accept(&jumps);
+	if (jumps.jumps_out)
+		return "the body jumps out of the loop";
+	return "";
+}
+
+// Checks the loops collapse(n) applies to, they have to be perfectly nested
+static std::string check_collapsed(for_stmt::Ptr loop, const std::vector<std::string> &clauses) {
+	int depth = 1;
+	for (auto &clause : clauses) {
+		if (clause.compare(0, 9, "collapse(") == 0)
+			depth = atoi(clause.c_str() + 9);
+	}
+	for (int i = 1; i < depth; i++) {
+		if (!isa<stmt_block>(loop->body) || to<stmt_block>(loop->body)->stmts.size() != 1 ||
+		    !isa<for_stmt>(to<stmt_block>(loop->body)->stmts[0]))
+			return "the loops collapse applies to are not perfectly nested";
+		loop = to<for_stmt>(to<stmt_block>(loop->body)->stmts[0]);
+		std::string reason = check_canonical(loop);
+		if (reason != "")
+			return reason;
+	}
+	return "";
+}
+
+// Finds the vars that are assigned on every path through a block
+class omp_must_write_problem : public dataflow_problem<var_set> {
+public:
+	var_set all_vars;
+	virtual bool is_forward(void) override { return true; }
+	virtual var_set boundary(void) override { return var_set(); }
+	virtual var_set top(void) override { return all_vars; }
+	virtual var_set meet(const var_set &a, const var_set &b) override {
+		var_set ret;
+		for (auto v : a) {
+			if (b.count(v))
+				ret.insert(v);
+		}
+		return ret;
+	}
+	virtual var_set transfer(basic_block *bb, const var_set &value) override {
+		var_set ret = value;
+		for (auto node : bb->nodes) {
+			std::vector<var *> defs, uses;
+			find_defs_and_uses(node, defs, uses);
+			ret.insert(defs.begin(), defs.end());
+		}
+		return ret;
+	}
+};
+
+static void print_vars(std::ostream &oss, const std::vector<var::Ptr> &vars) {
+	for (unsigned int i = 0; i < vars.size(); i++)
+		oss << (i ? ", " : "") << vars[i]->var_name;
+}
+
+// Splits the clauses after the prefix, false if the annotation doesn't start with it
+static bool parse_clauses(const std::string &annotation, const std::string &prefix, std::vector<std::string> &clauses) {
+	if (annotation.compare(0, prefix.size(), prefix) != 0)
+		return false;
+	if (annotation.size() > prefix.size() && annotation[prefix.size()] != ':')
+		return false;
+	std::istringstream params(annotation.substr(prefix.size()));
+	std::string param;
+	while (std::getline(params, param, ':')) {
+		if (param != "")
+			clauses.push_back(param);
+	}
+	return true;
+}
+
+std::string omp_parallel_pragma(for_stmt::Ptr loop) {
+	std::vector<std::string> clauses;
+	if (!parse_clauses(loop->annotation, OMP_PARALLEL, clauses))
+		return "";
+	std::string reduction_op;
+	std::vector<std::string> other_clauses;
+	for (auto &param : clauses) {
+		if (param.compare(0, 10, "reduction(") == 0 && param.back() == ')')
+			reduction_op = param.substr(10, param.size() - 11);
+		else
+			other_clauses.push_back(param);
+	}
+
+	const std::string not_applied = "// omp parallel for not applied: ";
+	std::string reason = check_canonical(loop);
+	if (reason == "")
+		reason = check_collapsed(loop, other_clauses);
+	if (reason == "" && reduction_op != "" && !is_supported_reduction(reduction_op))
+		reason = "reduction(" + reduction_op + ") is not supported";
+	if (reason != "")
+		return not_applied + reason;
+
+	// Same as the vars that become the arguments of a CUDA kernel
+	gather_declared_vars declared;
+	loop->accept(&declared);
+	gather_extern_vars externs;
+	externs.declared = declared.declared;
+	loop->accept(&externs);
+
+	omp_write_finder writes;
+	writes.reduction_op = reduction_op;
+	loop->accept(&writes);
+
+	// Each thread has its own copy of the vars the loop assigns, which only
+	// works if the iterations don't read the value of an earlier one. The
+	// copy after the last iteration is only right if that iteration wrote it
+	std::unique_ptr<control_flow_graph> cfg = control_flow_graph::build(loop->body);
+	var_set read_first = compute_liveness(*cfg).in[cfg->entry->id];
+	omp_must_write_problem must_write;
+	for (auto v : writes.written)
+		must_write.all_vars.insert(v.get());
+	var_set always_written = solve_dataflow(*cfg, must_write).in[cfg->exit->id];
+
+	std::vector<var::Ptr> shared_vars, lastprivate_vars, reduction_vars;
+	for (auto v : externs.gathered) {
+		if (std::find(writes.written.begin(), writes.written.end(), v) == writes.written.end())
+			shared_vars.push_back(v);
+		else if (isa<expr_stmt>(loop->decl_stmt) && is_var(v, to<assign_expr>(to<expr_stmt>(loop->decl_stmt)->expr1)->var1))
+			// The loop var declared before the loop
+			lastprivate_vars.push_back(v);
+		else if (reduction_op != "" && writes.is_reduction(v))
+			reduction_vars.push_back(v);
+		else if (read_first.count(v.get()))
+			return not_applied + v->var_name + " is read before it is written in an iteration";
+		else if (!always_written.count(v.get()))
+			return not_applied + v->var_name + " is not written in every iteration";
+		else
+			lastprivate_vars.push_back(v);
+	}
+
+	std::ostringstream oss;
+	oss << "#pragma omp parallel for";
+	if (!shared_vars.empty()) {
+		oss << " shared(";
+		print_vars(oss, shared_vars);
+		oss << ")";
+	}
+	if (!lastprivate_vars.empty()) {
+		oss << " lastprivate(";
+		print_vars(oss, lastprivate_vars);
+		oss << ")";
+	}
+	if (!reduction_vars.empty()) {
+		oss << " reduction(" << reduction_op << ":";
+		print_vars(oss, reduction_vars);
+		oss << ")";
+	}
+	for (auto &clause : other_clauses)
+		oss << " " << clause;
+	return oss.str();
+}
+
+std::string omp_unapplied_comment(stmt::Ptr s) {
+	std::vector<std::string> clauses;
+	if (isa<for_stmt>(s))
+		return "";
+	if (parse_clauses(s->annotation, OMP_PARALLEL, clauses))
+		return "// omp parallel for not applied: the loop is not a counted for loop";
+	if (parse_clauses(s->annotation, OMP_SIMD, clauses))
+		return "// omp simd not applied: the loop is not a counted for loop";
+	return "";
+}
+
+std::string omp_simd_pragma(for_stmt::Ptr loop) {
+	std::vector<std::string> clauses;
+	if (!parse_clauses(loop->annotation, OMP_SIMD, clauses))
+		return "";
+	std::string reason = check_canonical(loop);
+	if (reason == "")
+		reason = check_collapsed(loop, clauses);
+	if (reason != "")
+		return "// omp simd not applied: " + reason;
+
+	// The pointers the loop uses with a known alignment, grouped by it
+	gather_declared_vars declared;
+	loop->accept(&declared);
+	gather_extern_vars externs;
+	externs.declared = declared.declared;
+	loop->accept(&externs);
+	std::vector<std::pair<int, std::vector<var::Ptr>>> aligned;
+	for (auto v : externs.gathered) {
+		if (!isa<pointer_type>(v->var_type) || !v->hasMetadata<int>("aligned"))
+			continue;
+		int alignment = v->getMetadata<int>("aligned");
+		auto it = std::find_if(aligned.begin(), aligned.end(),
+				       [&](const std::pair<int, std::vector<var::Ptr>> &a) { return a.first == alignment; });
+		if (it == aligned.end())
+			aligned.push_back(std::make_pair(alignment, std::vector<var::Ptr>(1, v)));
+		else
+			it->second.push_back(v);
+	}
+
+	std::ostringstream oss;
+	oss << "#pragma omp simd";
+	for (auto &a : aligned) {
+		oss << " aligned(";
+		print_vars(oss, a.second);
+		oss << ":" << a.first << ")";
+	}
+	for (auto &clause : clauses)
+		oss << " " << clause;
+	return oss.str();
+}
+
+} // namespace block
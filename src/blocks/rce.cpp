@@ -1,54 +1,57 @@
 #include "blocks/rce.h"
-#include <map>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "blocks/block_visitor.h"
 #include "blocks/block_replacer.h"
+#include "blocks/cfg.h"
+#include "blocks/dataflow.h"
 #include "blocks/expr.h"
 #include "blocks/stmt.h"
-#include <algorithm>
 namespace block {
 
 
 class var_use_counter: public block_visitor {
-public: 
+public:
 	using block_visitor::visit;
-	std::map<var::Ptr, uint64_t> usage_count;
-	std::vector<var::Ptr> assigned_vars;
+	std::unordered_map<var *, uint64_t> usage_count;
+	std::unordered_set<var *> assigned_vars;
+	// Vars whose address is taken can change through pointers
+	std::unordered_set<var *> address_taken_vars;
+	std::unordered_set<var *> declared_vars;
+	bool inside_addr_of = false;
 	virtual void visit(var_expr::Ptr e) override {
-		var::Ptr v = e->var1;
-		if (usage_count.find(v) != usage_count.end()) 
-			usage_count[v]++;
-		else
-			usage_count[v] = 1;
+		usage_count[e->var1.get()]++;
+		if (inside_addr_of)
+			address_taken_vars.insert(e->var1.get());
 	}
 	virtual void visit(assign_expr::Ptr e) override {
 		e->var1->accept(this);
 		e->expr1->accept(this);
-		if (!isa<var_expr>(e->var1))
-			return;
-		var_expr::Ptr ve = to<var_expr>(e->var1);
-		var::Ptr v = ve->var1;
-		if (std::find(assigned_vars.begin(), assigned_vars.end(), v) == assigned_vars.end())
-			assigned_vars.push_back(v);	
+		if (isa<var_expr>(e->var1))
+			assigned_vars.insert(to<var_expr>(e->var1)->var1.get());
 	}
-};
-
-class check_side_effects: public block_visitor {
-public:
-	using block_visitor::visit;
-	bool has_side_effects = false;
-	virtual void visit(assign_expr::Ptr) override {
-		has_side_effects = true;
+	virtual void visit(addr_of_expr::Ptr e) override {
+		bool old = inside_addr_of;
+		inside_addr_of = true;
+		e->expr1->accept(this);
+		inside_addr_of = old;
 	}
-	virtual void visit(function_call_expr::Ptr) override {
-		has_side_effects = true;
+	virtual void visit(decl_stmt::Ptr decl) override {
+		declared_vars.insert(decl->decl_var.get());
+		block_visitor::visit(decl);
 	}
-	virtual void visit(addr_of_expr::Ptr) override {
-		has_side_effects = true;
+	// Args can't be changed from outside of the function either
+	virtual void visit(func_decl::Ptr f) override {
+		for (auto arg : f->args)
+			declared_vars.insert(arg.get());
+		block_visitor::visit(f);
 	}
 };
 
-
 class gather_rce_decls: public block_visitor {
 public:
 	using block_visitor::visit;
@@ -56,32 +59,27 @@ public:
 	// This are vars (y) that may have one use but the use is of the form int x = y (use of y)
 	// and x has multiple uses. When x is replaced with y it will have multiple uses
 	// so we want to black list such x's
-	std::vector<var::Ptr> duplicated_vars;
-	std::map<var::Ptr, uint64_t> usage_count;
-	std::vector<var::Ptr> assigned_vars;
+	std::unordered_set<var *> duplicated_vars;
+	var_use_counter *counter;
 
-	virtual void visit(decl_stmt::Ptr decl) {
+	virtual void visit(decl_stmt::Ptr decl) override {
 		if (decl->init_expr == nullptr)
 			return;
-		var::Ptr v = decl->decl_var;
-		if (std::find(assigned_vars.begin(), assigned_vars.end(), v) != assigned_vars.end())
+		var *v = decl->decl_var.get();
+		if (counter->assigned_vars.count(v) || counter->address_taken_vars.count(v))
 			return;
-		int use_count = 0;
-		if (usage_count.find(v) != usage_count.end())
-			use_count = usage_count[v];
+		uint64_t use_count = 0;
+		auto it = counter->usage_count.find(v);
+		if (it != counter->usage_count.end())
+			use_count = it->second;
 		if (isa<var_expr>(decl->init_expr)) {
 			// This is time to blacklist y
-			if (use_count > 1) {
-				var_expr::Ptr ve = to<var_expr>(decl->init_expr);
-				var::Ptr v = ve->var1;
-				if (std::find(duplicated_vars.begin(), duplicated_vars.end(), v) == duplicated_vars.end()) {
-					duplicated_vars.push_back(v);
-				}
-			}
+			if (use_count > 1)
+				duplicated_vars.insert(to<var_expr>(decl->init_expr)->var1.get());
 			gathered_decls.push_back(decl);
 			return;
 		}
-		
+
 		if (use_count == 1) {
 			check_side_effects checker;
 			decl->init_expr->accept(&checker);
@@ -95,108 +93,444 @@ public:
 	}
 };
 
-class replace_rce_vars: public block_replacer {
+// The vars an expr reads and whether it reads memory, which anything
+// that stores through a pointer or calls a function can change
+class read_finder: public block_visitor {
+public:
+	using block_visitor::visit;
+	std::vector<var *> read_vars;
+	bool reads_memory = false;
+	var_use_counter *counter;
+	virtual void visit(var_expr::Ptr e) override {
+		var *v = e->var1.get();
+		read_vars.push_back(v);
+		if (counter->address_taken_vars.count(v) || !counter->declared_vars.count(v))
+			reads_memory = true;
+	}
+	virtual void visit(sq_bkt_expr::Ptr e) override {
+		block_visitor::visit(e);
+		reads_memory = true;
+	}
+	virtual void visit(member_access_expr::Ptr e) override {
+		block_visitor::visit(e);
+		reads_memory = true;
+	}
+	virtual void visit(foreign_expr_base::Ptr e) override {
+		reads_memory = true;
+	}
+};
+
+// A gathered decl. Its init is available at a point if the decl ran on
+// every path to the point and nothing the init reads was written since
+class rce_candidate {
+public:
+	decl_stmt::Ptr decl;
+	// Copies are substituted into loops too, reading a var again costs nothing
+	bool is_copy = false;
+	// The vars the init reads, with the ones read by the inits that can be
+	// substituted into it
+	std::vector<var *> reads;
+	bool reads_memory = false;
+	// The CFG blocks the decl is in
+	std::vector<basic_block *> blocks;
+};
+
+// Runs over the nodes of a basic block in execution order and updates the
+// set of available candidates. With substitute set, the uses of the
+// available candidates that it accepts are replaced with their inits
+class rce_substituter: public block_replacer {
 public:
 	using block_replacer::visit;
-	std::vector<decl_stmt::Ptr> gathered_decls;
-	std::map<var::Ptr, decl_stmt::Ptr> var_decl_map;
-	std::vector<var::Ptr> perma_enabled_decls;
-	std::vector<var::Ptr> enabled_decls;	
+	std::unordered_map<var *, rce_candidate> *candidates;
+	// The candidates that stop being available when a var is written
+	std::unordered_map<var *, std::vector<var *>> *dependents;
+	std::vector<var *> *memory_dependents;
+	var_use_counter *counter;
+	var_set available;
+	std::function<bool(var *)> substitute;
 
 	virtual void visit(decl_stmt::Ptr decl) override {
 		if (decl->init_expr)
-			decl->init_expr = rewrite(decl->init_expr);		
-		if (std::find(gathered_decls.begin(), gathered_decls.end(), decl) != gathered_decls.end()) {
-			if (isa<var_expr>(decl->init_expr))
-				perma_enabled_decls.push_back(decl->decl_var);
-			else {
-				// Store decls that have a complex expression on the RHS
-				// separately, if there is any statement that has side-effects, 
-				// we can immediately clear this	
-				enabled_decls.push_back(decl->decl_var);
-			}
-		}	
+			decl->init_expr = rewrite(decl->init_expr);
+		var *v = decl->decl_var.get();
+		// A decl in a loop gives the var a new value every iteration
+		kill_var(v);
+		if (candidates->count(v))
+			available.insert(v);
 		node = decl;
 	}
 	virtual void visit(assign_expr::Ptr assign) override {
 		assign->expr1 = rewrite(assign->expr1);
 		assign->var1 = rewrite(assign->var1);
-		enabled_decls.clear();
+		if (isa<var_expr>(assign->var1))
+			kill_var(to<var_expr>(assign->var1)->var1.get());
+		else
+			kill_memory();
 		node = assign;
 	}
-	virtual void visit(addr_of_expr::Ptr addr) override {
-		addr->expr1 = rewrite(addr->expr1);
-		enabled_decls.clear();
-		node = addr;
-	}
 	virtual void visit(function_call_expr::Ptr f) override {
 		for (unsigned int i = 0; i < f->args.size(); i++) {
 			f->args[i] = rewrite(f->args[i]);
 		}
-		enabled_decls.clear();
+		kill_memory();
 		node = f;
 	}
 	virtual void visit(var_expr::Ptr ve) override {
-		var::Ptr v = ve->var1;	
-		if (std::find(perma_enabled_decls.begin(), perma_enabled_decls.end(), v) != perma_enabled_decls.end() 
-			|| std::find(enabled_decls.begin(), enabled_decls.end(), v) != enabled_decls.end()) {
-			decl_stmt::Ptr de = var_decl_map[v];	
-			node = de->init_expr;
-		} else {
+		var *v = ve->var1.get();
+		if (substitute && available.count(v) && substitute(v))
+			node = (*candidates)[v].decl->init_expr;
+		else
 			node = ve;
+	}
+
+private:
+	void kill_var(var *v) {
+		auto it = dependents->find(v);
+		if (it != dependents->end()) {
+			for (auto d : it->second)
+				available.erase(d);
+		}
+		if (counter->address_taken_vars.count(v))
+			kill_memory();
+	}
+	void kill_memory(void) {
+		for (auto d : *memory_dependents)
+			available.erase(d);
+	}
+};
+
+// Forward problem, the meet is the intersection
+class rce_availability: public dataflow_problem<var_set> {
+public:
+	rce_substituter *substituter;
+	var_set all_candidates;
+	virtual bool is_forward(void) override { return true; }
+	virtual var_set boundary(void) override { return var_set(); }
+	virtual var_set top(void) override { return all_candidates; }
+	virtual var_set meet(const var_set &a, const var_set &b) override {
+		var_set ret;
+		for (auto v : a) {
+			if (b.count(v))
+				ret.insert(v);
 		}
+		return ret;
+	}
+	virtual var_set transfer(basic_block *bb, const var_set &in) override {
+		substituter->available = in;
+		for (auto n : bb->nodes)
+			n->accept(substituter);
+		return std::move(substituter->available);
 	}
 };
 
+// For every block, the headers of the natural loops it is in. A loop is
+// found from each edge to a block that dominates the source of the edge
+static std::vector<std::vector<unsigned int>> find_cfg_loops(control_flow_graph &cfg) {
+	std::vector<std::vector<unsigned int>> loops(cfg.blocks.size());
+	for (auto bb : cfg.reverse_postorder()) {
+		for (auto header : bb->successors) {
+			if (!cfg.dominates(header, bb))
+				continue;
+			std::vector<basic_block *> worklist(1, bb);
+			if (std::find(loops[header->id].begin(), loops[header->id].end(), header->id) == loops[header->id].end())
+				loops[header->id].push_back(header->id);
+			while (!worklist.empty()) {
+				basic_block *b = worklist.back();
+				worklist.pop_back();
+				std::vector<unsigned int> &in = loops[b->id];
+				if (std::find(in.begin(), in.end(), header->id) != in.end())
+					continue;
+				in.push_back(header->id);
+				for (auto pred : b->predecessors)
+					worklist.push_back(pred);
+			}
+		}
+	}
+	for (auto &l : loops)
+		std::sort(l.begin(), l.end());
+	return loops;
+}
+
+// Rewrites one node of a basic block, conditions and updates are put back
+// into their loop or if
+static void substitute_node(rce_substituter &substituter, block::Ptr n, basic_block *bb) {
+	if (!isa<expr>(n)) {
+		n->accept(&substituter);
+		return;
+	}
+	expr::Ptr e = substituter.rewrite(to<expr>(n));
+	if (e == n)
+		return;
+	stmt::Ptr owner = bb->terminator;
+	if (owner == nullptr || bb->nodes.back() != n) {
+		// The update of a for loop is in a block that jumps to the condition
+		for (auto succ : bb->successors) {
+			if (succ->terminator != nullptr && isa<for_stmt>(succ->terminator) &&
+			    to<for_stmt>(succ->terminator)->update == n) {
+				to<for_stmt>(succ->terminator)->update = e;
+				return;
+			}
+		}
+		return;
+	}
+	if (isa<if_stmt>(owner))
+		to<if_stmt>(owner)->cond = e;
+	else if (isa<while_stmt>(owner))
+		to<while_stmt>(owner)->cond = e;
+	else if (isa<for_stmt>(owner))
+		to<for_stmt>(owner)->cond = e;
+}
+
+// The nodes of the reachable blocks with the blocks they are in. Memoized
+// parts of the AST can put the same node in more than one place
+static std::unordered_map<block *, std::vector<basic_block *>> find_node_blocks(std::vector<basic_block *> &order) {
+	std::unordered_map<block *, std::vector<basic_block *>> node_blocks;
+	for (auto bb : order) {
+		for (auto n : bb->nodes)
+			node_blocks[n.get()].push_back(bb);
+	}
+	return node_blocks;
+}
+
+static void substitute_available_decls(stmt::Ptr ast, var_use_counter &counter,
+				       std::unordered_map<var *, rce_candidate> &candidates,
+				       std::vector<var *> &candidate_order) {
+	std::unordered_map<var *, std::vector<var *>> dependents;
+	std::vector<var *> memory_dependents;
+	for (auto v : candidate_order) {
+		rce_candidate &c = candidates[v];
+		for (auto r : c.reads)
+			dependents[r].push_back(v);
+		if (c.reads_memory)
+			memory_dependents.push_back(v);
+	}
+
+	std::unique_ptr<control_flow_graph> cfg = control_flow_graph::build(ast);
+	std::vector<basic_block *> order = cfg->reverse_postorder();
+	std::unordered_map<block *, std::vector<basic_block *>> node_blocks = find_node_blocks(order);
+	for (auto &c : candidates) {
+		auto it = node_blocks.find(c.second.decl.get());
+		if (it != node_blocks.end())
+			c.second.blocks = it->second;
+	}
+	std::vector<std::vector<unsigned int>> loops = find_cfg_loops(*cfg);
+
+	rce_substituter substituter;
+	substituter.candidates = &candidates;
+	substituter.dependents = &dependents;
+	substituter.memory_dependents = &memory_dependents;
+	substituter.counter = &counter;
+	rce_availability problem;
+	problem.substituter = &substituter;
+	for (auto v : candidate_order)
+		problem.all_candidates.insert(v);
+	dataflow_result<var_set> available = solve_dataflow(*cfg, problem);
+
+	// An init isn't moved into a loop its decl is outside of
+	std::vector<basic_block *> use_blocks;
+	substituter.substitute = [&](var *v) {
+		rce_candidate &c = candidates[v];
+		if (c.is_copy)
+			return true;
+		for (auto use : use_blocks) {
+			for (auto decl : c.blocks) {
+				if (!std::includes(loops[decl->id].begin(), loops[decl->id].end(), loops[use->id].begin(),
+						   loops[use->id].end()))
+					return false;
+			}
+		}
+		return true;
+	};
+
+	// Blocks are rewritten in reverse postorder so that the init of a decl
+	// is rewritten before it is substituted. A node in multiple places is
+	// rewritten last, with the candidates available in all of them
+	std::unordered_map<block *, var_set> shared_available;
+	std::vector<std::pair<block::Ptr, basic_block *>> shared_nodes;
+	for (auto bb : order) {
+		substituter.available = available.in[bb->id];
+		for (auto n : bb->nodes) {
+			std::vector<basic_block *> &n_blocks = node_blocks[n.get()];
+			if (n_blocks.size() == 1) {
+				use_blocks = n_blocks;
+				substitute_node(substituter, n, bb);
+				continue;
+			}
+			auto it = shared_available.find(n.get());
+			if (it == shared_available.end()) {
+				shared_available[n.get()] = substituter.available;
+				shared_nodes.push_back(std::make_pair(n, bb));
+			} else {
+				var_set both = problem.meet(it->second, substituter.available);
+				it->second = std::move(both);
+			}
+			std::function<bool(var *)> rewriting = std::move(substituter.substitute);
+			substituter.substitute = nullptr;
+			n->accept(&substituter);
+			substituter.substitute = std::move(rewriting);
+		}
+	}
+	for (auto &n : shared_nodes) {
+		substituter.available = shared_available[n.first.get()];
+		use_blocks = node_blocks[n.first.get()];
+		substitute_node(substituter, n.first, n.second);
+	}
+}
+
+// Assignments to local vars that are never read afterwards, with inits
+// that have no side effects, are removed, and so are the ifs left with
+// nothing in them
+class dead_store_remover: public block_visitor {
+public:
+	using block_visitor::visit;
+	std::unordered_set<stmt *> dead_stores;
+	virtual void visit(stmt_block::Ptr b) override {
+		std::vector<stmt::Ptr> new_stmts;
+		for (auto s : b->stmts) {
+			s->accept(this);
+			if (!dead_stores.count(s.get()) && !is_empty_if(s))
+				new_stmts.push_back(s);
+		}
+		b->stmts = new_stmts;
+	}
+
+private:
+	static bool is_empty_block(stmt::Ptr s) { return isa<stmt_block>(s) && to<stmt_block>(s)->stmts.empty(); }
+	bool is_empty_if(stmt::Ptr s) {
+		if (!isa<if_stmt>(s))
+			return false;
+		if_stmt::Ptr a = to<if_stmt>(s);
+		if (!is_empty_block(a->then_stmt) || !is_empty_block(a->else_stmt))
+			return false;
+		check_side_effects checker;
+		a->cond->accept(&checker);
+		return !checker.has_side_effects;
+	}
+};
+
+static void remove_dead_stores(stmt::Ptr ast) {
+	var_use_counter counter;
+	ast->accept(&counter);
+	std::unique_ptr<control_flow_graph> cfg = control_flow_graph::build(ast);
+	std::vector<basic_block *> order = cfg->reverse_postorder();
+	std::unordered_map<block *, std::vector<basic_block *>> node_blocks = find_node_blocks(order);
+	dataflow_result<var_set> liveness = compute_liveness(*cfg);
+
+	std::unordered_map<stmt *, unsigned int> dead_count;
+	std::vector<var *> defs, uses;
+	for (auto bb : order) {
+		var_set live = liveness.out[bb->id];
+		for (auto it = bb->nodes.rbegin(); it != bb->nodes.rend(); it++) {
+			block::Ptr n = *it;
+			if (isa<expr_stmt>(n) && isa<assign_expr>(to<expr_stmt>(n)->expr1)) {
+				assign_expr::Ptr assign = to<assign_expr>(to<expr_stmt>(n)->expr1);
+				if (isa<var_expr>(assign->var1)) {
+					var *v = to<var_expr>(assign->var1)->var1.get();
+					check_side_effects checker;
+					assign->expr1->accept(&checker);
+					// Vars that aren't declared in the function can be read outside of it
+					if (!live.count(v) && counter.declared_vars.count(v) &&
+					    !counter.address_taken_vars.count(v) && !checker.has_side_effects)
+						dead_count[to<stmt>(n).get()]++;
+				}
+			}
+			defs.clear();
+			uses.clear();
+			find_defs_and_uses(n, defs, uses);
+			for (auto v : defs)
+				live.erase(v);
+			live.insert(uses.begin(), uses.end());
+		}
+	}
+
+	dead_store_remover remover;
+	for (auto &d : dead_count) {
+		if (d.second == node_blocks[d.first].size())
+			remover.dead_stores.insert(d.first);
+	}
+	if (!remover.dead_stores.empty())
+		ast->accept(&remover);
+}
+
+// Deletes the decls that aren't used anymore, unless their init has side effects
 class rce_decl_deleter: public block_visitor {
 public:
 	using block_visitor::visit;
-	std::map<var::Ptr, uint64_t> usage_count;
-	virtual void visit(stmt_block::Ptr b) {
+	std::unordered_map<var *, uint64_t> *usage_count;
+	virtual void visit(stmt_block::Ptr b) override {
 		std::vector<stmt::Ptr> new_stmts;
 		for (auto stmt: b->stmts) {
-			if (isa<decl_stmt>(stmt)) {
-				var::Ptr v = to<decl_stmt>(stmt)->decl_var;
-				if (usage_count.find(v) != usage_count.end()) {
-					// TODO: ensure that we are not deleting decls who's RHS have side-effects
-					new_stmts.push_back(stmt);
-				}
-			} else {
+			if (!isa<decl_stmt>(stmt) || !is_removable(to<decl_stmt>(stmt)))
 				new_stmts.push_back(stmt);
-			}	
 			stmt->accept(this);
 		}
 		b->stmts = new_stmts;
-	}	
+	}
+
+private:
+	bool is_removable(decl_stmt::Ptr decl) {
+		if (usage_count->count(decl->decl_var.get()))
+			return false;
+		if (decl->init_expr == nullptr)
+			return true;
+		check_side_effects checker;
+		decl->init_expr->accept(&checker);
+		return !checker.has_side_effects;
+	}
 };
 
 
 void eliminate_redundant_vars(block::Ptr ast) {
+	if (!isa<stmt>(ast))
+		return;
 	var_use_counter counter;
 	ast->accept(&counter);
 	gather_rce_decls gatherer;
-	gatherer.usage_count = counter.usage_count;
-	gatherer.assigned_vars = counter.assigned_vars;
-	ast->accept(&gatherer);	
-	
-	replace_rce_vars replacer;	
+	gatherer.counter = &counter;
+	ast->accept(&gatherer);
+
+	// The decls are gathered in order, the inits substituted into a
+	// candidate's init are known before it
+	std::unordered_map<var *, rce_candidate> candidates;
+	std::vector<var *> candidate_order;
 	for (auto decl: gatherer.gathered_decls) {
-		var::Ptr v = decl->decl_var;
-		
-		if (!isa<var_expr>(decl->init_expr) && std::find(gatherer.duplicated_vars.begin(), gatherer.duplicated_vars.end(), v) 
-			!= gatherer.duplicated_vars.end()) 
+		var *v = decl->decl_var.get();
+		bool is_copy = isa<var_expr>(decl->init_expr);
+		if (!is_copy && gatherer.duplicated_vars.count(v))
 			continue;
-		replacer.gathered_decls.push_back(decl);
-		replacer.var_decl_map[v] = decl;		
+		rce_candidate &c = candidates[v];
+		c.decl = decl;
+		c.is_copy = is_copy;
+		read_finder finder;
+		finder.counter = &counter;
+		decl->init_expr->accept(&finder);
+		// The passes run on the body, args look like globals. A copy of a
+		// var that is never assigned or pointed to keeps its value anyway
+		var *copied = is_copy ? to<var_expr>(decl->init_expr)->var1.get() : nullptr;
+		c.reads_memory = finder.reads_memory && !(copied && !counter.assigned_vars.count(copied) &&
+							   !counter.address_taken_vars.count(copied));
+		std::unordered_set<var *> reads;
+		for (auto r : finder.read_vars) {
+			reads.insert(r);
+			auto it = candidates.find(r);
+			if (it == candidates.end() || r == v)
+				continue;
+			reads.insert(it->second.reads.begin(), it->second.reads.end());
+			c.reads_memory = c.reads_memory || it->second.reads_memory;
+		}
+		c.reads.assign(reads.begin(), reads.end());
+		candidate_order.push_back(v);
 	}
-	ast->accept(&replacer);	
+	substitute_available_decls(to<stmt>(ast), counter, candidates, candidate_order);
+	remove_dead_stores(to<stmt>(ast));
+
 	// Now that all th replacements have been done, we will decls that are not used
 	var_use_counter post_counter;
 	ast->accept(&post_counter);
 
 	rce_decl_deleter deleter;
-	deleter.usage_count = post_counter.usage_count;
-	ast->accept(&deleter);	
+	deleter.usage_count = &post_counter.usage_count;
+	ast->accept(&deleter);
 }
 
 }
@@ -0,0 +1,337 @@
+#include "blocks/shared_tail.h"
+#include "blocks/block_visitor.h"
+#include "blocks/c_code_generator.h"
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace block {
+
+// The vars a tail reads and writes in visit order, and the ones it declares
+class tail_var_collector : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::vector<var *> vars;
+	std::unordered_set<var *> declared;
+	bool has_jump = false;
+	virtual void visit(var_expr::Ptr a) override { vars.push_back(a->var1.get()); }
+	virtual void visit(decl_stmt::Ptr a) override {
+		vars.push_back(a->decl_var.get());
+		declared.insert(a->decl_var.get());
+		if (a->init_expr != nullptr)
+			a->init_expr->accept(this);
+	}
+	// Labels can't be duplicated and a goto could cross into a scope
+	virtual void visit(label_stmt::Ptr) override { has_jump = true; }
+	virtual void visit(goto_stmt::Ptr) override { has_jump = true; }
+};
+
+class decl_collector : public block_visitor {
+public:
+	using block_visitor::visit;
+	std::unordered_set<var *> declared;
+	virtual void visit(decl_stmt::Ptr a) override {
+		declared.insert(a->decl_var.get());
+		block_visitor::visit(a);
+	}
+};
+
+class stmt_info {
+public:
+	unsigned long long hash;
+	unsigned long long bytes;
+	bool has_jump;
+};
+
+// A suffix of a block at the end of the function, falling off the end of
+// the block returns from the function
+class tail_site {
+public:
+	// The blocks from the body of the function down to the one the tail is in
+	std::vector<stmt_block::Ptr> path;
+	unsigned int index;
+	unsigned long long hash = 0;
+	unsigned long long bytes = 0;
+	bool has_jump = false;
+
+	stmt_block::Ptr block(void) const { return path.back(); }
+	unsigned int size(void) const { return block()->stmts.size() - index; }
+	stmt::Ptr first(void) const { return block()->stmts[index]; }
+};
+
+static unsigned long long generated_bytes(stmt::Ptr s) {
+	std::ostringstream oss;
+	c_code_generator::generate_code(s, oss, 0);
+	return oss.str().size();
+}
+
+class tail_sharer {
+public:
+	stmt_block::Ptr body;
+	std::vector<var::Ptr> args;
+	unsigned long long min_bytes;
+	shared_tail_stats stats;
+
+	bool share_one(void);
+
+private:
+	std::unordered_map<stmt *, stmt_info> infos;
+	std::unordered_map<stmt_block *, unsigned int> block_visits;
+	std::vector<tail_site> sites;
+
+	const stmt_info &info(stmt::Ptr s);
+	void collect_sites(stmt_block::Ptr b, std::vector<stmt_block::Ptr> &path);
+	bool same_tail(const tail_site &a, const tail_site &b);
+	bool apply(const std::vector<unsigned int> &group);
+};
+
+const stmt_info &tail_sharer::info(stmt::Ptr s) {
+	auto it = infos.find(s.get());
+	if (it != infos.end())
+		return it->second;
+	tail_var_collector collector;
+	s->accept(&collector);
+	stmt_info &i = infos[s.get()];
+	i.hash = s->structural_hash();
+	i.bytes = generated_bytes(s);
+	i.has_jump = collector.has_jump;
+	return i;
+}
+
+void tail_sharer::collect_sites(stmt_block::Ptr b, std::vector<stmt_block::Ptr> &path) {
+	path.push_back(b);
+	// A block memoization shares between two paths is visited twice
+	if (block_visits[b.get()]++ == 0) {
+		unsigned int first_site = sites.size();
+		for (unsigned int i = 0; i < b->stmts.size(); i++) {
+			tail_site site;
+			site.path = path;
+			site.index = i;
+			sites.push_back(site);
+		}
+		// Hashes and sizes of the suffixes, from the back
+		for (unsigned int i = b->stmts.size(); i-- > 0;) {
+			const stmt_info &s = info(b->stmts[i]);
+			tail_site &site = sites[first_site + i];
+			site.hash = s.hash;
+			site.bytes = s.bytes;
+			site.has_jump = s.has_jump;
+			if (i + 1 < b->stmts.size()) {
+				tail_site &next = sites[first_site + i + 1];
+				site.hash = site.hash * 31 + next.hash;
+				site.bytes += next.bytes;
+				site.has_jump = site.has_jump || next.has_jump;
+			}
+		}
+		if (b->stmts.size() > 0 && isa<if_stmt>(b->stmts.back())) {
+			if_stmt::Ptr last = to<if_stmt>(b->stmts.back());
+			if (isa<stmt_block>(last->then_stmt))
+				collect_sites(to<stmt_block>(last->then_stmt), path);
+			if (isa<stmt_block>(last->else_stmt))
+				collect_sites(to<stmt_block>(last->else_stmt), path);
+		}
+	}
+	path.pop_back();
+}
+
+bool tail_sharer::same_tail(const tail_site &a, const tail_site &b) {
+	if (a.hash != b.hash || a.size() != b.size())
+		return false;
+	for (unsigned int i = 0; i < a.size(); i++) {
+		stmt::Ptr s1 = a.block()->stmts[a.index + i];
+		stmt::Ptr s2 = b.block()->stmts[b.index + i];
+		if (s1 == s2)
+			continue;
+		if (!is_same_fast(s1, s2))
+			return false;
+		// is_same only compares the static offsets of the vars
+		tail_var_collector c1, c2;
+		s1->accept(&c1);
+		s2->accept(&c2);
+		if (c1.vars != c2.vars)
+			return false;
+	}
+	return true;
+}
+
+static bool falls_through(stmt::Ptr s) {
+	if (isa<stmt_block>(s)) {
+		stmt_block::Ptr b = to<stmt_block>(s);
+		return b->stmts.size() == 0 || falls_through(b->stmts.back());
+	}
+	if (isa<if_stmt>(s))
+		return falls_through(to<if_stmt>(s)->then_stmt) || falls_through(to<if_stmt>(s)->else_stmt);
+	return !isa<return_stmt>(s) && !isa<goto_stmt>(s);
+}
+
+static bool has_decl(const std::vector<stmt::Ptr> &stmts, unsigned int end) {
+	for (unsigned int i = 0; i < end; i++) {
+		if (isa<decl_stmt>(stmts[i]))
+			return true;
+	}
+	return false;
+}
+
+bool tail_sharer::apply(const std::vector<unsigned int> &group) {
+	const tail_site &rep = sites[group[0]];
+	// The deepest block that contains all the copies, the copies are all
+	// below its last statement
+	unsigned int common = rep.path.size();
+	for (auto i : group) {
+		const tail_site &site = sites[i];
+		unsigned int j = 0;
+		while (j < common && j < site.path.size() && site.path[j] == rep.path[j])
+			j++;
+		common = j;
+	}
+	for (auto i : group) {
+		if (sites[i].path.size() <= common)
+			return false;
+	}
+	stmt_block::Ptr common_block = rep.path[common - 1];
+
+	// The vars the tail doesn't declare itself have to be declared above the
+	// common block to be in scope for every copy
+	tail_var_collector used;
+	for (unsigned int i = rep.index; i < rep.block()->stmts.size(); i++)
+		rep.block()->stmts[i]->accept(&used);
+	decl_collector all_decls;
+	body->accept(&all_decls);
+	std::unordered_set<var *> visible;
+	for (auto a : args)
+		visible.insert(a.get());
+	for (unsigned int i = 0; i < common; i++) {
+		for (auto s : rep.path[i]->stmts) {
+			if (isa<decl_stmt>(s))
+				visible.insert(to<decl_stmt>(s)->decl_var.get());
+		}
+	}
+	for (auto v : used.vars) {
+		// Vars declared nowhere in the function are globals
+		if (used.declared.count(v) == 0 && all_decls.declared.count(v) != 0 && visible.count(v) == 0)
+			return false;
+	}
+
+	// Keep the first copy that can be jumped to without skipping a declaration
+	int kept = -1;
+	for (auto i : group) {
+		const tail_site &site = sites[i];
+		bool skips_decl = has_decl(site.block()->stmts, site.index);
+		for (unsigned int j = common; j + 1 < site.path.size(); j++)
+			skips_decl = skips_decl || has_decl(site.path[j]->stmts, site.path[j]->stmts.size() - 1);
+		if (!skips_decl) {
+			kept = i;
+			break;
+		}
+	}
+	// Otherwise the tail moves after the last statement of the common block,
+	// which works if control can't fall off that statement
+	if (kept == -1 && falls_through(common_block->stmts.back()))
+		return false;
+
+	label::Ptr new_label = make_node<label>();
+	new_label->label_name = "shared_tail" + std::to_string(stats.tails_shared);
+	label_stmt::Ptr new_label_stmt = make_node<label_stmt>();
+	new_label_stmt->label1 = new_label;
+	goto_stmt::Ptr jump = make_node<goto_stmt>();
+	jump->label1 = new_label;
+
+	long long saved = (long long)(group.size() - 1) * (rep.bytes - generated_bytes(jump)) - generated_bytes(new_label_stmt);
+	if (saved <= 0)
+		return false;
+
+	std::vector<stmt::Ptr> tail(rep.block()->stmts.begin() + rep.index, rep.block()->stmts.end());
+	for (auto i : group) {
+		const tail_site &site = sites[i];
+		std::vector<stmt::Ptr> &stmts = site.block()->stmts;
+		if ((int)i == kept) {
+			stmts.insert(stmts.begin() + site.index, new_label_stmt);
+			continue;
+		}
+		stmts.resize(site.index);
+		goto_stmt::Ptr g = make_node<goto_stmt>();
+		g->label1 = new_label;
+		stmts.push_back(g);
+	}
+	if (kept == -1) {
+		common_block->stmts.push_back(new_label_stmt);
+		common_block->stmts.insert(common_block->stmts.end(), tail.begin(), tail.end());
+	}
+	stats.tails_shared++;
+	stats.bytes_saved += saved;
+	return true;
+}
+
+bool tail_sharer::share_one(void) {
+	// The blocks changed since the hashes were computed
+	invalidate_structural_hashes();
+	infos.clear();
+	block_visits.clear();
+	sites.clear();
+	std::vector<stmt_block::Ptr> path;
+	collect_sites(body, path);
+
+	std::vector<std::vector<unsigned int>> groups;
+	std::unordered_map<unsigned long long, std::vector<unsigned int>> groups_by_hash;
+	for (unsigned int i = 0; i < sites.size(); i++) {
+		const tail_site &site = sites[i];
+		if (site.bytes < min_bytes || site.has_jump)
+			continue;
+		// A label can't be followed by a declaration in C
+		if (isa<decl_stmt>(site.first()))
+			continue;
+		bool shared_block = false;
+		for (auto b : site.path)
+			shared_block = shared_block || block_visits[b.get()] > 1;
+		if (shared_block)
+			continue;
+		bool found = false;
+		for (auto g : groups_by_hash[site.hash]) {
+			if (same_tail(sites[groups[g][0]], site)) {
+				groups[g].push_back(i);
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			groups_by_hash[site.hash].push_back(groups.size());
+			groups.push_back(std::vector<unsigned int>(1, i));
+		}
+	}
+
+	// The longest tails with the most copies first, the shorter tails they
+	// contain are shared with them
+	std::vector<unsigned int> order;
+	for (unsigned int g = 0; g < groups.size(); g++) {
+		if (groups[g].size() > 1)
+			order.push_back(g);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		return (groups[a].size() - 1) * sites[groups[a][0]].bytes > (groups[b].size() - 1) * sites[groups[b][0]].bytes;
+	});
+	for (auto g : order) {
+		if (apply(groups[g]))
+			return true;
+	}
+	return false;
+}
+
+shared_tail_stats share_tails(stmt::Ptr ast, unsigned long long min_bytes) {
+	tail_sharer sharer;
+	sharer.min_bytes = min_bytes;
+	if (isa<func_decl>(ast)) {
+		sharer.body = to<stmt_block>(to<func_decl>(ast)->body);
+		sharer.args = to<func_decl>(ast)->args;
+	} else if (isa<stmt_block>(ast)) {
+		sharer.body = to<stmt_block>(ast);
+	} else {
+		return sharer.stats;
+	}
+	while (sharer.share_one())
+		;
+	return sharer.stats;
+}
+
+} // namespace block
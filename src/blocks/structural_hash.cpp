@@ -0,0 +1,211 @@
+#include "blocks/block_visitor.h"
+#include "blocks/stmt.h"
+#include <typeinfo>
+
+namespace block {
+
+std::atomic<unsigned long long> structural_hash_generation(1);
+void invalidate_structural_hashes(void) {
+	structural_hash_generation++;
+}
+
+static inline unsigned long long mix_hash(unsigned long long h, unsigned long long v) {
+	h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	h ^= h >> 31;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 29;
+	return h;
+}
+static inline unsigned long long hash_string(unsigned long long h, const std::string &s) {
+	return mix_hash(h, std::hash<std::string>()(s));
+}
+static inline unsigned long long hash_tag(unsigned long long h, const tracer::tag &t) {
+	return mix_hash(mix_hash(h, t.hash_high), t.hash_low);
+}
+static inline unsigned long long hash_child(unsigned long long h, block::Ptr b) {
+	return mix_hash(h, b == nullptr ? 0 : b->structural_hash());
+}
+
+// Mirrors the is_same of every block, it should hash exactly what is compared
+class structural_hasher : public block_visitor {
+public:
+	using block_visitor::visit;
+	unsigned long long hash = 0;
+
+	// The kind is part of the hash wherever is_same checks the type of the other block
+	void start(block::Ptr b) { hash = mix_hash(0, typeid(*b).hash_code()); }
+	void unary(unary_expr::Ptr e) {
+		start(e);
+		hash = hash_child(hash, e->expr1);
+	}
+	void binary(binary_expr::Ptr e) {
+		start(e);
+		hash = hash_child(hash, e->expr1);
+		hash = hash_child(hash, e->expr2);
+	}
+	// Blocks that use the base is_same only compare the tags
+	void offset_only(block::Ptr b) { hash = hash_tag(0, b->static_offset); }
+
+	virtual void visit(block::Ptr b) override { offset_only(b); }
+	virtual void visit(expr::Ptr e) override { offset_only(e); }
+	virtual void visit(unary_expr::Ptr e) override { unary(e); }
+	virtual void visit(binary_expr::Ptr e) override { binary(e); }
+	virtual void visit(not_expr::Ptr e) override { unary(e); }
+	virtual void visit(and_expr::Ptr e) override { binary(e); }
+	virtual void visit(bitwise_and_expr::Ptr e) override { binary(e); }
+	virtual void visit(or_expr::Ptr e) override { binary(e); }
+	virtual void visit(bitwise_or_expr::Ptr e) override { binary(e); }
+	virtual void visit(plus_expr::Ptr e) override { binary(e); }
+	virtual void visit(minus_expr::Ptr e) override { binary(e); }
+	virtual void visit(mul_expr::Ptr e) override { binary(e); }
+	virtual void visit(div_expr::Ptr e) override { binary(e); }
+	virtual void visit(lt_expr::Ptr e) override { binary(e); }
+	virtual void visit(gt_expr::Ptr e) override { binary(e); }
+	virtual void visit(lte_expr::Ptr e) override { binary(e); }
+	virtual void visit(gte_expr::Ptr e) override { binary(e); }
+	virtual void visit(lshift_expr::Ptr e) override { binary(e); }
+	virtual void visit(rshift_expr::Ptr e) override { binary(e); }
+	virtual void visit(equals_expr::Ptr e) override { binary(e); }
+	virtual void visit(ne_expr::Ptr e) override { binary(e); }
+	virtual void visit(mod_expr::Ptr e) override { binary(e); }
+	virtual void visit(var_expr::Ptr e) override {
+		start(e);
+		hash = hash_child(hash, e->var1);
+	}
+	virtual void visit(const_expr::Ptr e) override { start(e); }
+	virtual void visit(int_const::Ptr e) override {
+		start(e);
+		hash = mix_hash(hash, (unsigned long long)e->value);
+	}
+	virtual void visit(double_const::Ptr e) override {
+		start(e);
+		hash = mix_hash(hash, std::hash<double>()(e->value));
+	}
+	virtual void visit(float_const::Ptr e) override {
+		start(e);
+		hash = mix_hash(hash, std::hash<float>()(e->value));
+	}
+	virtual void visit(string_const::Ptr e) override {
+		start(e);
+		hash = hash_string(hash, e->value);
+	}
+	virtual void visit(assign_expr::Ptr e) override {
+		start(e);
+		hash = hash_child(hash, e->var1);
+		hash = hash_child(hash, e->expr1);
+	}
+	virtual void visit(sq_bkt_expr::Ptr e) override {
+		start(e);
+		hash = hash_child(hash, e->var_expr);
+		hash = hash_child(hash, e->index);
+	}
+	virtual void visit(function_call_expr::Ptr e) override {
+		start(e);
+		hash = hash_child(hash, e->expr1);
+		for (auto a : e->args)
+			hash = hash_child(hash, a);
+	}
+	virtual void visit(initializer_list_expr::Ptr e) override {
+		start(e);
+		for (auto a : e->elems)
+			hash = hash_child(hash, a);
+	}
+	// The inner expression of a foreign_expr can only be compared with ==
+	virtual void visit(foreign_expr_base::Ptr e) override { start(e); }
+	virtual void visit(member_access_expr::Ptr e) override {
+		start(e);
+		hash = hash_child(hash, e->parent_expr);
+		hash = hash_string(hash, e->member_name);
+	}
+	// is_same doesn't look at the operand
+	virtual void visit(addr_of_expr::Ptr e) override { start(e); }
+
+	virtual void visit(stmt::Ptr s) override { start(s); }
+	virtual void visit(expr_stmt::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->expr1);
+	}
+	virtual void visit(stmt_block::Ptr s) override {
+		start(s);
+		hash = mix_hash(hash, s->stmts.size());
+		for (auto a : s->stmts)
+			hash = hash_child(hash, a);
+	}
+	virtual void visit(decl_stmt::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->decl_var);
+		hash = hash_child(hash, s->init_expr);
+	}
+	virtual void visit(if_stmt::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->cond);
+		hash = hash_child(hash, s->then_stmt);
+		hash = hash_child(hash, s->else_stmt);
+	}
+	virtual void visit(label::Ptr l) override {
+		start(l);
+		hash = hash_string(hash, l->label_name);
+	}
+	virtual void visit(label_stmt::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->label1);
+	}
+	// Gotos without a label are all the same
+	virtual void visit(goto_stmt::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->label1);
+	}
+	virtual void visit(while_stmt::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->body);
+		hash = hash_child(hash, s->cond);
+	}
+	virtual void visit(for_stmt::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->decl_stmt);
+		hash = hash_child(hash, s->cond);
+		hash = hash_child(hash, s->update);
+		hash = hash_child(hash, s->body);
+	}
+	virtual void visit(break_stmt::Ptr s) override { start(s); }
+	virtual void visit(continue_stmt::Ptr s) override { start(s); }
+	virtual void visit(func_decl::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->return_type);
+		hash = mix_hash(hash, s->args.size());
+		for (auto a : s->args)
+			hash = hash_child(hash, a->var_type);
+		hash = hash_child(hash, s->body);
+	}
+	virtual void visit(return_stmt::Ptr s) override {
+		start(s);
+		hash = hash_child(hash, s->return_val);
+	}
+
+	// Vars are compared by their tags
+	virtual void visit(var::Ptr v) override {
+		start(v);
+		hash = hash_tag(hash, v->static_offset);
+	}
+	virtual void visit(type::Ptr t) override { offset_only(t); }
+	virtual void visit(scalar_type::Ptr t) override { offset_only(t); }
+	virtual void visit(pointer_type::Ptr t) override { offset_only(t); }
+	virtual void visit(function_type::Ptr t) override { offset_only(t); }
+	virtual void visit(array_type::Ptr t) override { offset_only(t); }
+	virtual void visit(builder_var_type::Ptr t) override { offset_only(t); }
+	virtual void visit(named_type::Ptr t) override { offset_only(t); }
+};
+
+unsigned long long block::structural_hash(void) {
+	unsigned long long generation = structural_hash_generation.load(std::memory_order_acquire);
+	if (cached_hash_generation.load(std::memory_order_acquire) == generation)
+		return cached_hash.load(std::memory_order_relaxed);
+	structural_hasher hasher;
+	shared_from_this()->accept(&hasher);
+	// Blocks can be hashed by multiple threads, they all compute the same value
+	cached_hash.store(hasher.hash, std::memory_order_relaxed);
+	cached_hash_generation.store(generation, std::memory_order_release);
+	return hasher.hash;
+}
+
+} // namespace block
@@ -3,7 +3,7 @@
 namespace block {
 
 void var_namer::visit(decl_stmt::Ptr stmt) {
-	std::string so = stmt->decl_var->static_offset.stringify();
+	tracer::tag so = stmt->decl_var->static_offset;
 	if (collected_decls.find(so) != collected_decls.end()) {
 		// This decl has been seen before, and needs to be marked for hoisting
 		decls_to_hoist[so] = stmt;
@@ -25,22 +25,22 @@ void var_namer::visit(decl_stmt::Ptr stmt) {
 }
 
 void var_replacer::visit(var_expr::Ptr a) {
-	std::string so = a->var1->static_offset.stringify();
+	tracer::tag so = a->var1->static_offset;
 	if (collected_decls.find(so) != collected_decls.end()) {
 		a->var1 = collected_decls[so];
 	}
 }
 
 void var_hoister::visit(decl_stmt::Ptr a) {
-	std::string so = a->decl_var->static_offset.stringify();
+	tracer::tag so = a->decl_var->static_offset;
 	if (decls_to_hoist.find(so) != decls_to_hoist.end()) {
 		// This decl needs to be flattened into an assignment
 		// but if it doesn't have an init_expr, just make a simple var_expr
-		expr_stmt::Ptr estmt = std::make_shared<expr_stmt>();
+		expr_stmt::Ptr estmt = make_node<expr_stmt>();
 		estmt->static_offset = a->static_offset;
 		estmt->annotation = a->annotation;
 
-		var_expr::Ptr vexpr = std::make_shared<var_expr>();
+		var_expr::Ptr vexpr = make_node<var_expr>();
 		vexpr->static_offset = a->static_offset;
 		vexpr->var1 = a->decl_var;
 
@@ -48,7 +48,7 @@ void var_hoister::visit(decl_stmt::Ptr a) {
 			estmt->expr1 = vexpr;
 		       	return;
 		} else {
-			assign_expr::Ptr assign = std::make_shared<assign_expr>();
+			assign_expr::Ptr assign = make_node<assign_expr>();
 			assign->static_offset = a->static_offset;
 				
 			assign->var1 = vexpr;
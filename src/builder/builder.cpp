@@ -27,7 +27,7 @@ void create_return_stmt(const builder &a) {
 	if (builder_context::current_builder_context->bool_vector.size() > 0)
 		return;
 	block::return_stmt::Ptr ret_stmt =
-	    std::make_shared<block::return_stmt>();
+	    block::make_node<block::return_stmt>();
 	//ret_stmt->static_offset = a.block_expr->static_offset;
 	// Finding conflicts between return statements is somehow really hard. 
 	// So treat each return statement as different. This is okay, because a 
@@ -49,7 +49,7 @@ builder::builder(const var &a) {
 		assert(a.parent_var != nullptr);
 		builder parent_expr_builder = (builder)(*a.parent_var);		
 		
-		block::member_access_expr::Ptr member = std::make_shared<block::member_access_expr>();
+		block::member_access_expr::Ptr member = block::make_node<block::member_access_expr>();
 		member->parent_expr = parent_expr_builder.block_expr;
 		builder_context::current_builder_context->remove_node_from_sequence(member->parent_expr);
 		member->member_name = a.var_name;
@@ -63,7 +63,7 @@ builder::builder(const var &a) {
 		// It should be removed when it is used
 	} else if (a.current_state == var::standalone_var) {
 		assert(a.block_var != nullptr);
-		block::var_expr::Ptr var_expr = std::make_shared<block::var_expr>();
+		block::var_expr::Ptr var_expr = block::make_node<block::var_expr>();
 		var_expr->static_offset = offset;
 
 		var_expr->var1 = a.block_var;
@@ -1,28 +1,33 @@
 #include "builder/builder_context.h"
-#include "blocks/for_loop_finder.h"
-#include "blocks/label_inserter.h"
-#include "blocks/loop_finder.h"
-#include "blocks/if_switcher.h"
-#include "blocks/loop_roll.h"
-#include "blocks/var_namer.h"
-#include "blocks/rce.h"
+#include "blocks/block_serializer.h"
+#include "blocks/shared_tail.h"
 #include "builder/builder.h"
 #include "builder/exceptions.h"
 #include "builder/dyn_var.h"
+#include "builder/memoization_cache.h"
 #include "util/tracer.h"
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <new>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 
 namespace builder {
-builder_context *builder_context::current_builder_context = nullptr;
+thread_local builder_context *builder_context::current_builder_context = nullptr;
 
-int builder_context::debug_creation_counter = 0;
+std::atomic<int> builder_context::debug_creation_counter(0);
 
 void builder_context::add_stmt_to_current_block(block::stmt::Ptr s,
 						bool check_for_conflicts) {
 	if (bool_vector.size() > 0) {
 		return;
 	}
+	wait_for_preceding_path();
 	if (current_label != "") {
 		s->annotation = current_label;
 		current_label = "";
@@ -32,13 +37,13 @@ void builder_context::add_stmt_to_current_block(block::stmt::Ptr s,
 
 		throw LoopBackException(s->static_offset);
 	}
-	std::string tag_string = s->static_offset.stringify();
-	if (use_memoization && memoized_tags->map.find(tag_string) != memoized_tags->map.end() &&
+	std::lock_guard<std::recursive_mutex> memoization_guard(memoized_tags->lock);
+	if (use_memoization && memoized_tags->map.find(s->static_offset) != memoized_tags->map.end() &&
 	    check_for_conflicts && bool_vector.size() == 0) {
 		// This tag has been seen on some other execution. We can reuse.
 		// First find the tag -
 
-		block::stmt_block::Ptr parent = memoized_tags->map[tag_string];
+		block::stmt_block::Ptr parent = memoized_tags->map[s->static_offset];
 		unsigned int i = 0;
 		for (i = 0; i < parent->stmts.size(); i++) {
 			if (parent->stmts[i]->static_offset == s->static_offset)
@@ -52,15 +57,19 @@ void builder_context::add_stmt_to_current_block(block::stmt::Ptr s,
 			block::expr_stmt::Ptr expr =
 			    block::to<block::expr_stmt>(s);
 
-			if (p_stmt->cond->is_same(expr->expr1))
+			if (block::is_same_fast(p_stmt->cond, expr->expr1))
 				throw MemoizationException(s->static_offset,
 							   parent, i);
 		}
 
-		if (parent->stmts[i]->is_same(s))
+		if (block::is_same_fast(parent->stmts[i], s))
 			throw MemoizationException(s->static_offset, parent, i);
+		// The caller can still fill in parts of s (like the init of a decl)
+		s->invalidate_structural_hash();
 	}
-	visited_offsets.insert(s->static_offset.stringify());
+	if (use_memoization && check_for_conflicts)
+		stats->memoization_misses++;
+	visited_offsets.insert(s->static_offset);
 	current_block_stmt->stmts.push_back(s);
 }
 tracer::tag get_offset_in_function(void) {
@@ -72,24 +81,55 @@ builder_context::~builder_context() {
 		delete assume_variables[i];
 	}
 }
+unsigned int builder_context::push_static_var(const unsigned char *ptr, uint32_t size) {
+	static_var_tuples.push_back(tracking_tuple(ptr, size));
+	update_static_var(static_var_tuples.size() - 1);
+	return static_var_tuples.size() - 1;
+}
+void builder_context::pop_static_var(void) {
+	tracking_tuple &tuple = static_var_tuples.back();
+	static_var_hash_high -= tuple.hash_high;
+	static_var_hash_low -= tuple.hash_low;
+	static_var_tuples.pop_back();
+}
+void builder_context::update_static_var(unsigned int index) {
+	tracking_tuple &tuple = static_var_tuples[index];
+	static_var_hash_high -= tuple.hash_high;
+	static_var_hash_low -= tuple.hash_low;
+	tracer::hash_static_var(tuple.ptr, tuple.size, index, tuple.hash_high, tuple.hash_low);
+	static_var_hash_high += tuple.hash_high;
+	static_var_hash_low += tuple.hash_low;
+}
+void builder_context::escape_static_var(unsigned int index) {
+	static_var_tuples[index].escaped = true;
+	has_escaped_static_vars = true;
+}
+void builder_context::update_escaped_static_vars(void) {
+	for (unsigned int i = 0; i < static_var_tuples.size(); i++) {
+		if (static_var_tuples[i].escaped)
+			update_static_var(i);
+	}
+}
 bool builder_context::is_visited_tag(tracer::tag &new_tag) {
-	if (visited_offsets.find(new_tag.stringify()) != visited_offsets.end())
-		return true;
-	return false;
+	return visited_offsets.contains(new_tag);
 }
 void builder_context::erase_tag(tracer::tag &erase_tag) {
-	visited_offsets.erase(erase_tag.stringify());
+	visited_offsets.erase(erase_tag);
 }
 void builder_context::commit_uncommitted(void) {
 	for (auto block_ptr : uncommitted_sequence) {
-		block::expr_stmt::Ptr s = std::make_shared<block::expr_stmt>();
+		if (block_ptr == nullptr)
+			continue;
+		block::expr_stmt::Ptr s = block::make_node<block::expr_stmt>();
 		assert(block::isa<block::expr>(block_ptr));
 		s->static_offset = block_ptr->static_offset;
 		s->expr1 = block::to<block::expr>(block_ptr);
 		assert(current_block_stmt != nullptr);
+		committed_exprs[block_ptr.get()] = s;
 		add_stmt_to_current_block(s);
 	}
 	uncommitted_sequence.clear();
+	uncommitted_index.clear();
 }
 void builder_context::remove_node_from_sequence(block::expr::Ptr e) {	
 	// At this point, there is a chance a statement _might_ have been committed if 
@@ -99,27 +139,30 @@ void builder_context::remove_node_from_sequence(block::expr::Ptr e) {
 	// unexpected side effects, so we are going to do a clean up just to be sure
 	// So we will check if the expr that we are trying to delete is in the uncommitted 
 	// sequence, if not we will try to find for it in the committed expressions
-	if (std::find(uncommitted_sequence.begin(), uncommitted_sequence.end(), e) != uncommitted_sequence.end()) {
-		uncommitted_sequence.remove(e);
-	} else {
-		// Could be committed already
-		// It is safe to update the parent block here, because the memoization doesn't care about indices
-		std::vector<block::stmt::Ptr> new_stmts;
-		for (auto stmt: current_block_stmt->stmts) {
-			bool found = false;
-			if (block::isa<block::expr_stmt>(stmt)) {
-				auto expr_s = block::to<block::expr_stmt>(stmt);
-				if (expr_s->expr1 == e)
-					found = true;
-			}
-			if (!found)
-				new_stmts.push_back(stmt);	
+	auto it = uncommitted_index.find(e.get());
+	if (it != uncommitted_index.end()) {
+		uncommitted_sequence[it->second] = nullptr;
+		uncommitted_index.erase(it);
+		return;
+	}
+	// Could be committed already
+	// It is safe to update the parent block here, because the memoization doesn't care about indices
+	auto committed = committed_exprs.find(e.get());
+	if (committed == committed_exprs.end())
+		return;
+	block::stmt::Ptr s = committed->second;
+	committed_exprs.erase(committed);
+	// The statement is usually one of the last ones in the block
+	std::vector<block::stmt::Ptr> &stmts = current_block_stmt->stmts;
+	for (size_t i = stmts.size(); i > 0; i--) {
+		if (stmts[i - 1] == s) {
+			stmts.erase(stmts.begin() + (i - 1));
+			break;
 		}
-		current_block_stmt->stmts = new_stmts;
 	}
-	
 }
 void builder_context::add_node_to_sequence(block::expr::Ptr e) {
+	uncommitted_index[e.get()] = uncommitted_sequence.size();
 	uncommitted_sequence.push_back(e);
 }
 
@@ -128,11 +171,12 @@ bool get_next_bool_from_context(builder_context *context,
 	context->commit_uncommitted();
 	if (context->bool_vector.size() == 0) {
 		tracer::tag offset = expr->static_offset;
+		bool forked_value;
+		if (context->shared_fork_state != nullptr && context->explore_forked_paths(forked_value))
+			return forked_value;
 		throw OutOfBoolsException(offset);
 	}
-	bool ret_val = context->bool_vector.back();
-	context->bool_vector.pop_back();
-	return ret_val;
+	return context->bool_vector.take_next();
 }
 
 static void trim_ast_at_offset(block::stmt::Ptr ast, tracer::tag offset) {
@@ -165,7 +209,7 @@ trim_common_from_back(block::stmt::Ptr ast1, block::stmt::Ptr ast2) {
 		while (1) {
 			if (ast1_stmts.size() == 0 || ast2_stmts.size() == 0)
 				break;
-			if (ast1_stmts.back()->static_offset != ast2_stmts.back()->static_offset || !ast1_stmts.back()->is_same(ast2_stmts.back())) {
+			if (ast1_stmts.back()->static_offset != ast2_stmts.back()->static_offset || !block::is_same_fast(ast1_stmts.back(), ast2_stmts.back())) {
 				// There is a special case where there could be
 				// an if stmt with same body but different
 				// conditions We handle that by splitting the
@@ -179,11 +223,11 @@ trim_common_from_back(block::stmt::Ptr ast1, block::stmt::Ptr ast2) {
 						ast1_stmts.pop_back();
 						ast2_stmts.pop_back();
 
-						block::var::Ptr cond_var = std::make_shared<block::var>();
+						block::var::Ptr cond_var = block::make_node<block::var>();
 						cond_var->var_type = type_extractor<int>::extract_type();
 						cond_var->static_offset = tracer::get_unique_tag();
 
-						block::decl_stmt::Ptr decl_stmt = std::make_shared<block::decl_stmt>();
+						block::decl_stmt::Ptr decl_stmt = block::make_node<block::decl_stmt>();
 						decl_stmt->static_offset = if1->static_offset;
 
 						decl_stmt->decl_var = cond_var;
@@ -191,12 +235,12 @@ trim_common_from_back(block::stmt::Ptr ast1, block::stmt::Ptr ast2) {
 
 						split_decls.push_back(decl_stmt);
 
-						block::expr_stmt::Ptr stmt1 = std::make_shared<block::expr_stmt>();
+						block::expr_stmt::Ptr stmt1 = block::make_node<block::expr_stmt>();
 						stmt1->static_offset = if1->static_offset;
 						block::assign_expr::Ptr assign1 = 
-							std::make_shared<block::assign_expr>();
+							block::make_node<block::assign_expr>();
 						assign1->static_offset = if1->static_offset;
-						block::var_expr::Ptr varexpr1 = std::make_shared<block::var_expr>();
+						block::var_expr::Ptr varexpr1 = block::make_node<block::var_expr>();
 						varexpr1->static_offset = if1->static_offset;
 						varexpr1->var1 = cond_var;
 						assign1->var1 = varexpr1;
@@ -204,12 +248,12 @@ trim_common_from_back(block::stmt::Ptr ast1, block::stmt::Ptr ast2) {
 						stmt1->expr1 = assign1;
 						ast1_stmts.push_back(stmt1);
 
-						block::expr_stmt::Ptr stmt2 = std::make_shared<block::expr_stmt>();
+						block::expr_stmt::Ptr stmt2 = block::make_node<block::expr_stmt>();
 						stmt2->static_offset = if2->static_offset;
 						block::assign_expr::Ptr assign2 =
-							std::make_shared<block::assign_expr>();
+							block::make_node<block::assign_expr>();
 						assign2->static_offset = if2->static_offset;
-						block::var_expr::Ptr varexpr2 = std::make_shared<block::var_expr>();
+						block::var_expr::Ptr varexpr2 = block::make_node<block::var_expr>();
 						varexpr2->static_offset = if2->static_offset;
 						varexpr2->var1 = cond_var;
 						assign2->var1 = varexpr2;
@@ -217,10 +261,12 @@ trim_common_from_back(block::stmt::Ptr ast1, block::stmt::Ptr ast2) {
 						stmt2->expr1 = assign2;
 						ast2_stmts.push_back(stmt2);
 
-						block::var_expr::Ptr varexpr3 = std::make_shared<block::var_expr>();
+						block::var_expr::Ptr varexpr3 = block::make_node<block::var_expr>();
 						varexpr3->static_offset = if2->static_offset;
 						varexpr3->var1 = cond_var;
 						if1->cond = varexpr3;
+						// if1 might be shared with blocks that were already hashed
+						block::invalidate_structural_hashes();
 						trimmed_stmts.push_back(if1);
 						continue;
 
@@ -273,59 +319,140 @@ trim_common_from_back(block::stmt::Ptr ast1, block::stmt::Ptr ast2) {
 	std::reverse(trimmed_stmts.begin(), trimmed_stmts.end());
 	return {trimmed_stmts, split_decls};
 }
+struct fork_state {
+	std::atomic<int> live_children;
+	// Executions in all the processes, the budget is checked against it
+	std::atomic<unsigned long long> executions;
+	std::atomic<unsigned long long> unique_tags;
+	// Counter to restore after the extraction
+	std::atomic<unsigned long long> *saved_unique_tags;
+};
+
+// The state lives in memory shared between all the forked processes
+static bool begin_fork_exploration(builder_context *context) {
+	void *mem = mmap(nullptr, sizeof(fork_state), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return false;
+	fork_state *state = new (mem) fork_state();
+	state->live_children = 0;
+	state->executions = 0;
+	state->saved_unique_tags = tracer::get_unique_tag_counter();
+	state->unique_tags = state->saved_unique_tags->load();
+	tracer::set_unique_tag_counter(&state->unique_tags);
+	context->shared_fork_state = state;
+	return true;
+}
+static void end_fork_exploration(builder_context *context) {
+	fork_state *state = context->shared_fork_state;
+	context->stats->executions = state->executions.load();
+	state->saved_unique_tags->store(state->unique_tags.load());
+	tracer::set_unique_tag_counter(state->saved_unique_tags);
+	state->~fork_state();
+	munmap(state, sizeof(fork_state));
+	context->shared_fork_state = nullptr;
+}
+
 block::stmt::Ptr builder_context::extract_ast_from_lambda(std::function<void(void)> lambda) {
 	internal_stored_lambda = lambda;
 	return extract_ast_from_function_impl();
 }
 
-block::stmt::Ptr builder_context::extract_ast_from_function_impl(void) {
-	std::vector<bool> b;
-
-	block::stmt::Ptr ast = extract_ast_from_function_internal(b);
-	block::var_namer::name_vars(ast);	
-
-	block::label_collector collector;
-	ast->accept(&collector);
-
-	block::label_creator creator;
-	creator.collected_labels = collector.collected_labels;
-	ast->accept(&creator);
-
-	block::label_inserter inserter;
-	inserter.offset_to_label = creator.offset_to_label;
-	ast->accept(&inserter);
+// Returns the seconds since start and restarts it for the next phase
+static double end_phase(std::chrono::steady_clock::time_point &start) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - start).count();
+	start = now;
+	return seconds;
+}
 
-	if (run_rce) {
-		block::eliminate_redundant_vars(ast);
+block::stmt::Ptr builder_context::extract_ast_from_function_impl(void) {
+	util::persistent_vector<bool> b;
+
+	stats->reset();
+	stats->start_time = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point phase_start = stats->start_time;
+
+	std::unique_ptr<util::work_stealing_pool> pool;
+	if (use_parallel_exploration && exploration_pool == nullptr) {
+		unsigned int num_threads = parallel_exploration_threads;
+		if (num_threads == 0)
+			num_threads = std::thread::hardware_concurrency();
+		// The extracting thread also executes tasks while it waits
+		pool.reset(new util::work_stealing_pool(num_threads > 1 ? num_threads - 1 : 0));
+		exploration_pool = pool.get();
 	}
+	bool owns_fork_state = false;
+	if (use_fork_exploration && exploration_pool == nullptr && shared_fork_state == nullptr) {
+		owns_fork_state = begin_fork_exploration(this);
+	}
+	// The flags that change the memoized blocks are part of the key
+	std::string cache_key = memoization_cache_key + (feature_unstructured ? "\nunstructured" : "\nstructured");
+	bool use_cache = use_memoization && memoization_cache_file != "";
+	if (use_cache)
+		load_memoization_cache(memoization_cache_file, cache_key, memoized_tags);
 
-	if (feature_unstructured) 
-		return ast;
-
-	block::loop_finder finder;
-	finder.ast = ast;
-	ast->accept(&finder);
-
-	block::for_loop_finder for_finder;
-	for_finder.ast = ast;
-	ast->accept(&for_finder);
-
-	block::if_switcher switcher;
-	ast->accept(&switcher);
-
-	block::loop_roll_finder loop_roll_finder;
-	ast->accept(&loop_roll_finder);
+	block::stmt::Ptr ast;
+	try {
+		ast = extract_ast_from_function_internal(b);
+	} catch (...) {
+		if (pool != nullptr)
+			exploration_pool = nullptr;
+		if (owns_fork_state)
+			end_fork_exploration(this);
+		throw;
+	}
+	if (pool != nullptr)
+		exploration_pool = nullptr;
+	if (owns_fork_state)
+		end_fork_exploration(this);
+	// The passes below modify the blocks, the table is stored before them
+	if (use_cache)
+		save_memoization_cache(memoization_cache_file, cache_key, memoized_tags);
+	stats->extraction_time = end_phase(phase_start);
+
+	passes.set_enabled("eliminate_redundant_vars", run_rce);
+	passes.set_enabled("fold_constants", run_const_fold);
+	passes.set_enabled("eliminate_common_subexprs", run_cse);
+	passes.set_enabled("hoist_loop_invariants", run_licm);
+	passes.set_enabled("share_tails", shared_tail_threshold != 0);
+	pass_manager::pass *share_tails = passes.find_pass("share_tails");
+	if (shared_tail_threshold != 0 && share_tails != nullptr) {
+		unsigned long long threshold = shared_tail_threshold;
+		extraction_stats *s = stats;
+		share_tails->run = [threshold, s](block::stmt::Ptr ast) {
+			block::shared_tail_stats result = block::share_tails(ast, threshold);
+			s->tails_shared += result.tails_shared;
+			s->tail_bytes_saved += result.bytes_saved;
+		};
+	}
+	passes.run(ast, feature_unstructured, stats->passes);
 
+	stats->ast_nodes = extraction_stats::count_ast_nodes(ast);
 
 	return ast;
 }
-block::stmt::Ptr builder_context::extract_ast_from_function_internal(std::vector<bool> b) {
+block::stmt::Ptr builder_context::extract_ast_from_function_internal(util::persistent_vector<bool> b) {
+	// A forked child must never unwind past the context it was forked in,
+	// on errors the parent explores the path itself
+	struct fork_exit_guard {
+		builder_context *context;
+		~fork_exit_guard() {
+			if (context->fork_result_fd != -1)
+				context->send_forked_path(nullptr);
+		}
+	} exit_guard = {this};
+
+	unsigned long long executions = count_execution();
+	stats->record_branch_depth(b.size());
+	check_extraction_budget(b.size(), executions);
 
-	current_block_stmt = std::make_shared<block::stmt_block>();
+	current_block_stmt = block::make_node<block::stmt_block>();
 	current_block_stmt->static_offset.clear();
+	committed_exprs.clear();
 	assert(current_block_stmt != nullptr);
 	ast = current_block_stmt;
-	bool_vector = b;
+	bool_vector.decisions = b;
+	bool_vector.next = 0;
 
 
 	block::stmt::Ptr ret_ast;
@@ -348,31 +475,59 @@ block::stmt::Ptr builder_context::extract_ast_from_function_internal(std::vector
 
 		block::expr::Ptr cond_expr = last_stmt->expr1;
 
-		builder_context true_context(memoized_tags);
-		true_context.expr_sequence = expr_sequence;
-		true_context.use_memoization = use_memoization;
-		true_context.visited_offsets = visited_offsets;
-		true_context.internal_stored_lambda = internal_stored_lambda;
-		true_context.feature_unstructured = feature_unstructured;
+		// Branches taken by forking come after the ones this context replayed
+		util::persistent_vector<bool> prefix = b;
+		for (bool decision : forked_decisions)
+			prefix.push_back(decision);
 
-		std::vector<bool> true_bv;
+		util::persistent_vector<bool> true_bv = prefix;
 		true_bv.push_back(true);
-		std::copy(b.begin(), b.end(), std::back_inserter(true_bv));
-		block::stmt_block::Ptr true_ast = block::to<block::stmt_block>(
-		    true_context.extract_ast_from_function_internal(true_bv));
+		util::persistent_vector<bool> false_bv = prefix;
+		false_bv.push_back(false);
 
-		builder_context false_context(memoized_tags);
-		false_context.expr_sequence = std::move(expr_sequence);
-		false_context.use_memoization = use_memoization;
-		false_context.visited_offsets = visited_offsets;
-		false_context.internal_stored_lambda = internal_stored_lambda;
-		false_context.feature_unstructured = feature_unstructured;
+		builder_context true_context(memoized_tags);
+		inherit_child_context(true_context);
+		true_context.expr_sequence = expr_sequence;
+		true_context.var_sequence = var_sequence;
 
-		std::vector<bool> false_bv;
-		false_bv.push_back(false);
-		std::copy(b.begin(), b.end(), std::back_inserter(false_bv));
-		block::stmt_block::Ptr false_ast = block::to<block::stmt_block>(
-		    false_context.extract_ast_from_function_internal(false_bv));
+		builder_context false_context(memoized_tags);
+		inherit_child_context(false_context);
+		false_context.expr_sequence = expr_sequence;
+		false_context.var_sequence = var_sequence;
+
+		block::stmt_block::Ptr true_ast = forked_true_ast;
+		block::stmt_block::Ptr false_ast = forked_false_ast;
+		forked_true_ast = forked_false_ast = nullptr;
+		// A path explored by a forked child counts as an execution like a replay
+		stats->add_branch_executions(e.static_offset, 2);
+		if (exploration_pool != nullptr) {
+			// Explore the true path on the pool while this thread takes the false path
+			util::work_stealing_pool::task true_task([&]() {
+				true_ast = block::to<block::stmt_block>(true_context.extract_ast_from_function_internal(true_bv));
+			});
+			exploration_pool->spawn(&true_task);
+			// With memoization the false path depends on what the true path leaves in the table.
+			// It replays up to this branch in parallel and then waits to keep the output deterministic
+			if (use_memoization)
+				false_context.preceding_path = &true_task;
+			try {
+				false_ast = block::to<block::stmt_block>(false_context.extract_ast_from_function_internal(false_bv));
+			} catch (...) {
+				// The task refers to this frame, it has to finish before we unwind
+				try {
+					exploration_pool->wait(&true_task);
+				} catch (...) {
+				}
+				throw;
+			}
+			exploration_pool->wait(&true_task);
+		} else {
+			// Paths that couldn't be forked are explored here
+			if (true_ast == nullptr)
+				true_ast = block::to<block::stmt_block>(true_context.extract_ast_from_function_internal(true_bv));
+			if (false_ast == nullptr)
+				false_ast = block::to<block::stmt_block>(false_context.extract_ast_from_function_internal(false_bv));
+		}
 
 		trim_ast_at_offset(true_ast, e.static_offset);
 		trim_ast_at_offset(false_ast, e.static_offset);
@@ -387,7 +542,7 @@ block::stmt::Ptr builder_context::extract_ast_from_function_internal(std::vector
 		erase_tag(e.static_offset);
 
 		block::if_stmt::Ptr new_if_stmt =
-		    std::make_shared<block::if_stmt>();
+		    block::make_node<block::if_stmt>();
 		new_if_stmt->annotation = last_stmt->annotation;
 		new_if_stmt->static_offset = e.static_offset;
 
@@ -406,18 +561,20 @@ block::stmt::Ptr builder_context::extract_ast_from_function_internal(std::vector
 		ret_ast = ast;
 	} catch (LoopBackException &e) {
 		current_builder_context = nullptr;
+		stats->loop_backs++;
 
 		block::goto_stmt::Ptr goto_stmt =
-		    std::make_shared<block::goto_stmt>();
+		    block::make_node<block::goto_stmt>();
 		goto_stmt->static_offset.clear();
 		goto_stmt->temporary_label_number = e.static_offset;
 
 		add_stmt_to_current_block(goto_stmt, false);
 		ret_ast = ast;
 	} catch (MemoizationException &e) {
+		stats->memoization_hits++;
 		if (feature_unstructured) {
 			// Instead of copying statements to the current block, we will just insert a goto
-			block::goto_stmt::Ptr goto_stmt = std::make_shared<block::goto_stmt>();
+			block::goto_stmt::Ptr goto_stmt = block::make_node<block::goto_stmt>();
 			goto_stmt->static_offset.clear();
 			goto_stmt->temporary_label_number = e.static_offset;
 			add_stmt_to_current_block(goto_stmt, false);
@@ -430,7 +587,9 @@ block::stmt::Ptr builder_context::extract_ast_from_function_internal(std::vector
 		ret_ast = ast;
 	}
 
+	wait_for_preceding_path();
 	// Update the memoized table with the stmt block we just created
+	std::lock_guard<std::recursive_mutex> memoization_guard(memoized_tags->lock);
 	for (unsigned int i = 0; i < current_block_stmt->stmts.size(); i++) {
 		block::stmt::Ptr s = current_block_stmt->stmts[i];
 		// If any of the statements are if conditions, remove the
@@ -450,37 +609,348 @@ block::stmt::Ptr builder_context::extract_ast_from_function_internal(std::vector
 			for (auto &stmt :
 			     block::to<block::stmt_block>(if1->then_stmt)
 				 ->stmts) {
-				auto it = memoized_tags->map.find(
-				    stmt->static_offset.stringify());
-				if (it != memoized_tags->map.end())
-					memoized_tags->map.erase(it);
+				memoized_tags->erase(stmt->static_offset);
 
 				if (feature_unstructured) {
 					auto pblock = block::to<block::stmt_block>(if1->then_stmt);
-					memoized_tags->map[stmt->static_offset.stringify()] = pblock;
+					memoized_tags->set(stmt->static_offset, pblock);
 				}
 			}
 			for (auto &stmt :
 			     block::to<block::stmt_block>(if1->else_stmt)
 				 ->stmts) {
-				auto it = memoized_tags->map.find(
-				    stmt->static_offset.stringify());
-				if (it != memoized_tags->map.end())
-					memoized_tags->map.erase(it);
+				memoized_tags->erase(stmt->static_offset);
 				if (feature_unstructured) {
 					auto pblock = block::to<block::stmt_block>(if1->else_stmt);
-					memoized_tags->map[stmt->static_offset.stringify()] = pblock;
+					memoized_tags->set(stmt->static_offset, pblock);
 				}
 			}
 		}
-		memoized_tags->map[s->static_offset.stringify()] =
-		    current_block_stmt;
+		memoized_tags->set(s->static_offset, current_block_stmt);
 	}
 
+	if (fork_result_fd != -1)
+		send_forked_path(ret_ast);
+
 	ast = current_block_stmt = nullptr;
 	return ret_ast;
 }
 
+void builder_context::copy_extraction_settings(builder_context &other) {
+	other.use_memoization = use_memoization;
+	other.run_rce = run_rce;
+	other.run_const_fold = run_const_fold;
+	other.run_cse = run_cse;
+	other.run_licm = run_licm;
+	other.shared_tail_threshold = shared_tail_threshold;
+	other.feature_unstructured = feature_unstructured;
+	other.passes = passes;
+	other.dynamic_use_cxx = dynamic_use_cxx;
+	other.dynamic_header_includes = dynamic_header_includes;
+	other.memoization_cache_file = memoization_cache_file;
+	other.memoization_cache_key = memoization_cache_key;
+	other.max_executions = max_executions;
+	other.max_branch_depth = max_branch_depth;
+	other.max_extraction_seconds = max_extraction_seconds;
+	other.use_parallel_exploration = use_parallel_exploration;
+	other.parallel_exploration_threads = parallel_exploration_threads;
+	other.use_fork_exploration = use_fork_exploration;
+	other.max_fork_children = max_fork_children;
+}
+
+void builder_context::inherit_child_context(builder_context &child) {
+	copy_extraction_settings(child);
+	child.visited_offsets = visited_offsets;
+	child.internal_stored_lambda = internal_stored_lambda;
+	child.exploration_pool = exploration_pool;
+	child.shared_fork_state = shared_fork_state;
+	child.stats = stats;
+}
+
+unsigned long long builder_context::count_execution(void) {
+	std::atomic<unsigned long long> &counter = shared_fork_state != nullptr ? shared_fork_state->executions : stats->executions;
+	unsigned long long count = counter.load();
+	while (max_executions == 0 || count <= max_executions) {
+		if (counter.compare_exchange_weak(count, count + 1))
+			return count + 1;
+	}
+	return count;
+}
+
+void builder_context::check_extraction_budget(unsigned long long branch_depth, unsigned long long executions) {
+	std::string reason;
+	if (max_executions != 0 && executions > max_executions)
+		reason = "more than " + std::to_string(max_executions) + " executions";
+	else if (max_branch_depth != 0 && branch_depth > max_branch_depth)
+		reason = "more than " + std::to_string(max_branch_depth) + " nested branches";
+	else if (max_extraction_seconds != 0 && stats->elapsed_seconds() > max_extraction_seconds)
+		reason = "more than " + std::to_string(max_extraction_seconds) + " seconds";
+	else
+		return;
+	// Forked processes only count in the shared state until the extraction ends
+	if (shared_fork_state != nullptr)
+		stats->executions = executions;
+	std::stringstream report;
+	report << "Extraction budget exceeded: " << reason << std::endl;
+	stats->dump(report);
+	throw ExtractionBudgetException(report.str());
+}
+
+std::vector<block::stmt::Ptr> builder_context::extract_function_asts(const std::vector<extraction_job> &jobs, unsigned int num_threads,
+								    std::vector<extraction_stats> *job_stats) {
+	if (num_threads == 0)
+		num_threads = std::thread::hardware_concurrency();
+	// This thread also runs jobs while it waits
+	util::work_stealing_pool pool(num_threads > 1 ? num_threads - 1 : 0);
+
+	std::vector<block::stmt::Ptr> results(jobs.size());
+	std::vector<std::unique_ptr<extraction_stats>> results_stats(jobs.size());
+	std::vector<std::unique_ptr<util::work_stealing_pool::task>> tasks;
+	for (unsigned int i = 0; i < jobs.size(); i++) {
+		tasks.push_back(std::unique_ptr<util::work_stealing_pool::task>(new util::work_stealing_pool::task([&, i]() {
+			builder_context context;
+			copy_extraction_settings(context);
+			// The jobs would overwrite each other's cache
+			if (memoization_cache_file != "")
+				context.memoization_cache_file = memoization_cache_file + "." + std::to_string(i);
+			// Branches of all the jobs share the same threads
+			if (use_parallel_exploration)
+				context.exploration_pool = &pool;
+			results[i] = jobs[i](context);
+			results_stats[i].reset(new extraction_stats(*context.stats));
+		})));
+		pool.spawn(tasks.back().get());
+	}
+	// The tasks refer to this frame, wait for all of them before reporting an error
+	std::exception_ptr error;
+	for (auto &t : tasks) {
+		try {
+			pool.wait(t.get());
+		} catch (...) {
+			if (error == nullptr)
+				error = std::current_exception();
+		}
+	}
+	if (error != nullptr)
+		std::rethrow_exception(error);
+	if (job_stats != nullptr) {
+		job_stats->clear();
+		job_stats->reserve(jobs.size());
+		for (auto &s : results_stats)
+			job_stats->push_back(*s);
+	}
+	return results;
+}
+
+void builder_context::wait_for_preceding_path(void) {
+	if (preceding_path == nullptr)
+		return;
+	// The pool runs other extractions on this thread while we wait
+	builder_context *saved_context = current_builder_context;
+	exploration_pool->wait(preceding_path);
+	current_builder_context = saved_context;
+	preceding_path = nullptr;
+}
+
+pid_t builder_context::fork_path(bool value, int &read_fd) {
+	if (shared_fork_state->live_children++ >= (int)max_fork_children) {
+		shared_fork_state->live_children--;
+		return -1;
+	}
+	int fds[2];
+	if (pipe(fds) != 0) {
+		shared_fork_state->live_children--;
+		return -1;
+	}
+	// The child counts as an execution of the path. Past the budget the path
+	// isn't forked, replaying it reports the exceeded budget
+	unsigned long long executions = count_execution();
+	if (max_executions != 0 && executions > max_executions) {
+		close(fds[0]);
+		close(fds[1]);
+		shared_fork_state->live_children--;
+		return -1;
+	}
+	// Buffered output would otherwise be written by both the processes
+	fflush(nullptr);
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		shared_fork_state->live_children--;
+		shared_fork_state->executions--;
+		return -1;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		fork_result_fd = fds[1];
+		fork_epoch = block::block_creation_counter;
+		forked_decisions.push_back(value);
+		memoized_tags->track_changes = true;
+		memoized_tags->changed_tags.clear();
+		// The child keeps counting from the stats of the parent and sends back what it adds
+		fork_baseline.reset(new extraction_stats(*stats));
+		stats->record_branch_depth(bool_vector.decisions.size() + forked_decisions.size());
+		// Like a context exploring the path, only the statements after the branch are collected
+		current_block_stmt = block::make_node<block::stmt_block>();
+		committed_exprs.clear();
+		ast = current_block_stmt;
+		return 0;
+	}
+	close(fds[1]);
+	read_fd = fds[0];
+	return pid;
+}
+
+bool builder_context::explore_forked_paths(bool &value) {
+	int true_fd = -1;
+	int false_fd = -1;
+	pid_t true_pid = fork_path(true, true_fd);
+	if (true_pid == 0) {
+		value = true;
+		return true;
+	}
+	if (true_pid < 0)
+		return false;
+	pid_t false_pid = -1;
+	// Without memoization the paths are independent and explored concurrently
+	if (!use_memoization) {
+		false_pid = fork_path(false, false_fd);
+		if (false_pid == 0) {
+			close(true_fd);
+			value = false;
+			return true;
+		}
+	}
+	forked_true_ast = collect_forked_path(true_pid, true_fd);
+	// Otherwise the false path has to see the table left by the true path
+	if (use_memoization && forked_true_ast != nullptr) {
+		false_pid = fork_path(false, false_fd);
+		if (false_pid == 0) {
+			value = false;
+			return true;
+		}
+	}
+	if (false_pid > 0)
+		forked_false_ast = collect_forked_path(false_pid, false_fd);
+	return false;
+}
+
+block::stmt_block::Ptr builder_context::collect_forked_path(pid_t pid, int read_fd) {
+	std::string data;
+	char buffer[65536];
+	bool read_failed = false;
+	while (1) {
+		ssize_t n = read(read_fd, buffer, sizeof(buffer));
+		if (n == 0)
+			break;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			read_failed = true;
+			break;
+		}
+		data.append(buffer, n);
+	}
+	close(read_fd);
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		;
+	shared_fork_state->live_children--;
+	if (read_failed || !WIFEXITED(status))
+		return nullptr;
+
+	// Blocks that were alive before the fork are sent by their address
+	block::block_deserializer deserializer(data);
+	deserializer.read_addresses = true;
+	block::stmt_block::Ptr path_ast = deserializer.read_block_as<block::stmt_block>();
+	std::vector<std::pair<tracer::tag, block::stmt_block::Ptr>> changes;
+	unsigned long long num_changes = deserializer.read_u64();
+	for (unsigned long long i = 0; i < num_changes && !deserializer.failed; i++) {
+		tracer::tag t = deserializer.read_tag();
+		changes.push_back({t, deserializer.read_block_as<block::stmt_block>()});
+	}
+	unsigned long long max_depth = deserializer.read_u64();
+	unsigned long long memoization_hits = deserializer.read_u64();
+	unsigned long long memoization_misses = deserializer.read_u64();
+	unsigned long long loop_backs = deserializer.read_u64();
+	std::vector<std::pair<tracer::tag, unsigned long long>> branch_executions;
+	unsigned long long num_branches = deserializer.read_u64();
+	for (unsigned long long i = 0; i < num_branches && !deserializer.failed; i++) {
+		tracer::tag t = deserializer.read_tag();
+		branch_executions.push_back({t, deserializer.read_u64()});
+	}
+	if (deserializer.failed || !deserializer.at_end())
+		return nullptr;
+
+	stats->record_branch_depth(max_depth);
+	stats->memoization_hits += memoization_hits;
+	stats->memoization_misses += memoization_misses;
+	stats->loop_backs += loop_backs;
+	for (auto &branch : branch_executions)
+		stats->add_branch_executions(branch.first, branch.second);
+	// A child that failed still sends its stats
+	if (WEXITSTATUS(status) != 0 || path_ast == nullptr)
+		return nullptr;
+
+	for (auto &change : changes) {
+		if (change.second == nullptr)
+			memoized_tags->erase(change.first);
+		else
+			memoized_tags->set(change.first, change.second);
+	}
+	return path_ast;
+}
+
+void builder_context::send_forked_path(block::stmt::Ptr path_ast) {
+	block::block_serializer serializer;
+	unsigned long long epoch = fork_epoch;
+	serializer.write_by_address = [=](block::block::Ptr b) { return b->creation_id < epoch; };
+	serializer.write_block(path_ast);
+	// Without a path the table is left as it was
+	serializer.write_u64(path_ast == nullptr ? 0 : memoized_tags->changed_tags.size());
+	for (auto &t : memoized_tags->changed_tags) {
+		if (path_ast == nullptr)
+			break;
+		serializer.write_tag(t);
+		auto it = memoized_tags->map.find(t);
+		serializer.write_block(it == memoized_tags->map.end() ? nullptr : it->second);
+	}
+	// Executions are counted in the shared state, the rest is sent as the
+	// difference to the stats at the time of the fork
+	serializer.write_u64(stats->max_branch_depth);
+	serializer.write_u64(stats->memoization_hits - fork_baseline->memoization_hits);
+	serializer.write_u64(stats->memoization_misses - fork_baseline->memoization_misses);
+	serializer.write_u64(stats->loop_backs - fork_baseline->loop_backs);
+	std::vector<std::pair<tracer::tag, unsigned long long>> branch_executions;
+	for (auto &branch : stats->branch_executions) {
+		auto it = fork_baseline->branch_executions.find(branch.first);
+		unsigned long long before = it == fork_baseline->branch_executions.end() ? 0 : it->second;
+		if (branch.second > before)
+			branch_executions.push_back({branch.first, branch.second - before});
+	}
+	serializer.write_u64(branch_executions.size());
+	for (auto &branch : branch_executions) {
+		serializer.write_tag(branch.first);
+		serializer.write_u64(branch.second);
+	}
+	if (serializer.failed)
+		_exit(1);
+	const char *data = serializer.buffer.data();
+	size_t remaining = serializer.buffer.size();
+	while (remaining > 0) {
+		ssize_t n = write(fork_result_fd, data, remaining);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			_exit(1);
+		}
+		data += n;
+		remaining -= n;
+	}
+	_exit(path_ast == nullptr ? 1 : 0);
+}
+
 void lambda_wrapper_impl(void) {
 	builder_context::current_builder_context->internal_stored_lambda();
 }
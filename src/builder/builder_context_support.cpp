@@ -4,7 +4,7 @@ void lambda_wrapper_impl(void);
 void lambda_wrapper(void);
 void lambda_wrapper_close(void);
 
-int tail_call_guard;
+thread_local int tail_call_guard;
 
 void lambda_wrapper(void) {
 	lambda_wrapper_impl();
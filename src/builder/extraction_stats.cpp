@@ -0,0 +1,91 @@
+#include "builder/extraction_stats.h"
+#include "blocks/node_collector.h"
+#include <algorithm>
+
+namespace builder {
+
+extraction_stats::extraction_stats(const extraction_stats &other)
+    : executions(other.executions.load()), max_branch_depth(other.max_branch_depth.load()),
+      memoization_hits(other.memoization_hits.load()), memoization_misses(other.memoization_misses.load()),
+      loop_backs(other.loop_backs.load()), ast_nodes(other.ast_nodes), tails_shared(other.tails_shared),
+      tail_bytes_saved(other.tail_bytes_saved), extraction_time(other.extraction_time),
+      passes(other.passes), start_time(other.start_time), branch_executions(other.branch_executions) {}
+
+void extraction_stats::reset(void) {
+	executions = 0;
+	max_branch_depth = 0;
+	memoization_hits = 0;
+	memoization_misses = 0;
+	loop_backs = 0;
+	ast_nodes = 0;
+	tails_shared = 0;
+	tail_bytes_saved = 0;
+	extraction_time = 0;
+	passes.clear();
+	std::lock_guard<std::mutex> guard(branch_lock);
+	branch_executions.clear();
+}
+
+void extraction_stats::record_branch_depth(unsigned long long depth) {
+	unsigned long long current = max_branch_depth;
+	while (depth > current && !max_branch_depth.compare_exchange_weak(current, depth))
+		;
+}
+
+void extraction_stats::add_branch_executions(const tracer::tag &t, unsigned long long count) {
+	std::lock_guard<std::mutex> guard(branch_lock);
+	branch_executions[t] += count;
+}
+
+std::vector<std::pair<tracer::tag, unsigned long long>> extraction_stats::top_branches(unsigned int count) {
+	std::vector<std::pair<tracer::tag, unsigned long long>> branches;
+	{
+		std::lock_guard<std::mutex> guard(branch_lock);
+		branches.assign(branch_executions.begin(), branch_executions.end());
+	}
+	// Ties are broken by the tag so the order doesn't depend on the hash table
+	std::sort(branches.begin(), branches.end(), [](const std::pair<tracer::tag, unsigned long long> &a, const std::pair<tracer::tag, unsigned long long> &b) {
+		if (a.second != b.second)
+			return a.second > b.second;
+		return a.first < b.first;
+	});
+	if (branches.size() > count)
+		branches.resize(count);
+	return branches;
+}
+
+double extraction_stats::elapsed_seconds(void) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void extraction_stats::dump(std::ostream &oss, unsigned int num_branches) {
+	oss << "executions: " << executions << std::endl;
+	oss << "max branch depth: " << max_branch_depth << std::endl;
+	oss << "memoization hits: " << memoization_hits << std::endl;
+	oss << "memoization misses: " << memoization_misses << std::endl;
+	oss << "loop backs: " << loop_backs << std::endl;
+	oss << "ast nodes: " << ast_nodes << std::endl;
+	if (tails_shared > 0)
+		oss << "shared tails: " << tails_shared << ", " << tail_bytes_saved << " bytes saved" << std::endl;
+	oss << "extraction time: " << extraction_time << "s" << std::endl;
+	for (auto &p : passes) {
+		oss << "pass " << p.name << ": " << p.seconds << "s";
+		if (p.nodes_before > 0)
+			oss << ", " << p.nodes_before << " nodes before, " << p.nodes_changed << " nodes changed";
+		oss << std::endl;
+	}
+	std::vector<std::pair<tracer::tag, unsigned long long>> branches = top_branches(num_branches);
+	if (branches.size() == 0)
+		return;
+	oss << "branches with the most executions:" << std::endl;
+	for (auto &b : branches)
+		oss << "  " << b.first.stringify() << ": " << b.second << std::endl;
+}
+
+unsigned long long extraction_stats::count_ast_nodes(block::block::Ptr ast) {
+	block::node_collector collector;
+	ast->accept(&collector);
+	return collector.nodes.size();
+}
+
+} // namespace builder
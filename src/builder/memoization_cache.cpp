@@ -0,0 +1,139 @@
+#include "builder/memoization_cache.h"
+#include "blocks/block_serializer.h"
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <link.h>
+#include <sstream>
+#include <unistd.h>
+
+namespace builder {
+
+// Bumped whenever the layout of the file or the tags changes
+static const unsigned long long memoization_cache_version = 1;
+static const char *memoization_cache_magic = "BUILDIT_MEMOIZATION_CACHE";
+
+struct build_id_search {
+	unsigned long long address;
+	std::string build_id;
+};
+static int find_build_id(struct dl_phdr_info *info, size_t, void *data) {
+	build_id_search *search = (build_id_search *)data;
+	bool contains_address = false;
+	for (int i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+		unsigned long long start = info->dlpi_addr + phdr.p_vaddr;
+		if (phdr.p_type == PT_LOAD && search->address >= start && search->address < start + phdr.p_memsz)
+			contains_address = true;
+	}
+	if (!contains_address)
+		return 0;
+	for (int i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+		if (phdr.p_type != PT_NOTE)
+			continue;
+		const char *note = (const char *)(info->dlpi_addr + phdr.p_vaddr);
+		const char *end = note + phdr.p_memsz;
+		while (note + sizeof(ElfW(Nhdr)) <= end) {
+			const ElfW(Nhdr) *header = (const ElfW(Nhdr) *)note;
+			const char *name = note + sizeof(ElfW(Nhdr));
+			const unsigned char *desc = (const unsigned char *)(name + ((header->n_namesz + 3) & ~3));
+			if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+				char temp[4];
+				for (unsigned int j = 0; j < header->n_descsz; j++) {
+					sprintf(temp, "%02x", desc[j]);
+					search->build_id += temp;
+				}
+				return 1;
+			}
+			note = (const char *)desc + ((header->n_descsz + 3) & ~3);
+		}
+	}
+	return 1;
+}
+
+std::string get_build_id(void) {
+	static std::string build_id;
+	static bool found = false;
+	if (!found) {
+		// The binary that has the staged code, tags are relative to this function
+		build_id_search search;
+		search.address = (unsigned long long)(void *)lambda_wrapper;
+		dl_iterate_phdr(find_build_id, &search);
+		build_id = search.build_id;
+		found = true;
+	}
+	return build_id;
+}
+
+bool load_memoization_cache(const std::string &file_name, const std::string &key, tag_map *map) {
+	std::string build_id = get_build_id();
+	if (build_id == "")
+		return false;
+	std::ifstream file(file_name, std::ios::binary);
+	if (!file)
+		return false;
+	std::stringstream contents;
+	contents << file.rdbuf();
+	std::string buffer = contents.str();
+
+	block::block_deserializer deserializer(buffer);
+	if (deserializer.read_string() != memoization_cache_magic || deserializer.read_u64() != memoization_cache_version)
+		return false;
+	if (deserializer.read_string() != build_id || deserializer.read_string() != key)
+		return false;
+
+	std::vector<std::pair<tracer::tag, block::stmt_block::Ptr>> entries;
+	unsigned long long num_entries = deserializer.read_u64();
+	for (unsigned long long i = 0; i < num_entries && !deserializer.failed; i++) {
+		tracer::tag t = deserializer.read_tag();
+		entries.push_back({t, deserializer.read_block_as<block::stmt_block>()});
+	}
+	if (deserializer.failed || !deserializer.at_end())
+		return false;
+
+	std::lock_guard<std::recursive_mutex> guard(map->lock);
+	for (auto &entry : entries) {
+		// Entries from the current run are newer
+		if (entry.second != nullptr && map->map.find(entry.first) == map->map.end())
+			map->map[entry.first] = entry.second;
+	}
+	return true;
+}
+
+bool save_memoization_cache(const std::string &file_name, const std::string &key, tag_map *map) {
+	std::string build_id = get_build_id();
+	if (build_id == "")
+		return false;
+	block::block_serializer serializer;
+	serializer.write_string(memoization_cache_magic);
+	serializer.write_u64(memoization_cache_version);
+	serializer.write_string(build_id);
+	serializer.write_string(key);
+	{
+		std::lock_guard<std::recursive_mutex> guard(map->lock);
+		serializer.write_u64(map->map.size());
+		for (auto &entry : map->map) {
+			serializer.write_tag(entry.first);
+			serializer.write_block(entry.second);
+		}
+	}
+	// Tables with foreign exprs can't be stored
+	if (serializer.failed)
+		return false;
+
+	// Written to the side and renamed, so a concurrent reader never sees half a file
+	std::string temp_name = file_name + "." + std::to_string(getpid()) + ".tmp";
+	{
+		std::ofstream file(temp_name, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+		file.write(serializer.buffer.data(), serializer.buffer.size());
+		if (!file)
+			return false;
+	}
+	return rename(temp_name.c_str(), file_name.c_str()) == 0;
+}
+
+} // namespace builder
@@ -0,0 +1,158 @@
+#include "builder/pass_manager.h"
+#include "blocks/const_fold.h"
+#include "blocks/cse.h"
+#include "blocks/for_loop_finder.h"
+#include "blocks/if_switcher.h"
+#include "blocks/label_inserter.h"
+#include "blocks/licm.h"
+#include "blocks/loop_finder.h"
+#include "blocks/loop_roll.h"
+#include "blocks/node_collector.h"
+#include "blocks/rce.h"
+#include "blocks/shared_tail.h"
+#include "blocks/var_namer.h"
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
+
+namespace builder {
+
+static void insert_labels(block::stmt::Ptr ast) {
+	block::label_collector collector;
+	ast->accept(&collector);
+
+	block::label_creator creator;
+	creator.collected_labels = collector.collected_labels;
+	ast->accept(&creator);
+
+	block::label_inserter inserter;
+	inserter.offset_to_label = creator.offset_to_label;
+	ast->accept(&inserter);
+}
+
+pass_manager pass_manager::default_pipeline(void) {
+	pass_manager manager;
+	manager.add_pass("name_vars", [](block::stmt::Ptr ast) { block::var_namer::name_vars(ast); });
+	manager.add_pass("insert_labels", insert_labels);
+	manager.add_pass("eliminate_redundant_vars", [](block::stmt::Ptr ast) { block::eliminate_redundant_vars(ast); });
+	manager.set_enabled("eliminate_redundant_vars", false);
+	manager.add_pass("fold_constants", [](block::stmt::Ptr ast) { block::fold_constants(ast); });
+	manager.set_enabled("fold_constants", false);
+	manager.add_pass("find_loops", [](block::stmt::Ptr ast) {
+		block::loop_finder finder;
+		finder.ast = ast;
+		ast->accept(&finder);
+	}, true);
+	manager.add_pass("find_for_loops", [](block::stmt::Ptr ast) {
+		block::for_loop_finder for_finder;
+		for_finder.ast = ast;
+		ast->accept(&for_finder);
+	}, true);
+	manager.add_pass("switch_ifs", [](block::stmt::Ptr ast) {
+		block::if_switcher switcher;
+		ast->accept(&switcher);
+	}, true);
+	manager.add_pass("roll_loops", [](block::stmt::Ptr ast) {
+		block::loop_roll_finder loop_roll_finder;
+		ast->accept(&loop_roll_finder);
+	}, true);
+	manager.add_pass("hoist_loop_invariants", [](block::stmt::Ptr ast) { block::hoist_loop_invariants(ast); }, true);
+	manager.set_enabled("hoist_loop_invariants", false);
+	// builder_context replaces it with one that uses shared_tail_threshold
+	manager.add_pass("share_tails", [](block::stmt::Ptr ast) { block::share_tails(ast, 0); }, true);
+	manager.set_enabled("share_tails", false);
+	// Runs last so that the temporaries don't get in the way of the loop finders
+	manager.add_pass("eliminate_common_subexprs", [](block::stmt::Ptr ast) { block::eliminate_common_subexprs(ast); });
+	manager.set_enabled("eliminate_common_subexprs", false);
+	return manager;
+}
+
+static pass_manager::pass make_pass(const std::string &name, pass_manager::pass_function run, bool structured_only) {
+	pass_manager::pass p;
+	p.name = name;
+	p.run = run;
+	p.structured_only = structured_only;
+	return p;
+}
+
+void pass_manager::add_pass(const std::string &name, pass_function run, bool structured_only) {
+	passes.push_back(make_pass(name, run, structured_only));
+}
+
+bool pass_manager::insert_pass_before(const std::string &before, const std::string &name, pass_function run,
+				      bool structured_only) {
+	auto it = std::find_if(passes.begin(), passes.end(), [&](const pass &p) { return p.name == before; });
+	if (it == passes.end())
+		return false;
+	passes.insert(it, make_pass(name, run, structured_only));
+	return true;
+}
+
+bool pass_manager::insert_pass_after(const std::string &after, const std::string &name, pass_function run,
+				     bool structured_only) {
+	auto it = std::find_if(passes.begin(), passes.end(), [&](const pass &p) { return p.name == after; });
+	if (it == passes.end())
+		return false;
+	passes.insert(it + 1, make_pass(name, run, structured_only));
+	return true;
+}
+
+bool pass_manager::remove_pass(const std::string &name) {
+	auto it = std::find_if(passes.begin(), passes.end(), [&](const pass &p) { return p.name == name; });
+	if (it == passes.end())
+		return false;
+	passes.erase(it);
+	return true;
+}
+
+bool pass_manager::set_enabled(const std::string &name, bool enabled) {
+	pass *p = find_pass(name);
+	if (p == nullptr)
+		return false;
+	p->enabled = enabled;
+	return true;
+}
+
+pass_manager::pass *pass_manager::find_pass(const std::string &name) {
+	for (auto &p : passes) {
+		if (p.name == name)
+			return &p;
+	}
+	return nullptr;
+}
+
+static std::unordered_set<block::block::Ptr> collect_nodes(block::stmt::Ptr ast) {
+	block::node_collector collector;
+	ast->accept(&collector);
+	return std::move(collector.nodes);
+}
+
+void pass_manager::run(block::stmt::Ptr ast, bool feature_unstructured, std::vector<pass_stats> &stats) {
+	std::unordered_set<block::block::Ptr> nodes;
+	if (count_nodes)
+		nodes = collect_nodes(ast);
+	for (auto &p : passes) {
+		if (!p.enabled || (p.structured_only && feature_unstructured))
+			continue;
+		pass_stats record;
+		record.name = p.name;
+		auto start = std::chrono::steady_clock::now();
+		// The extraction or the previous pass changed blocks without updating their cached hashes
+		block::invalidate_structural_hashes();
+		p.run(ast);
+		record.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (count_nodes) {
+			std::unordered_set<block::block::Ptr> new_nodes = collect_nodes(ast);
+			record.nodes_before = nodes.size();
+			for (auto &n : new_nodes)
+				record.nodes_changed += nodes.count(n) == 0;
+			for (auto &n : nodes)
+				record.nodes_changed += new_nodes.count(n) == 0;
+			nodes = std::move(new_nodes);
+		}
+		stats.push_back(record);
+	}
+	block::invalidate_structural_hashes();
+}
+
+} // namespace builder
@@ -0,0 +1,173 @@
+#include "util/node_pool.h"
+#include <atomic>
+#include <mutex>
+
+namespace util {
+
+// Sizes are rounded up to this so that every slot is suitably aligned
+static const size_t granularity = alignof(std::max_align_t);
+static const size_t num_classes = 32;
+static const size_t max_pooled_size = granularity * num_classes;
+static const size_t chunk_size = 256 * 1024;
+
+struct free_slot {
+	free_slot *next;
+};
+
+static std::atomic<size_t> bytes_in_use(0);
+static std::atomic<size_t> bytes_reserved(0);
+
+// Every chunk starts with a pointer to the previous one, so that they can be
+// released. Releasing starts a new epoch, threads drop their free lists and
+// chunk when they see it
+static std::mutex chunk_lock;
+static char *last_chunk = nullptr;
+static std::atomic<unsigned long long> pool_epoch(1);
+
+// Free lists given up by threads that exited. Everything here is trivially
+// destructible, blocks in static objects are freed after the threads are gone
+static std::mutex orphan_lock;
+static free_slot *orphan_lists[num_classes];
+
+static void push_orphans(size_t index, free_slot *head) {
+	free_slot *tail = head;
+	while (tail->next != nullptr)
+		tail = tail->next;
+	std::lock_guard<std::mutex> guard(orphan_lock);
+	tail->next = orphan_lists[index];
+	orphan_lists[index] = head;
+}
+
+static free_slot *pop_orphans(size_t index) {
+	std::lock_guard<std::mutex> guard(orphan_lock);
+	free_slot *head = orphan_lists[index];
+	orphan_lists[index] = nullptr;
+	return head;
+}
+
+struct thread_node_pool {
+	free_slot *free_lists[num_classes];
+	char *chunk_cur;
+	char *chunk_end;
+	unsigned long long epoch;
+	// Set once the thread is exiting, slots are then returned to the orphans directly
+	bool retired;
+};
+
+static thread_local thread_node_pool local_pool;
+
+// The free lists and the chunk of this thread point into released memory
+static inline void check_epoch(void) {
+	unsigned long long epoch = pool_epoch.load(std::memory_order_acquire);
+	if (local_pool.epoch == epoch)
+		return;
+	for (size_t i = 0; i < num_classes; i++)
+		local_pool.free_lists[i] = nullptr;
+	local_pool.chunk_cur = local_pool.chunk_end = nullptr;
+	local_pool.epoch = epoch;
+}
+
+// Hands the free lists over when the thread exits
+class thread_node_pool_reaper {
+public:
+	bool registered = false;
+	~thread_node_pool_reaper() {
+		check_epoch();
+		local_pool.retired = true;
+		for (size_t i = 0; i < num_classes; i++) {
+			if (local_pool.free_lists[i] != nullptr)
+				push_orphans(i, local_pool.free_lists[i]);
+			local_pool.free_lists[i] = nullptr;
+		}
+		// The rest of the current chunk is lost, it is at most one chunk per thread
+	}
+};
+static thread_local thread_node_pool_reaper local_reaper;
+
+static inline size_t size_class(size_t size) {
+	return (size + granularity - 1) / granularity - 1;
+}
+
+void *node_pool_allocate(size_t size) {
+	if (size == 0 || size > max_pooled_size)
+		return ::operator new(size);
+	bytes_in_use.fetch_add(size, std::memory_order_relaxed);
+	size_t index = size_class(size);
+	// These slots end up in the orphans, they have to be as large as the class
+	if (local_pool.retired)
+		return ::operator new((index + 1) * granularity);
+	// Makes sure the lists are handed over when this thread exits
+	if (!local_reaper.registered)
+		local_reaper.registered = true;
+	check_epoch();
+
+	free_slot *slot = local_pool.free_lists[index];
+	if (slot == nullptr)
+		slot = pop_orphans(index);
+	if (slot != nullptr) {
+		local_pool.free_lists[index] = slot->next;
+		return slot;
+	}
+	size = (index + 1) * granularity;
+	if (local_pool.chunk_cur == nullptr || (size_t)(local_pool.chunk_end - local_pool.chunk_cur) < size) {
+		// Whatever is left of the old chunk is too small for this class
+		char *chunk = static_cast<char *>(::operator new(chunk_size));
+		local_pool.chunk_cur = chunk + granularity;
+		local_pool.chunk_end = chunk + chunk_size;
+		bytes_reserved += chunk_size;
+		std::lock_guard<std::mutex> guard(chunk_lock);
+		*reinterpret_cast<char **>(chunk) = last_chunk;
+		last_chunk = chunk;
+	}
+	void *ret = local_pool.chunk_cur;
+	local_pool.chunk_cur += size;
+	return ret;
+}
+
+void node_pool_deallocate(void *ptr, size_t size) {
+	if (size == 0 || size > max_pooled_size) {
+		::operator delete(ptr);
+		return;
+	}
+	bytes_in_use.fetch_sub(size, std::memory_order_relaxed);
+	free_slot *slot = static_cast<free_slot *>(ptr);
+	if (local_pool.retired) {
+		slot->next = nullptr;
+		push_orphans(size_class(size), slot);
+		return;
+	}
+	check_epoch();
+	// Slots freed by a different thread than the one that allocated them
+	// simply move to the free list of the freeing thread
+	slot->next = local_pool.free_lists[size_class(size)];
+	local_pool.free_lists[size_class(size)] = slot;
+}
+
+size_t node_pool_bytes_in_use(void) {
+	return bytes_in_use.load();
+}
+size_t node_pool_bytes_reserved(void) {
+	return bytes_reserved.load();
+}
+
+bool node_pool_release(void) {
+	std::lock_guard<std::mutex> guard(chunk_lock);
+	if (bytes_in_use.load() != 0)
+		return false;
+	while (last_chunk != nullptr) {
+		char *chunk = last_chunk;
+		last_chunk = *reinterpret_cast<char **>(chunk);
+		::operator delete(chunk);
+	}
+	bytes_reserved = 0;
+	{
+		// Slots that exiting threads took from the heap directly are dropped with them
+		std::lock_guard<std::mutex> orphan_guard(orphan_lock);
+		for (size_t i = 0; i < num_classes; i++)
+			orphan_lists[i] = nullptr;
+	}
+	pool_epoch++;
+	return true;
+}
+
+} // namespace util
@@ -0,0 +1,101 @@
+#include "util/thread_pool.h"
+
+namespace util {
+
+// Identifies the pool (and the queue inside it) the current thread works for
+static thread_local work_stealing_pool *current_pool = nullptr;
+static thread_local int current_index = -1;
+
+work_stealing_pool::work_stealing_pool(unsigned int num_workers) : pending(0) {
+	for (unsigned int i = 0; i < num_workers + 1; i++)
+		queues.push_back(std::unique_ptr<task_queue>(new task_queue()));
+	for (unsigned int i = 0; i < num_workers; i++)
+		threads.push_back(std::thread(&work_stealing_pool::worker_loop, this, i));
+}
+
+work_stealing_pool::~work_stealing_pool() {
+	{
+		std::lock_guard<std::mutex> guard(idle_lock);
+		stopping = true;
+	}
+	idle_cond.notify_all();
+	for (auto &t : threads)
+		t.join();
+}
+
+int work_stealing_pool::current_queue_index(void) {
+	if (current_pool == this)
+		return current_index;
+	// External threads push to the shared queue at the end
+	return queues.size() - 1;
+}
+
+void work_stealing_pool::spawn(task *t) {
+	task_queue *q = queues[current_queue_index()].get();
+	{
+		std::lock_guard<std::mutex> guard(q->lock);
+		q->tasks.push_back(t);
+	}
+	{
+		std::lock_guard<std::mutex> guard(idle_lock);
+		pending++;
+	}
+	idle_cond.notify_one();
+}
+
+bool work_stealing_pool::run_one(int self) {
+	task *t = nullptr;
+	int num_queues = queues.size();
+	// Our own queue is used as a stack (newest first) for locality,
+	// everybody else's is stolen from the front (oldest, usually largest)
+	for (int i = 0; i < num_queues && t == nullptr; i++) {
+		int index = (self + i) % num_queues;
+		task_queue *q = queues[index].get();
+		std::lock_guard<std::mutex> guard(q->lock);
+		if (q->tasks.empty())
+			continue;
+		if (i == 0) {
+			t = q->tasks.back();
+			q->tasks.pop_back();
+		} else {
+			t = q->tasks.front();
+			q->tasks.pop_front();
+		}
+	}
+	if (t == nullptr)
+		return false;
+	pending--;
+
+	try {
+		t->func();
+	} catch (...) {
+		t->error = std::current_exception();
+	}
+	t->done.store(true, std::memory_order_release);
+	return true;
+}
+
+void work_stealing_pool::wait(task *t) {
+	int self = current_queue_index();
+	while (!t->done.load(std::memory_order_acquire)) {
+		if (!run_one(self))
+			std::this_thread::yield();
+	}
+	if (t->error)
+		std::rethrow_exception(t->error);
+}
+
+void work_stealing_pool::worker_loop(int index) {
+	current_pool = this;
+	current_index = index;
+	while (1) {
+		if (run_one(index))
+			continue;
+		std::unique_lock<std::mutex> guard(idle_lock);
+		idle_cond.wait(guard, [this]() { return stopping || pending > 0; });
+		if (stopping && pending == 0)
+			return;
+	}
+}
+
+} // namespace util
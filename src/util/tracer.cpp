@@ -1,6 +1,10 @@
 #include "util/tracer.h"
 #include "builder/builder_context.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 #ifdef TRACER_USE_LIBUNWIND
 #define UNW_LOCAL_ONLY
@@ -12,6 +16,132 @@ extern void lambda_wrapper(void);
 extern void lambda_wrapper_close(void);
 }
 namespace tracer {
+
+bool record_tag_stacks = false;
+// Stacks are interned so each distinct tag is stored once. Index 0 is unused
+static std::mutex tag_stacks_lock;
+static std::vector<tag_stack> tag_stacks(1);
+static std::unordered_map<tag, unsigned int> tag_stack_ids;
+
+const tag_stack *get_tag_stack(const tag &t) {
+	std::lock_guard<std::mutex> guard(tag_stacks_lock);
+	if (t.stack_id == 0 || t.stack_id >= tag_stacks.size())
+		return nullptr;
+	return &tag_stacks[t.stack_id];
+}
+
+static void record_stack(tag &new_tag, tag_stack &stack) {
+	std::lock_guard<std::mutex> guard(tag_stacks_lock);
+	auto it = tag_stack_ids.find(new_tag);
+	if (it != tag_stack_ids.end()) {
+		// With the full stacks around, hash collisions can be checked on the exact bytes
+		tag_stack &old_stack = tag_stacks[it->second];
+		if (old_stack.pointers != stack.pointers || old_stack.static_var_snapshots != stack.static_var_snapshots) {
+			assert(false && "Hash collision between two different tags");
+		}
+		new_tag.stack_id = it->second;
+		return;
+	}
+	new_tag.stack_id = tag_stacks.size();
+	tag_stacks.push_back(stack);
+	tag_stack_ids[new_tag] = new_tag.stack_id;
+}
+
+std::string tag::stringify(void) const {
+	char temp[128];
+	sprintf(temp, "%016llx%016llx", hash_high, hash_low);
+	std::string output_string = temp;
+	const tag_stack *stack = get_tag_stack(*this);
+	if (stack == nullptr)
+		return output_string;
+
+	output_string += " [";
+	for (unsigned int i = 0; i < stack->pointers.size(); i++) {
+		sprintf(temp, "%llx", stack->pointers[i]);
+		output_string += temp;
+		if (i != stack->pointers.size() - 1)
+			output_string += ", ";
+	}
+	output_string += "]:[";
+	for (unsigned int i = 0; i < stack->static_var_snapshots.size(); i++) {
+		output_string += stack->static_var_snapshots[i];
+		if (i != stack->static_var_snapshots.size() - 1)
+			output_string += ", ";
+	}
+	output_string += "]";
+
+	return output_string;
+}
+
+// Return addresses are hashed relative to lambda_wrapper, so the tags of code in the
+// same binary don't depend on where it is loaded and can be stored across runs.
+// The two halves of the hash are independent 64 bit chains with different seeds
+// and mixing, so a collision requires both of them to collide
+static inline unsigned long long mix_hash(unsigned long long x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+static inline void hash_value(tag &t, unsigned long long v) {
+	t.hash_high = mix_hash(t.hash_high ^ v);
+	t.hash_low = mix_hash(t.hash_low + v * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL);
+}
+static inline void hash_bytes(tag &t, const unsigned char *ptr, unsigned int size) {
+	unsigned int i = 0;
+	for (; i + 8 <= size; i += 8) {
+		unsigned long long v;
+		memcpy(&v, ptr + i, 8);
+		hash_value(t, v);
+	}
+	if (i < size) {
+		unsigned long long v = 0;
+		memcpy(&v, ptr + i, size - i);
+		hash_value(t, v);
+	}
+	hash_value(t, size);
+}
+static inline void start_hash(tag &t) {
+	t.hash_high = 0x243f6a8885a308d3ULL;
+	t.hash_low = 0x13198a2e03707344ULL;
+}
+static inline void finish_hash(tag &t) {
+	// The all zero hash is reserved for empty tags
+	if (t.is_empty())
+		t.hash_low = 1;
+}
+
+void hash_static_var(const unsigned char *ptr, unsigned int size, unsigned int position, unsigned long long &hash_high,
+		     unsigned long long &hash_low) {
+	tag t;
+	start_hash(t);
+	hash_value(t, position);
+	hash_bytes(t, ptr, size);
+	hash_high = t.hash_high;
+	hash_low = t.hash_low;
+}
+
+static void hash_static_vars(tag &new_tag, tag_stack &stack, builder::builder_context *current_builder_context) {
+	assert(current_builder_context != nullptr);
+	// Separates the return addresses from the static vars
+	hash_value(new_tag, ~0ULL);
+	// The context keeps the hash of the static vars up to date
+	if (current_builder_context->has_escaped_static_vars)
+		current_builder_context->update_escaped_static_vars();
+	hash_value(new_tag, current_builder_context->static_var_tuples.size());
+	hash_value(new_tag, current_builder_context->static_var_hash_high);
+	hash_value(new_tag, current_builder_context->static_var_hash_low);
+	if (record_tag_stacks) {
+		for (builder::tracking_tuple &tuple : current_builder_context->static_var_tuples)
+			stack.static_var_snapshots.push_back(tuple.snapshot());
+	}
+	finish_hash(new_tag);
+	if (record_tag_stacks)
+		record_stack(new_tag, stack);
+}
+
 #ifdef TRACER_USE_LIBUNWIND
 tag get_offset_in_function_impl(builder::builder_context *current_builder_context) {
 	unsigned long long function = (unsigned long long)(void *)builder::lambda_wrapper;
@@ -23,19 +153,52 @@ tag get_offset_in_function_impl(builder::builder_context *current_builder_contex
 	unw_init_local(&cursor, &context);
 
 	tag new_tag;
+	tag_stack stack;
+	start_hash(new_tag);
 	while (unw_step(&cursor)) {
 		unw_word_t ip;
 		unw_get_reg(&cursor, UNW_REG_IP, &ip);
 		if ((unsigned long long)ip >= function && (unsigned long long) ip < function_end)
 			break;
-		new_tag.pointers.push_back((unsigned long long)ip);
+		hash_value(new_tag, (unsigned long long)ip - function);
+		if (record_tag_stacks)
+			stack.pointers.push_back((unsigned long long)ip);
 	}
 	// Now add snapshots of static vars
-	assert(current_builder_context != nullptr);
-	for (builder::tracking_tuple tuple :
-	     current_builder_context->static_var_tuples) {
-		new_tag.static_var_snapshots.push_back(tuple.snapshot());
+	hash_static_vars(new_tag, stack, current_builder_context);
+	return new_tag;
+}
+
+#elif defined(TRACER_USE_FRAME_POINTERS)
+// Every function between here and lambda_wrapper has to be compiled
+// with -fno-omit-frame-pointer. Each frame then starts with the saved
+// frame pointer of the caller followed by the return address
+tag get_offset_in_function_impl(builder::builder_context *current_builder_context) {
+	unsigned long long function = (unsigned long long)(void *)builder::lambda_wrapper;
+	unsigned long long function_end = (unsigned long long)(void *)builder::lambda_wrapper_close;
+
+	tag new_tag;
+	tag_stack stack;
+	start_hash(new_tag);
+	void **frame = (void **)__builtin_frame_address(0);
+	// Same depth limit as the backtrace mode
+	for (int i = 0; i < 50 && frame != nullptr; i++) {
+		unsigned long long ip = (unsigned long long)frame[1];
+		if (ip >= function && ip < function_end)
+			break;
+		hash_value(new_tag, ip - function);
+		if (record_tag_stacks)
+			stack.pointers.push_back(ip);
+		void **next = (void **)frame[0];
+		// The stack grows down, a caller frame below this one or
+		// a misaligned one means the chain is broken
+		if (next <= frame || ((unsigned long long)next & (sizeof(void *) - 1)) != 0)
+			break;
+		frame = next;
 	}
+
+	// Now add snapshots of static vars
+	hash_static_vars(new_tag, stack, current_builder_context);
 	return new_tag;
 }
 
@@ -47,29 +210,45 @@ tag get_offset_in_function_impl(
 
 	void *buffer[50];
 	tag new_tag;
+	tag_stack stack;
+	start_hash(new_tag);
 	// First add the RIP pointers
 	int backtrace_size = backtrace(buffer, 50);
 	for (int i = 0; i < backtrace_size; i++) {
 		if ((unsigned long long)buffer[i] >= function && (unsigned long long) buffer[i] < function_end)
 			break;
-		new_tag.pointers.push_back((unsigned long long)buffer[i]);
+		hash_value(new_tag, (unsigned long long)buffer[i] - function);
+		if (record_tag_stacks)
+			stack.pointers.push_back((unsigned long long)buffer[i]);
 	}
 
 	// Now add snapshots of static vars
-	assert(current_builder_context != nullptr);
-	for (builder::tracking_tuple tuple :
-	     current_builder_context->static_var_tuples) {
-		new_tag.static_var_snapshots.push_back(tuple.snapshot());
-	}
+	hash_static_vars(new_tag, stack, current_builder_context);
 	return new_tag;
 }
 #endif
-static unsigned long long unique_tag_counter = 0;
+static std::atomic<unsigned long long> unique_tag_counter(0);
+static std::atomic<unsigned long long> *current_unique_tag_counter = &unique_tag_counter;
+std::atomic<unsigned long long> *get_unique_tag_counter(void) {
+	return current_unique_tag_counter;
+}
+void set_unique_tag_counter(std::atomic<unsigned long long> *counter) {
+	current_unique_tag_counter = counter;
+}
 tag get_unique_tag(void) {
 	tag new_tag;
-	new_tag.pointers.push_back(0);
-	new_tag.pointers.push_back(unique_tag_counter);
-	unique_tag_counter++;
+	tag_stack stack;
+	start_hash(new_tag);
+	// Real stacks never have a null return address
+	hash_value(new_tag, 0);
+	unsigned long long id = (*current_unique_tag_counter)++;
+	hash_value(new_tag, id);
+	finish_hash(new_tag);
+	if (record_tag_stacks) {
+		stack.pointers.push_back(0);
+		stack.pointers.push_back(id);
+		record_stack(new_tag, stack);
+	}
 	return new_tag;
 }
 
@@ -2,6 +2,8 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 #ifdef RECOVER_VAR_NAMES
 #define UNW_LOCAL_ONLY
@@ -409,15 +411,19 @@ std::string find_variable_name(void* addr) {
 #endif
 
 namespace util {
-static std::map<std::string, std::string> tag_var_name_map;
-std::string find_variable_name_cached(void* addr, std::string tag_string) {
-	if (tag_var_name_map.find(tag_string) != tag_var_name_map.end()) {
-		return tag_var_name_map[tag_string];
+static std::unordered_map<tracer::tag, std::string> tag_var_name_map;
+// Extraction can run on multiple threads, the debug info readers are not thread safe either
+static std::mutex tag_var_name_lock;
+std::string find_variable_name_cached(void* addr, const tracer::tag &offset) {
+	std::lock_guard<std::mutex> guard(tag_var_name_lock);
+	auto it = tag_var_name_map.find(offset);
+	if (it != tag_var_name_map.end()) {
+		return it->second;
 	}
 	
 	std::string ret = find_variable_name(addr);
 	if (ret != "")
-		tag_var_name_map[tag_string] = ret;
+		tag_var_name_map[offset] = ret;
 	return ret;
 }
 }